@@ -138,7 +138,7 @@ void chain(unsigned arg)
 {
 	extern char __stage2;
 
-	unsigned indx, data, type, switches;
+	unsigned indx, data, type, switches, vers;
 	unsigned *pfix, *relocs;
 	unsigned long loadaddr;
 	struct rfx_header *rfx;
@@ -169,8 +169,12 @@ void chain(unsigned arg)
 
 	rfx = (void *) &__stage2;
 	
-	if(memcmp(rfx->magic, RFX_HDR_MAGIC, RFX_HDR_MAGIC_SZ))
-		loader_error(" INVALID HEADER");
+	vers = 2;
+	if(memcmp(rfx->magic, RFX_HDR_MAGIC_V2, RFX_HDR_MAGIC_SZ)) {
+		vers = 1;
+		if(memcmp(rfx->magic, RFX_HDR_MAGIC, RFX_HDR_MAGIC_SZ))
+			loader_error(" INVALID HEADER");
+	}
 
 	loadaddr = ram[0] + ram[1] - (32 << 10); // XXX
 
@@ -184,31 +188,36 @@ void chain(unsigned arg)
 
 	relocs = (void *)(rfx + 1) + rfx->imgsize;
 
-	for(indx = 0; indx < rfx->nrelocs; ++indx) {
+	if(vers > 1) {
+		if(!rfx_relocate((void *) loadaddr, loadaddr, (void *) relocs))
+			loader_error(" BAD RELOCATION");
+	} else {
+		for(indx = 0; indx < rfx->nrelocs; ++indx) {
 
-		type = relocs[indx] & 3;
-		pfix = (void *) loadaddr + (relocs[indx] & ~3);
-		data = *pfix;
+			type = relocs[indx] & 3;
+			pfix = (void *) loadaddr + (relocs[indx] & ~3);
+			data = *pfix;
 
-		switch(type) {
+			switch(type) {
 
-			case RFX_REL_32:
-				*pfix = data + loadaddr;
-				break;
+				case RFX_REL_32:
+					*pfix = data + loadaddr;
+					break;
 
-			case RFX_REL_26:
-				data += (loadaddr & 0x0fffffff) >> 2;
-				if((*pfix ^ data) & 0xfc000000)
-					loader_error(" BAD RELOCATION");
-				*pfix = data;
-				break;
+				case RFX_REL_26:
+					data += (loadaddr & 0x0fffffff) >> 2;
+					if((*pfix ^ data) & 0xfc000000)
+						loader_error(" BAD RELOCATION");
+					*pfix = data;
+					break;
 
-			case RFX_REL_H16:
-				*pfix = (data & 0xffff0000) | ((data + (loadaddr >> 16)) & 0x0000ffff);
-				break;
+				case RFX_REL_H16:
+					*pfix = (data & 0xffff0000) | ((data + (loadaddr >> 16)) & 0x0000ffff);
+					break;
 
-			default:
-				loader_error(" UNKNOWN RELOC");
+				default:
+					loader_error(" UNKNOWN RELOC");
+			}
 		}
 	}
 	
@@ -0,0 +1,43 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#ifndef _RAWBOOT_H_
+#define _RAWBOOT_H_
+
+#define RAWBOOT_MAGIC			"CoLoRAW1"
+#define RAWBOOT_MAGIC_SZ		8
+#define RAWBOOT_VERSION			1
+#define RAWBOOT_SECTOR			512
+
+/* partition type for raw boot partitions ("non-FS data") */
+
+#define RAWBOOT_PART_TYPE		0xda
+
+/*
+ * the header fills the first sector of the partition, the kernel and
+ * initrd follow, each starting on a sector boundary. All fields are little
+ * endian, offsets are in sectors from the start of the partition and sizes
+ * in bytes. 'hdr_md5' covers the header up to itself.
+ */
+struct rawboot_header
+{
+	char				magic[RAWBOOT_MAGIC_SZ];
+	unsigned			version;
+	unsigned			kernel_offset;
+	unsigned			kernel_size;
+	unsigned			initrd_offset;
+	unsigned			initrd_size;		/* 0 for none */
+	unsigned char	kernel_md5[16];
+	unsigned char	initrd_md5[16];
+	unsigned char	hdr_md5[16];
+	unsigned char	padding[RAWBOOT_SECTOR - RAWBOOT_MAGIC_SZ - 5 * 4 - 3 * 16];
+};
+
+#endif
+
+/* vi:set ts=3 sw=3 cin: */
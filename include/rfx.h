@@ -14,9 +14,23 @@
 #define RFX_REL_H16			2
 /* #define RFX_REL_L16		3 */
 
+#define RFX_REL_END		0xff
+
 #define RFX_HDR_MAGIC		"\xaaRFX"
+#define RFX_HDR_MAGIC_V2	"\xaaRF2"
 #define RFX_HDR_MAGIC_SZ	4
 
+/*
+ * the original format follows the image with one word per relocation,
+ * offset | type. Version 2 follows it with a byte stream of nrelocs bytes
+ * holding runs of relocations of one type :-
+ *
+ *		type (1 byte) count (2 bytes LE) delta * count
+ *
+ * each delta is the distance in words from the previous relocation of the
+ * run (the first counts from word -1), either one byte 1-255 or a zero byte
+ * followed by 3 bytes LE. The stream ends with type RFX_REL_END.
+ */
 struct rfx_header
 {
 	char		magic[RFX_HDR_MAGIC_SZ];
@@ -26,6 +40,62 @@ struct rfx_header
 	unsigned	nrelocs;
 };
 
+#define RFX_DELTA(p,d)		do{d=*(p)++;if(!d){d=(p)[0]|((p)[1]<<8)|((p)[2]<<16);(p)+=3;}}while(0)
+
+/*
+ * apply version 2 relocations to image which is to run at base, returns
+ * zero on a bad stream or out of range relocation
+ */
+static inline int rfx_relocate(void *image, unsigned base, const unsigned char *strm)
+{
+	unsigned type, count, delta, data, *pfix;
+
+	for(;;) {
+
+		type = *strm++;
+		if(type == RFX_REL_END)
+			return 1;
+
+		count = strm[0] | (strm[1] << 8);
+		strm += 2;
+
+		pfix = (unsigned *) image - 1;
+
+		switch(type) {
+
+			case RFX_REL_32:
+				while(count--) {
+					RFX_DELTA(strm, delta);
+					pfix += delta;
+					*pfix += base;
+				}
+				break;
+
+			case RFX_REL_26:
+				while(count--) {
+					RFX_DELTA(strm, delta);
+					pfix += delta;
+					data = *pfix + ((base & 0x0fffffff) >> 2);
+					if((*pfix ^ data) & 0xfc000000)
+						return 0;
+					*pfix = data;
+				}
+				break;
+
+			case RFX_REL_H16:
+				while(count--) {
+					RFX_DELTA(strm, delta);
+					pfix += delta;
+					*pfix = (*pfix & 0xffff0000) | ((*pfix + (base >> 16)) & 0x0000ffff);
+				}
+				break;
+
+			default:
+				return 0;
+		}
+	}
+}
+
 #endif
 
 /* vi:set ts=3 sw=3 cin: */
@@ -45,7 +45,7 @@ void loader(void)
 {
 	extern char __stage2;
 
-	unsigned indx, type, data;
+	unsigned indx, type, data, vers;
 	unsigned *pfix, *relocs;
 	unsigned long loadaddr;
 	struct rfx_header *rfx;
@@ -56,9 +56,12 @@ void loader(void)
 
 	rfx = KSEG1(&__stage2);
 	
-	for(indx = 0; indx < RFX_HDR_MAGIC_SZ; ++indx)
-		if(rfx->magic[indx] != RFX_HDR_MAGIC[indx])
+	for(vers = 2, indx = 0; indx < RFX_HDR_MAGIC_SZ; ++indx) {
+		if(rfx->magic[indx] != RFX_HDR_MAGIC_V2[indx])
+			vers = 1;
+		if(vers == 1 && rfx->magic[indx] != RFX_HDR_MAGIC[indx])
 			loader_error(" INVALID HEADER");
+	}
 
 	loadaddr = mem_bank[0] + mem_bank[1] - (32 << 10); // XXX
 
@@ -72,31 +75,36 @@ void loader(void)
 
 	relocs = (void *)(rfx + 1) + rfx->imgsize;
 
-	for(indx = 0; indx < rfx->nrelocs; ++indx) {
+	if(vers > 1) {
+		if(!rfx_relocate((void *) loadaddr, loadaddr, (void *) relocs))
+			loader_error(" BAD RELOCATION");
+	} else {
+		for(indx = 0; indx < rfx->nrelocs; ++indx) {
 
-		type = relocs[indx] & 3;
-		pfix = (void *) loadaddr + (relocs[indx] & ~3);
-		data = *pfix;
+			type = relocs[indx] & 3;
+			pfix = (void *) loadaddr + (relocs[indx] & ~3);
+			data = *pfix;
 
-		switch(type) {
+			switch(type) {
 
-			case RFX_REL_32:
-				*pfix = data + loadaddr;
-				break;
+				case RFX_REL_32:
+					*pfix = data + loadaddr;
+					break;
 
-			case RFX_REL_26:
-				data += (loadaddr & 0x0fffffff) >> 2;
-				if((*pfix ^ data) & 0xfc000000)
-					loader_error(" BAD RELOCATION");
-				*pfix = data;
-				break;
+				case RFX_REL_26:
+					data += (loadaddr & 0x0fffffff) >> 2;
+					if((*pfix ^ data) & 0xfc000000)
+						loader_error(" BAD RELOCATION");
+					*pfix = data;
+					break;
 
-			case RFX_REL_H16:
-				*pfix = (data & 0xffff0000) | ((data + (loadaddr >> 16)) & 0x0000ffff);
-				break;
+				case RFX_REL_H16:
+					*pfix = (data & 0xffff0000) | ((data + (loadaddr >> 16)) & 0x0000ffff);
+					break;
 
-			default:
-				loader_error(" UNKNOWN RELOC");
+				default:
+					loader_error(" UNKNOWN RELOC");
+			}
 		}
 	}
 	
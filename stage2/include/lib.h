@@ -26,7 +26,7 @@
 										if(!(x)) {\
 											puts("\n***  ASSERTION FAILED [" __FILE__ ":" _STR(__LINE__) "] (" #x ")  ***\n");\
 											for(;;)\
-												;\
+												drain();\
 										}\
 									}while(0)
 #else
@@ -145,6 +145,11 @@ extern void putstring(const char *);
 extern void puts(const char *str);
 extern void drain(void);
 extern void serial_scan(void);
+extern unsigned serial_speed(unsigned);
+extern int serial_getc(unsigned);
+extern void serial_putc(int);
+extern void serial_poll(void);
+extern void serial_nowait(int);
 
 #define BREAK()							({ char c; kbhit() && ((c = getch()) == ' ' || c == '\003'); })
 
@@ -206,8 +211,18 @@ extern const char *pci_unit_name(void);
 
 extern void ide_init(void);
 extern int ide_read_sectors(void *, void *, unsigned long, unsigned);
+extern int ide_write_sectors(void *, const void *, unsigned long, unsigned);
+extern int ide_flush(void *);
 extern void *ide_open(const char *);
+extern void *ide_open_raw(const char *);
+extern int ide_ready(void);
 extern int ide_block_size(void *);
+extern unsigned long ide_size(void *);
+extern unsigned ide_mirrors(void *);
+extern int ide_read_mirror(void *, unsigned, void *, unsigned long, unsigned);
+extern const char *ide_mirror_name(void *, unsigned);
+extern int ide_reserved_read(void *, void *);
+extern int ide_reserved_write(void *, const void *);
 extern const char *ide_dev_name(void *);
 
 /* expr.c */
@@ -223,6 +238,7 @@ extern void icache_flush_all(void);
 /* block.c */
 
 extern int block_read_raw(void *, void *, unsigned long, size_t, size_t);
+extern int block_read_run(void *, void *, unsigned long, unsigned, size_t, size_t);
 extern void *block_read(void *, unsigned long, size_t, size_t);
 extern void block_flush(void *);
 extern int block_init(void);
@@ -249,6 +265,9 @@ extern void elf64_load(const void *);
 
 extern int gzip_check(const void *, size_t);
 extern int unzip(const void *, size_t);
+extern int gzip_peek(const void *, void *, size_t);
+extern size_t gzip_size(const void *, size_t);
+extern int inflate_stream(unsigned (*)(void *, unsigned), void (*)(const void *, unsigned));
 
 /* -- error codes 1 ... 3 are returned by inflate() */
 
@@ -256,10 +275,12 @@ extern int unzip(const void *, size_t);
 #define INFLATE_ERR_NOT_DEFLATE			-5
 #define INFLATE_ERR_BAD_CRC				-6
 #define INFLATE_ERR_BAD_LENGTH			-7
+#define INFLATE_ERR_READ					-8
 
 /* tulip.c */
 
 extern void tulip_init(void);
+extern void tulip_start(void);
 
 /* main.c */
 
@@ -268,10 +289,26 @@ extern size_t ram_restrict;
 
 /* heap.c */
 
+#define HEAP_IMAGE							1
+#define HEAP_INITRD							2
+#define HEAP_DATA								3
+#define HEAP_PRELOAD							4
+
+#define HEAP_LO								0
+#define HEAP_HI								1
+
 extern void heap_reset(void);
+extern void *heap_region_alloc(const char *, unsigned, size_t, int);
+extern void *heap_region_place(const char *, unsigned, void *, size_t);
+extern void heap_region_free(void *);
+extern void *heap_region_find(unsigned, size_t *);
+extern const char *heap_overlap(void *, size_t, unsigned);
+extern size_t heap_free_at(void *);
 extern size_t heap_space(void);
 extern void *heap_reserve_lo(size_t);
 extern void *heap_reserve_hi(size_t);
+extern void *heap_reserve_at(void *, size_t, size_t);
+extern void *heap_reserve_region(void *);
 extern void heap_alloc(void);
 extern void heap_info(void);
 extern void *heap_image(size_t *);
@@ -284,22 +321,73 @@ extern void heap_set_initrd(void *, size_t);
 
 extern void *file_open(const char *, unsigned long *);
 extern int file_load(void *, void *, unsigned long);
+extern void boot_plan_commit(void);
+extern void volume_release(void);
+extern void *file_reserve(void *, unsigned long);
+extern void preload_start(void);
+extern int preload_ready(void);
+extern void preload_stop(void);
+extern void preload_abort(void);
+extern void preload_poll(void);
+
+/* iso9660.c */
+
+extern int iso_mount(void *);
+extern void iso_umount(void);
+extern int iso_mounted(void);
+extern void *iso_open(const char *, unsigned long *);
+extern int iso_load(void *, void *, unsigned long);
+extern int iso_list(void);
+extern int iso_chdir(void);
 
 /* net.c */
 
 extern int net_up(void);
 extern void net_down(int);
+extern void progress_start(void);
+extern void progress_update(unsigned);
+extern void progress_stop(int);
 
 #define net_is_up()							({ extern int net_alive; net_alive; })
 
-static inline void yield(void)
+/* task.c */
+
+extern void schedule(void);
+
+#define yield()								schedule()
+
+/* stream.c */
+
+extern void stream_open(void *, unsigned);
+extern void stream_source(void (*)(void), void (*)(void));
+extern unsigned stream_room(void);
+extern void stream_put(const void *, unsigned);
+extern void stream_end(int);
+extern int stream_read(void *, unsigned);
+extern int stream_peek(void *, unsigned);
+extern void stream_poll(void);
+extern void stream_close(void);
+
+/* timer.c */
+
+struct timer
 {
-	extern void tulip_poll(void);
-	extern int net_alive;
+	struct timer	*next;
+	unsigned			start;
+	unsigned			length;
+	unsigned			period;
+	unsigned			fired;
+	void				(*func)(struct timer *);
+	void				*data;
+};
 
-	if(net_alive)
-		tulip_poll();
-}
+extern void timer_set(struct timer *, unsigned);
+extern int timer_expired(const struct timer *);
+extern void timer_start(struct timer *, unsigned, unsigned, void (*)(struct timer *), void *);
+extern void timer_stop(struct timer *);
+extern void timer_run(void);
+extern int wait_event(int (*)(void *), void *, const struct timer *);
+extern void timer_sleep(unsigned);
 
 /* lcd.c */
 
@@ -310,6 +398,9 @@ static inline void yield(void)
 
 extern void lcd_init(void);
 extern void lcd_line(int, const char *);
+extern void lcd_post(int, const char *);
+extern void lcd_flush(void);
+extern void lcd_poll(void);
 extern int (*lcd_menu)(const char **, unsigned, unsigned);
 
 /* env.c */
@@ -319,6 +410,7 @@ extern int (*lcd_menu)(const char **, unsigned, unsigned);
 #define VAR_DHCP								2
 #define VAR_INITRD							3
 #define VAR_NETCON							4
+#define VAR_HEAP								5
 
 extern int env_put(const char *, const char *, unsigned);
 extern const char *env_get(const char *, int);
@@ -330,6 +422,7 @@ extern void env_remove_tag(unsigned);
 #define BOOT_MENU								0
 
 extern int boot(int);
+extern void boot_preload(void);
 
 /* nv.c */
 
@@ -339,6 +432,7 @@ extern int boot(int);
 #define NVFLAG_IDE_ENABLE_SLAVE			(1 << 3)
 #define NVFLAG_CONSOLE_DISABLE			(1 << 4)
 #define NVFLAG_HORZ_MENU					(1 << 5)
+#define NVFLAG_IDE_ENABLE_SECONDARY	(1 << 6)
 #define NVFLAG_CONSOLE_PCI_SERIAL		(1 << 7)
 
 #define NV_STORE_VERSION					3
@@ -369,9 +463,20 @@ extern unsigned netcon_read(void *, unsigned);
 extern unsigned netcon_write(const void *, unsigned);
 extern int netcon_enabled(void);
 
+/* digest.c */
+
+extern int digest_args(void);
+extern void digest_begin(unsigned);
+extern void digest_update(const void *, size_t);
+extern void digest_abort(void);
+extern int digest_end(unsigned);
+
 /* exec.c */
 
 extern void clear_reloc(void);
+extern int reloc_direct(void);
+extern void *reloc_direct_addr(size_t *);
+extern int reloc_direct_done(void *, size_t);
 
 #endif
 
@@ -119,6 +119,20 @@ extern void udp_close_all(void);
 /* dhcp.c */
 
 extern int dhcp(void);
+extern int dhcp_start(void);
+extern void dhcp_stop(void);
+extern int dhcp_poll(void);
+extern int dhcp_wait(void);
+extern void dhcp_detach(void);
+extern int dhcp_attach(void);
+
+/* tftp.c */
+
+extern int tftp_stream(uint32_t, const char *);
+
+/* nfs.c */
+
+extern int nfs_stream(uint32_t, const char *, const char *, unsigned long *);
 
 #endif
 
@@ -0,0 +1,24 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+struct SHA256Context {
+	UWORD32 state[8];
+	UWORD32 bytes[2];
+	uint8_t in[64];
+};
+
+void SHA256Init(struct SHA256Context *context);
+void SHA256Update(struct SHA256Context *context, const uint8_t *buf, unsigned len);
+void SHA256Final(uint8_t digest[32], struct SHA256Context *context);
+
+#endif
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
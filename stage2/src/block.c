@@ -113,6 +113,24 @@ int block_read_raw(void *device, void *buf, unsigned long block, size_t size, si
 	return 1;
 }
 
+/*
+ * read run of consecutive blocks from disk bypassing the cache
+ */
+int block_read_run(void *device, void *buf, unsigned long block, unsigned count, size_t size, size_t hwsize)
+{
+	unsigned ratio;
+
+	ratio = size / hwsize;
+	if(ratio)
+		return !ide_read_sectors(device, buf, block * ratio, count * ratio);
+
+	for(; count--; ++block, buf += size)
+		if(!block_read_raw(device, buf, block, size, hwsize))
+			return 0;
+
+	return 1;
+}
+
 /*
  * initialise block cache
  */
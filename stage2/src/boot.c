@@ -7,10 +7,14 @@
  */
 
 #include "lib.h"
+#include "net.h"
 #include "version.h"
 
 #define MENU_TIMEOUT						(10 * 1000)
 
+#define SCRIPT_DISK						0
+#define SCRIPT_RACE						6
+
 static const char *option[] =
 {
 /*  |------------| */
@@ -21,6 +25,8 @@ static const char *option[] =
 	"Network (TFTP)",
 	"Boot shell",
 	"Network shell",
+	"Disk (raw)",
+	"Disk / Network",
 };
 
 static const char *script[] =
@@ -63,8 +69,48 @@ static const char *script[] =
 	"net\n"
 	"lcd 'Network shell...' {ip-address}\n"
 	"netcon {dhcp-next-server}",
+
+	/* Disk (raw) */
+
+	"lcd 'Booting...'\n"
+	"rawboot\n"
+	"execute",
+
+	/* Disk / Network */
+
+	"lcd 'Booting...'\n"
+	"race",
 };
 
+/* network half of 'race', the interface is already up */
+
+static const char *race_script[] =
+{
+	/* DHCP gave a root path */
+
+	"lcd 'Booting...' {ip-address}\n"
+	"nfs {dhcp-next-server} {dhcp-root-path} {dhcp-boot-file}\n"
+	"-script\n"
+	"execute",
+
+	/* otherwise */
+
+	"lcd 'Booting...' {ip-address}\n"
+	"tftp {dhcp-next-server} {dhcp-boot-file}\n"
+	"-script\n"
+	"execute",
+};
+
+/*
+ * start reading the disk boot files in the background whilst the menu or
+ * break window waits, if booting from disk is the default
+ */
+void boot_preload(void)
+{
+	if(nv_store.boot <= SCRIPT_DISK + 1 || nv_store.boot == SCRIPT_RACE + 1)
+		preload_start();
+}
+
 int boot(int which)
 {
 	static char buf[16];
@@ -91,6 +137,7 @@ int boot(int which)
 				break;
 
 			case LCD_MENU_BREAK:
+				preload_abort();
 				return E_NONE;
 
 			default:
@@ -107,6 +154,13 @@ int boot(int which)
 	if(which)
 		--which;
 
+	/* keep what's been preloaded only for scripts that boot from disk */
+
+	if(which == SCRIPT_DISK)
+		preload_stop();
+	else if(which != SCRIPT_RACE)
+		preload_abort();
+
 	if(which >= elements(script)) {
 		DPRINTF("boot: no script #%d\n", which);
 		return E_UNSPEC;
@@ -118,6 +172,108 @@ int boot(int which)
 	return script_exec(script[which], -1);
 }
 
+static int race_net(void)
+{
+	DPUTS("race: booting from network");
+
+	return script_exec(race_script[env_get("dhcp-root-path", -1) ? 0 : 1], -1);
+}
+
+static int race_disk(void)
+{
+	DPUTS("race: booting from disk");
+
+	return script_exec(script[SCRIPT_DISK], -1);
+}
+
+/*
+ * shell command - race
+ *
+ * bring up the disk and DHCP side by side and boot from whichever is ready
+ * first, the disk winning a tie. if that boot fails the other is tried
+ */
+int cmnd_race(int opsz)
+{
+	int disk, net, stat;
+
+	if(argc > 1)
+		return E_ARGS_OVER;
+
+	/* the disk side is left to the preload task, which owns the drives */
+
+	preload_start();
+
+	net = dhcp_start() ? 0 : -1;
+	disk = 0;
+
+	for(;;) {
+
+		if(!disk)
+			disk = preload_ready();
+
+		if(!net)
+			net = dhcp_poll();
+
+		if(disk > 0 || net > 0 || (disk < 0 && net < 0))
+			break;
+
+		if(BREAK()) {
+			dhcp_stop();
+			preload_abort();
+			puts("aborted");
+			return E_UNSPEC;
+		}
+	}
+
+	if(disk > 0) {
+
+		/* DHCP carries on in the background in case the disk fails */
+
+		if(!net)
+			dhcp_detach();
+
+		preload_stop();
+
+		stat = race_disk();
+
+		if(!net)
+			net = dhcp_attach();
+
+		if(stat == E_NONE || net < 0) {
+			dhcp_stop();
+			return stat;
+		}
+
+		puts("disk boot failed, trying network");
+
+		/* the preloaded files would take heap the network load needs */
+
+		preload_abort();
+
+		if(!net && !dhcp_wait())
+			return E_UNSPEC;
+
+		return race_net();
+	}
+
+	if(net > 0) {
+
+		preload_abort();
+
+		stat = race_net();
+		if(stat == E_NONE || disk < 0)
+			return stat;
+
+		puts("network boot failed, trying disk");
+
+		return race_disk();
+	}
+
+	puts("no disk or network");
+
+	return E_UNSPEC;
+}
+
 /*
  * shell command - boot
  */
@@ -46,6 +46,12 @@ static uint32_t dhcp_gway;
 static uint32_t dhcp_addr;
 static uint32_t dhcp_nsvr;
 
+static int dhcp_sock = -1;
+static struct timer dhcp_limit;
+static unsigned dhcp_retries;
+static int dhcp_detached;				/* run by the background task */
+static int dhcp_result;
+
 /*
  * build DHCP request frame (DISCOVER/REQUEST)
  */
@@ -292,13 +298,31 @@ static int dhcp_config(void)
 }
 
 /*
- * get network configuration from DHCP server
+ * send DISCOVER/REQUEST and restart the reply timer
  */
-int dhcp(void)
+static void dhcp_send(void)
 {
-	unsigned mark, retries;
 	struct frame *frame;
-	int sock, stat;
+
+	frame = frame_alloc();
+	if(frame) {
+		FRAME_INIT(frame, HARDWARE_HDRSZ + IP_HDRSZ + UDP_HDRSZ, 1024);
+		dhcp_build(frame);
+		udp_sendto(dhcp_sock, frame, INADDR_BROADCAST, DHCP_PORT_SERVER);
+	}
+
+	timer_set(&dhcp_limit, 2 * 1000);
+}
+
+/*
+ * bring up the interface and start asking for a configuration, the exchange
+ * is run by dhcp_poll()
+ */
+int dhcp_start(void)
+{
+	dhcp_stop();
+
+	dhcp_detached = 0;
 
 	net_down(0);
 
@@ -307,80 +331,155 @@ int dhcp(void)
 		return 0;
 	}
 
-	sock = udp_socket();
-	if(sock < 0) {
+	dhcp_sock = udp_socket();
+	if(dhcp_sock < 0) {
 		puts("no socket");
 		return 0;
 	}
 
-	udp_bind(sock, DHCP_PORT_CLIENT);
+	udp_bind(dhcp_sock, DHCP_PORT_CLIENT);
 
 	dhcp_xid = MFC0(CP0_COUNT);
 	dhcp_sid = 0;
 	dhcp_addr = 0;
-	retries = 0;
+	dhcp_retries = 0;
 
-	for(;;) {
+	dhcp_send();
 
-		frame = frame_alloc();
-		if(frame) {
-			FRAME_INIT(frame, HARDWARE_HDRSZ + IP_HDRSZ + UDP_HDRSZ, 1024);
-			dhcp_build(frame);
-			udp_sendto(sock, frame, INADDR_BROADCAST, DHCP_PORT_SERVER);
+	return 1;
+}
+
+/*
+ * abandon an exchange in progress
+ */
+void dhcp_stop(void)
+{
+	if(dhcp_sock < 0)
+		return;
+
+	udp_close(dhcp_sock);
+	dhcp_sock = -1;
+
+	net_down(0);
+}
+
+/*
+ * move the exchange on, 1 once configured, 0 if still going, -1 if failed
+ */
+int dhcp_poll(void)
+{
+	struct frame *frame;
+	int stat;
+
+	if(dhcp_sock < 0)
+		return -1;
+
+	if(timer_expired(&dhcp_limit)) {
+
+		if(++dhcp_retries == DHCP_SEND_PACKETS_MAX) {
+			dhcp_stop();
+			puts("no response");
+			return -1;
 		}
 
-		for(mark = MFC0(CP0_COUNT);;) {
+		/* back to DISCOVER state */
 
-			if(BREAK()) {
+		dhcp_addr = 0;
+		udp_connect(dhcp_sock, 0, 0);
 
-				udp_close(sock);
-				net_down(0);
+		dhcp_send();
 
-				puts("aborted");
-				return 0;
-			}
+		return 0;
+	}
+
+	frame = udp_recv(dhcp_sock);
+	if(!frame)
+		return 0;
 
-			if(MFC0(CP0_COUNT) - mark >= CP0_COUNT_RATE * 2) {
+	stat = dhcp_receive(dhcp_sock, frame);
+	if(stat > 0) {
 
-				if(++retries == DHCP_SEND_PACKETS_MAX) {
+		udp_close(dhcp_sock);
+		dhcp_sock = -1;
 
-					udp_close(sock);
-					net_down(0);
+		net_down(1);
 
-					puts("no response");
-					return 0;
-				}
+		if(!dhcp_config()) {
+			env_remove_tag(VAR_DHCP);
+			return -1;
+		}
 
-				/* back to DISCOVER state */
+		return 1;
+	}
 
-				dhcp_addr = 0;
-				udp_connect(sock, 0, 0);
+	if(!stat)
+		dhcp_send();
 
-				break;
-			}
+	return 0;
+}
 
-			frame = udp_recv(sock);
-			if(frame) {
-				
-				stat = dhcp_receive(sock, frame);
-				if(stat >= 0) {
-					if(stat > 0) {
+/*
+ * leave the exchange in progress to the background task whilst the caller
+ * gets on with something else
+ */
+void dhcp_detach(void)
+{
+	dhcp_result = 0;
+	dhcp_detached = 1;
+}
 
-						udp_close(sock);
-						net_down(1);
+/*
+ * take the exchange back, as dhcp_poll(). -1 if something else has started
+ * another since
+ */
+int dhcp_attach(void)
+{
+	if(!dhcp_detached)
+		return -1;
 
-						if(!dhcp_config()) {
-							env_remove_tag(VAR_DHCP);
-							return 0;
-						}
+	dhcp_detached = 0;
 
-						return 1;
-					}
+	return dhcp_result;
+}
 
-					break;
-				}
-			}
+/*
+ * background task
+ */
+void dhcp_task(void)
+{
+	if(dhcp_detached && !dhcp_result)
+		dhcp_result = dhcp_poll();
+}
+
+/*
+ * get network configuration from DHCP server
+ */
+int dhcp(void)
+{
+	if(!dhcp_start())
+		return 0;
+
+	return dhcp_wait();
+}
+
+/*
+ * finish an exchange that's been started, 1 if configured
+ */
+int dhcp_wait(void)
+{
+	int stat;
+
+	for(;;) {
+
+		if(BREAK()) {
+			dhcp_stop();
+			puts("aborted");
+			return 0;
 		}
+
+		stat = dhcp_poll();
+		if(stat)
+			return stat > 0;
 	}
 }
 
@@ -0,0 +1,194 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#include "lib.h"
+#include "md5.h"
+#include "sha256.h"
+
+#define DIGEST_NONE					0
+#define DIGEST_MD5					1
+#define DIGEST_SHA256				2
+
+static const struct
+{
+	const char	*name;
+	unsigned		size;
+
+} digests[] = {
+	[DIGEST_MD5]		= { "md5",		16 },
+	[DIGEST_SHA256]	= { "sha256",	32 },
+};
+
+static struct
+{
+	unsigned		type;
+	uint8_t		sum[32];
+
+} expect[MAX_CMND_ARGS];
+
+static unsigned active;
+
+static union
+{
+	struct MD5Context		md5;
+	struct SHA256Context	sha256;
+
+} ctx;
+
+/*
+ * parse 'type=hex', returns digest type, DIGEST_NONE if not a digest or -1
+ * if malformed
+ */
+static int digest_parse(const char *arg, uint8_t *sum)
+{
+	unsigned type, size, indx;
+	const char *ptr;
+
+	for(type = DIGEST_MD5; type < elements(digests); ++type) {
+
+		size = strlen(digests[type].name);
+		if(!strncmp(arg, digests[type].name, size) && arg[size] == '=')
+			break;
+	}
+
+	if(type == elements(digests))
+		return DIGEST_NONE;
+
+	ptr = arg + size + 1;
+
+	if(strlen(ptr) != digests[type].size * 2)
+		return -1;
+
+	for(indx = 0; indx < digests[type].size * 2; ++indx) {
+
+		if(!isxdigit(ptr[indx]))
+			return -1;
+
+		size = toupper(ptr[indx]);
+		size = size > '9' ? size - 'A' + 10 : size - '0';
+
+		if(indx & 1)
+			sum[indx / 2] |= size;
+		else
+			sum[indx / 2] = size << 4;
+	}
+
+	return type;
+}
+
+/*
+ * remove 'md5=...' and 'sha256=...' arguments, remembering the expected digest
+ * of the path argument each one follows
+ */
+int digest_args(void)
+{
+	unsigned indx, keep;
+	uint8_t sum[32];
+	int type;
+
+	digest_abort();
+
+	for(keep = indx = 1; indx < argc; ++indx) {
+
+		type = digest_parse(argv[indx], sum);
+
+		if(type < 0) {
+			puts("bad digest");
+			return 0;
+		}
+
+		if(type == DIGEST_NONE) {
+
+			argv[keep] = argv[indx];
+			argsz[keep] = argsz[indx];
+			expect[keep].type = DIGEST_NONE;
+			++keep;
+
+			continue;
+		}
+
+		if(keep < 2) {
+			puts("digest must follow a path");
+			return 0;
+		}
+
+		expect[keep - 1].type = type;
+		memcpy(expect[keep - 1].sum, sum, digests[type].size);
+	}
+
+	argc = keep;
+
+	return 1;
+}
+
+/*
+ * start hashing data loaded for argument
+ */
+void digest_begin(unsigned arg)
+{
+	assert(arg < MAX_CMND_ARGS);
+
+	active = expect[arg].type;
+
+	if(active == DIGEST_MD5)
+		MD5Init(&ctx.md5);
+	else if(active == DIGEST_SHA256)
+		SHA256Init(&ctx.sha256);
+}
+
+/*
+ * hash data as it arrives
+ */
+void digest_update(const void *data, size_t size)
+{
+	if(active == DIGEST_MD5)
+		MD5Update(&ctx.md5, data, size);
+	else if(active == DIGEST_SHA256)
+		SHA256Update(&ctx.sha256, data, size);
+}
+
+/*
+ * stop hashing, the load failed
+ */
+void digest_abort(void)
+{
+	active = DIGEST_NONE;
+}
+
+/*
+ * finish hashing and check against the expected digest
+ */
+int digest_end(unsigned arg)
+{
+	uint8_t sum[32];
+	unsigned type;
+
+	type = active;
+	active = DIGEST_NONE;
+
+	if(type == DIGEST_NONE)
+		return 1;
+
+	if(type == DIGEST_MD5)
+		MD5Final(sum, &ctx.md5);
+	else
+		SHA256Final(sum, &ctx.sha256);
+
+	expect[arg].type = DIGEST_NONE;
+
+	if(memcmp(sum, expect[arg].sum, digests[type].size)) {
+		printf("%s mismatch\n", digests[type].name);
+		return 0;
+	}
+
+	printf("%s ok\n", digests[type].name);
+
+	return 1;
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
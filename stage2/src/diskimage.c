@@ -0,0 +1,364 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ *
+ * 'diskimage' writes a raw or gzip'd disk image fetched over the network
+ * straight onto a drive. The network fills a ring in the background whilst
+ * the drive is written from it, so there's never more than the ring in
+ * memory however big the image. Afterwards the drive is read back and
+ * checked against what was written.
+ */
+
+#include "lib.h"
+#include "net.h"
+#include "md5.h"
+
+#define DISKIMAGE_RING				(1 << 20)
+#define DISKIMAGE_BLOCK				128			/* sectors per write */
+
+static void *image_dev;
+static uint8_t *image_buf;
+static unsigned image_fill;
+static unsigned long image_sector;
+static int image_error;
+static int image_short;
+static struct MD5Context image_md5;
+static struct timer image_progress;
+
+static void image_show(struct timer *timer)
+{
+	printf(" %luMB\r", image_sector >> 11);
+}
+
+/*
+ * write out the buffer, the last sector padded with zeroes
+ */
+static int image_flush(void)
+{
+	unsigned count;
+
+	if(image_error)
+		return 0;
+
+	if(!image_fill)
+		return 1;
+
+	count = (image_fill + 511) / 512;
+	memset(image_buf + image_fill, 0, count * 512 - image_fill);
+
+	MD5Update(&image_md5, image_buf, count * 512);
+
+	if(ide_write_sectors(image_dev, image_buf, image_sector, count)) {
+		image_error = 1;
+		return 0;
+	}
+
+	image_sector += count;
+	image_fill = 0;
+
+	return 1;
+}
+
+/*
+ * decompressed data, written a buffer at a time
+ */
+static void image_write(const void *data, unsigned size)
+{
+	unsigned copy;
+
+	while(size && !image_error) {
+
+		copy = DISKIMAGE_BLOCK * 512 - image_fill;
+		if(copy > size)
+			copy = size;
+
+		memcpy(image_buf + image_fill, data, copy);
+
+		image_fill += copy;
+		data += copy;
+		size -= copy;
+
+		if(image_fill == DISKIMAGE_BLOCK * 512)
+			image_flush();
+	}
+}
+
+/*
+ * compressed data for inflate, nothing once writing has failed so it
+ * gives up
+ */
+static unsigned image_read(void *data, unsigned size)
+{
+	int got;
+
+	if(image_error)
+		return 0;
+
+	got = stream_read(data, size);
+	if(got <= 0) {
+		image_short = !got;
+		image_error = 1;
+		return 0;
+	}
+
+	return got;
+}
+
+/*
+ * copy a raw image, reading straight into the write buffer
+ */
+static int image_raw(void)
+{
+	int got;
+
+	for(;;) {
+
+		got = stream_read(image_buf + image_fill, DISKIMAGE_BLOCK * 512 - image_fill);
+		if(got < 0)
+			return 0;
+
+		if(!got)
+			return image_flush();
+
+		image_fill += got;
+
+		if(image_fill == DISKIMAGE_BLOCK * 512 && !image_flush())
+			return 0;
+	}
+}
+
+static int image_gzip(void)
+{
+	int res;
+
+	res = inflate_stream(image_read, image_write);
+
+	if(image_short)
+		puts("image truncated");
+	else if(res && !image_error)
+		printf("image corrupt (%d)\n", res);
+
+	return !res && image_flush();
+}
+
+/*
+ * read back what was written and compare digests, 'which' is the mirror
+ * member to read from or -1 for the drive/partition itself. 1 if it matches,
+ * 0 if not, -1 if aborted
+ */
+static int image_check(const uint8_t *want, int which)
+{
+	struct MD5Context ctx;
+	uint8_t got[16];
+	unsigned long addr;
+	unsigned count;
+	int stat;
+
+	MD5Init(&ctx);
+
+	for(addr = 0; addr < image_sector; addr += count) {
+
+		if(BREAK()) {
+			puts("aborted");
+			return -1;
+		}
+
+		count = image_sector - addr;
+		if(count > DISKIMAGE_BLOCK)
+			count = DISKIMAGE_BLOCK;
+
+		if(which < 0)
+			stat = ide_read_sectors(image_dev, image_buf, addr, count);
+		else
+			stat = ide_read_mirror(image_dev, which, image_buf, addr, count);
+
+		if(stat)
+			return 0;
+
+		MD5Update(&ctx, image_buf, count * 512);
+	}
+
+	MD5Final(got, &ctx);
+
+	return !memcmp(want, got, sizeof(got));
+}
+
+/*
+ * verify the drive, each member of a mirror separately
+ */
+static int image_verify(void)
+{
+	uint8_t want[16];
+	unsigned indx, count;
+	int done, stat;
+
+	MD5Final(want, &image_md5);
+
+	count = ide_mirrors(image_dev);
+
+	if(!count) {
+		stat = image_check(want, -1);
+		if(stat >= 0)
+			puts(stat ? "verified" : "verify failed");
+		return stat > 0;
+	}
+
+	for(done = 1, indx = 0; indx < count; ++indx) {
+
+		stat = image_check(want, indx);
+		if(stat < 0)
+			return 0;
+
+		printf("%s %s\n", ide_mirror_name(image_dev, indx), stat ? "verified" : "verify failed");
+
+		if(!stat)
+			done = 0;
+	}
+
+	return done;
+}
+
+/*
+ * write a disk image from the network to a drive
+ */
+int cmnd_diskimage(int opsz)
+{
+	unsigned path, tick;
+	unsigned long size;
+	uint32_t server;
+	uint8_t magic[2];
+	void *base;
+	int done, gzip;
+
+	if(!digest_args())
+		return E_BAD_VALUE;
+
+	if(argc < 4)
+		return E_ARGS_UNDER;
+
+	if(!strcmp(argv[1], "tftp"))
+		path = 3;
+	else if(!strcmp(argv[1], "nfs")) {
+		if(argc < 5)
+			return E_ARGS_UNDER;
+		path = 4;
+	} else {
+		puts("source must be tftp or nfs");
+		return E_BAD_VALUE;
+	}
+
+	if(argc > path + 2)
+		return E_ARGS_OVER;
+
+	if(!inet_aton(argv[2], &server)) {
+		puts("invalid address");
+		return E_UNSPEC;
+	}
+
+	if(!net_is_up())
+		return E_NET_DOWN;
+
+	preload_abort();
+	volume_release();
+
+	image_dev = ide_open(argc > path + 1 ? argv[path + 1] : "hda");
+	if(!image_dev)
+		return E_UNSPEC;
+
+	if(ide_block_size(image_dev) != 512) {
+		puts("can only write to a hard disk");
+		return E_UNSPEC;
+	}
+
+	heap_reset();
+
+	if(heap_space() < DISKIMAGE_RING + DISKIMAGE_BLOCK * 512) {
+		puts("not enough memory");
+		return E_UNSPEC;
+	}
+
+	base = heap_reserve_lo(0);
+
+	image_buf = base + DISKIMAGE_RING;
+	image_fill = 0;
+	image_sector = 0;
+	image_error = 0;
+	image_short = 0;
+
+	MD5Init(&image_md5);
+
+	stream_open(base, DISKIMAGE_RING);
+
+	digest_begin(path);
+
+	/* only NFS knows the image length up front */
+
+	size = 0;
+
+	if(path == 3)
+		done = tftp_stream(server, argv[3]);
+	else
+		done = nfs_stream(server, argv[3], argv[4], &size);
+
+	if(!done) {
+		digest_abort();
+		heap_reset();
+		return E_UNSPEC;
+	}
+
+	done = stream_peek(magic, sizeof(magic));
+	gzip = done == sizeof(magic) && magic[0] == 0x1f && magic[1] == 0x8b;
+
+	/* a raw image must fit, a gzip'd one is stopped when it reaches the end */
+
+	if(!gzip && size / 512 + !!(size % 512) > ide_size(image_dev)) {
+		printf("image is larger than %s\n", ide_dev_name(image_dev));
+		stream_close();
+		digest_abort();
+		heap_reset();
+		return E_UNSPEC;
+	}
+
+	printf("writing %s\n", ide_dev_name(image_dev));
+
+	timer_start(&image_progress, 1000, 1000, image_show, NULL);
+	serial_nowait(1);
+
+	if(gzip)
+		done = image_gzip();
+	else
+		done = done >= 0 && image_raw();
+
+	serial_nowait(0);
+	timer_stop(&image_progress);
+
+	stream_close();
+
+	tick = image_progress.fired;
+
+	if(tick)
+		printf("%luMB written (%luKB/sec)\n", image_sector >> 11, image_sector / 2 / tick);
+	else
+		printf("%luMB written\n", image_sector >> 11);
+
+	if(!done)
+		digest_abort();
+	else if(!digest_end(path))
+		done = 0;
+
+	if(image_sector && ide_flush(image_dev))
+		puts("cache flush failed");
+
+	if(done)
+		done = image_verify();
+
+	block_flush(NULL);
+	heap_reset();
+
+	return done ? E_NONE : E_UNSPEC;
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
@@ -10,8 +10,10 @@
 #include "cpu.h"
 #include "galileo.h"
 #include "cobalt.h"
+#include "linux/elf.h"
 
 static void *initrd_reloc;
+static int initrd_direct;
 
 /*
  * clear initrd relocation
@@ -21,6 +23,107 @@ void clear_reloc(void)
 	initrd_reloc = NULL;
 }
 
+/*
+ * find ELF load range from the start of a (possibly compressed) image
+ */
+static int image_probe(const void *image, size_t imagesz, struct elf_info *info)
+{
+	static uint32_t head[1024];
+	Elf32_Ehdr *eh32;
+	Elf64_Ehdr *eh64;
+	size_t avail;
+	int res;
+
+	avail = imagesz;
+
+	if(gzip_check(image, imagesz)) {
+
+		res = gzip_peek(image, head, sizeof(head));
+		if(res < 0)
+			return 0;
+
+		imagesz = gzip_size(image, imagesz);
+		image = head;
+		avail = res;
+	}
+
+	/* program headers must be in what we have */
+
+	eh32 = (Elf32_Ehdr *) image;
+	eh64 = (Elf64_Ehdr *) image;
+
+	if(avail >= sizeof(Elf32_Ehdr) && eh32->e_ident[EI_CLASS] == ELFCLASS32)
+		return eh32->e_phoff <= avail &&
+			avail - eh32->e_phoff >= eh32->e_phnum * sizeof(Elf32_Phdr) &&
+			elf32_validate(image, imagesz, info);
+
+	if(avail >= sizeof(Elf64_Ehdr) && eh64->e_ident[EI_CLASS] == ELFCLASS64)
+		return eh64->e_phoff <= avail &&
+			avail - eh64->e_phoff >= eh64->e_phnum * sizeof(Elf64_Phdr) &&
+			elf64_validate(image, imagesz, info);
+
+	return 0;
+}
+
+/*
+ * initrd is to be loaded straight after the kernel
+ */
+int reloc_direct(void)
+{
+	return initrd_direct;
+}
+
+/*
+ * address after the loaded kernel's ELF load range, if at least *space bytes
+ * are free there
+ */
+void *reloc_direct_addr(size_t *space)
+{
+	struct elf_info info;
+	size_t imagesz;
+	void *image, *base;
+
+	image = heap_image(&imagesz);
+
+	if(!imagesz || !image_probe(image, imagesz, &info)) {
+		puts("can't find kernel load address");
+		return NULL;
+	}
+
+	base = align_up(KSEG0(info.load_phys) + info.load_size, 4096);
+
+	if(heap_overlap(base, *space ? *space : 1, HEAP_IMAGE)) {
+		puts("kernel image is where the initrd goes");
+		return NULL;
+	}
+
+	if(heap_free_at(base) < *space) {
+		puts("no room for initrd after kernel");
+		return NULL;
+	}
+
+	*space = heap_free_at(base);
+
+	return base;
+}
+
+/*
+ * initrd has been loaded to its final address
+ */
+int reloc_direct_done(void *base, size_t size)
+{
+	if(!heap_region_place("initrd", HEAP_INITRD, base, size)) {
+		puts("can't place initrd after kernel");
+		return 0;
+	}
+
+	initrd_direct = 0;
+
+	printf("initrd loaded after kernel (%ut bytes not relocated)\n", size);
+
+	return 1;
+}
+
 /*
  * 'relocate' command
  */
@@ -31,11 +134,20 @@ int cmnd_reloc(int opsz)
 	void *image, *initrd, *load;
 	size_t imagesz, initrdsz;
 	struct elf_info info;
+	const char *name;
 	int elf32;
 
 	if(argc > 1)
 		return E_ARGS_OVER;
 
+	/* nothing loaded yet, load the initrd in place next time */
+
+	if(!heap_image(NULL)) {
+		initrd_direct = 1;
+		puts("initrd will be loaded after kernel");
+		return E_NONE;
+	}
+
 	initrd = heap_mark_image(&initrdsz);
 
 	if(!initrdsz) {
@@ -79,8 +191,27 @@ int cmnd_reloc(int opsz)
 		return E_UNSPEC;
 	}
 
+	name = heap_overlap(load, info.load_size, HEAP_DATA);
+	if(name) {
+		printf("ELF loads over '%s'\n", name);
+		return E_UNSPEC;
+	}
+
 	initrd_reloc = align_up(load + info.load_size, 4096);
 
+	if(initrd_reloc == initrd) {
+		printf("initrd already in place (%ut bytes not relocated)\n", initrdsz);
+		initrd_reloc = NULL;
+		return E_NONE;
+	}
+
+	name = heap_overlap(initrd_reloc, initrdsz, HEAP_DATA);
+	if(name) {
+		printf("relocated initrd overlaps '%s'\n", name);
+		initrd_reloc = NULL;
+		return E_UNSPEC;
+	}
+
 	heap_set_initrd(initrd_reloc, initrdsz);
 
 	return E_NONE;
@@ -134,9 +265,14 @@ int cmnd_execute(int opsz)
 	size_t imagesz, initrdsz;
 	struct elf_info info;
 	unsigned long memsz;
+	const char *name;
 	uint64_t parm[6];
 	int elf32, indx;
 
+	/* anything preloaded but not loaded isn't wanted */
+
+	preload_abort();
+
 	image = heap_image(&imagesz);
 
 	if(!imagesz) {
@@ -175,6 +311,12 @@ int cmnd_execute(int opsz)
 		return E_UNSPEC;
 	}
 
+	name = heap_overlap(load, info.load_size, HEAP_DATA);
+	if(name) {
+		printf("ELF loads over '%s'\n", name);
+		return E_UNSPEC;
+	}
+
 	/* relocate initrd */
 
 	if(initrd_reloc) {
@@ -203,6 +345,14 @@ int cmnd_execute(int opsz)
 		return E_UNSPEC;
 	}
 
+	/* remember where this boot's files were for next time */
+
+	boot_plan_commit();
+
+	/* the kernel owns the display from here */
+
+	lcd_flush();
+
 	/* no more network */
 
 	net_down(0);
@@ -248,6 +398,8 @@ int cmnd_execute(int opsz)
 
 	/* go do the thing */
 
+	drain();
+
 	launch_kernel(parm);
 
 	return E_NONE;
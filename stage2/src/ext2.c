@@ -12,9 +12,28 @@
 
 #define SCRATCH_SIZE			EXT2_MAX_BLOCK_SIZE
 #define SYMLINK_PATH_MAX	100
+#define READ_RUN_MAX			128
+
+#define PLAN_MAGIC				"CoLoPlan"
+#define PLAN_VERSION			1
+#define PLAN_ENTRIES			3
+#define PLAN_TRAIL			3
+
+#define PRELOAD_CHUNK		(64 << 10)
+
+#define PRELOAD_IDLE			0
+#define PRELOAD_WAIT			1			/* for the drives */
+#define PRELOAD_READ			2
+#define PRELOAD_HELD			3			/* stopped, data kept */
+#define PRELOAD_NONE			4			/* no volume */
 
 static char scratch[SCRATCH_SIZE];
 
+/* inodes visited by the last lookup (except the root) */
+
+static unsigned trail[PLAN_TRAIL];
+static unsigned trail_size;
+
 struct volume
 {
 	void							*device;
@@ -417,6 +436,10 @@ unsigned ext2_lookup(struct volume *v, unsigned inum, const char *path)
 	link = 0;
 	which = 0;
 
+	trail_size = 0;
+	if(inum != EXT2_ROOT_INO)
+		trail[trail_size++] = inum;
+
 	if(!ext2_inode_fetch(v, &inode[which], inum))
 		return 0;
 
@@ -448,6 +471,10 @@ unsigned ext2_lookup(struct volume *v, unsigned inum, const char *path)
 		if(stat < 1 || !ext2_inode_fetch(v, &inode[other], find.inode))
 			return 0;
 
+		if(trail_size < PLAN_TRAIL)
+			trail[trail_size] = find.inode;
+		++trail_size;
+
 		if(S_ISLNK(inode[other].i_mode)) {
 
 			if(++link == SYMLINK_PATH_MAX) {
@@ -571,29 +598,368 @@ static struct volume vol;
 static unsigned curdir;
 
 /*
- * mount disk volume
+ * The boot plan remembers which inodes the files loaded on the last boot
+ * resolved to, so the next boot can skip the directory search. An entry is
+ * trusted only if the inodes on the way (and the root) still have the same
+ * times, size and generation, otherwise we look the path up as normal.
  */
-int cmnd_mount(int opsz)
+
+#define PLAN_HASH_INIT		2166136261U
+
+struct plan_entry
+{
+	uint32_t		key;						/* volume, directory and path */
+	uint32_t		inum[PLAN_TRAIL];		/* inodes visited, target last */
+	uint32_t		stamp;					/* hash of those inodes */
+};
+
+static struct boot_plan
+{
+	uint32_t				check;			/* hash of the rest, must be first */
+	char					magic[8];
+	uint8_t				vers;
+	uint8_t				count;
+	uint8_t				spare[2];
+	struct plan_entry	entry[PLAN_ENTRIES];
+
+} plan_stored, plan_next;
+
+static unsigned long plan_size[PLAN_ENTRIES];		/* this boot's, not stored */
+
+/* the plan lives in the drive's reserved sector, if that's free for us */
+
+static uint8_t plan_sector[512];
+static int plan_usable;
+
+/* files being preloaded, 'inum' is cleared once one's been used */
+
+static struct preload
+{
+	unsigned			inum;
+	void				*base;
+	unsigned long	size;
+	unsigned long	done;
+	int				adopted;			/* region now the image */
+
+} preload[PLAN_ENTRIES];
+
+static unsigned preload_count;
+static unsigned preload_next;
+static int preload_state;
+static int preload_mounted;
+static char preload_dev[8];
+static uint8_t preload_uuid[16];
+
+static uint32_t plan_hash(uint32_t hash, const void *data, unsigned size)
+{
+	const uint8_t *ptr;
+
+	for(ptr = data; size--; ++ptr)
+		hash = (hash ^ *ptr) * 16777619;
+
+	return hash;
+}
+
+static uint32_t plan_key(const char *path)
+{
+	const char *name;
+	uint32_t hash;
+
+	name = ide_dev_name(vol.device);
+
+	hash = plan_hash(PLAN_HASH_INIT, vol.super.s_uuid, sizeof(vol.super.s_uuid));
+	hash = plan_hash(hash, name, strlen(name));
+	if(*path != '/')
+		hash = plan_hash(hash, &curdir, sizeof(curdir));
+
+	return plan_hash(hash, path, strlen(path));
+}
+
+/*
+ * hash what we check of the root and the inodes in 'inum'
+ */
+static int plan_stamp(const unsigned *inum, unsigned count, uint32_t *stamp)
 {
+	struct ext2_inode inode;
+	unsigned indx, which;
+	uint32_t hash;
+
+	hash = PLAN_HASH_INIT;
+
+	for(indx = 0; indx <= count; ++indx) {
+
+		which = indx ? inum[indx - 1] : EXT2_ROOT_INO;
+
+		if(!ext2_inode_fetch(&vol, &inode, which))
+			return 0;
+
+		hash = plan_hash(hash, &which, sizeof(which));
+		hash = plan_hash(hash, &inode.i_size, sizeof(inode.i_size));
+		hash = plan_hash(hash, &inode.i_ctime, sizeof(inode.i_ctime));
+		hash = plan_hash(hash, &inode.i_mtime, sizeof(inode.i_mtime));
+		hash = plan_hash(hash, &inode.i_generation, sizeof(inode.i_generation));
+	}
+
+	*stamp = hash;
+
+	return 1;
+}
+
+static uint32_t plan_check(const struct boot_plan *plan)
+{
+	return plan_hash(PLAN_HASH_INIT, plan->magic, sizeof(*plan) - sizeof(plan->check));
+}
+
+/*
+ * read the plan from the reserved sector of the mounted volume's drive. it's
+ * only written back if it's ours or the sector is empty
+ */
+static void plan_load(void)
+{
+	unsigned indx;
+
+	assert(sizeof(plan_stored) <= sizeof(plan_sector));
+
+	memset(&plan_stored, 0, sizeof(plan_stored));
+	plan_usable = 0;
+
+	if(ide_reserved_read(vol.device, plan_sector))
+		return;
+
+	if(!memcmp(plan_sector + offsetof(struct boot_plan, magic), PLAN_MAGIC, sizeof(plan_stored.magic))) {
+
+		plan_usable = 1;
+
+		memcpy(&plan_stored, plan_sector, sizeof(plan_stored));
+
+		if(plan_stored.check != plan_check(&plan_stored) || plan_stored.vers != PLAN_VERSION ||
+			plan_stored.count > PLAN_ENTRIES)
+			memset(&plan_stored, 0, sizeof(plan_stored));
+
+		return;
+	}
+
+	for(indx = 0; indx < sizeof(plan_sector) && !plan_sector[indx]; ++indx)
+		;
+
+	plan_usable = indx == sizeof(plan_sector);
+
+	if(!plan_usable)
+		DPUTS("ext2: reserved sector in use, no boot plan");
+}
+
+/*
+ * write the plan to the reserved sector
+ */
+static void plan_save(struct boot_plan *plan)
+{
+	memcpy(plan->magic, PLAN_MAGIC, sizeof(plan->magic));
+	plan->vers = PLAN_VERSION;
+	plan->check = plan_check(plan);
+
+	memset(plan_sector, 0, sizeof(plan_sector));
+	memcpy(plan_sector, plan, sizeof(*plan));
+
+	if(ide_reserved_write(vol.device, plan_sector))
+		puts("can't store boot plan");
+}
+
+/*
+ * find path in the plan, 0 if not there or out of date
+ */
+static unsigned plan_lookup(uint32_t key)
+{
+	struct plan_entry *entry;
+	unsigned indx, count;
+	uint32_t stamp;
+
+	for(indx = 0; indx < plan_stored.count; ++indx) {
+
+		entry = &plan_stored.entry[indx];
+		if(entry->key != key)
+			continue;
+
+		for(count = 0; count < PLAN_TRAIL && entry->inum[count]; ++count)
+			trail[count] = entry->inum[count];
+
+		if(!count || !plan_stamp(trail, count, &stamp) || stamp != entry->stamp) {
+			DPUTS("ext2: boot plan out of date");
+			break;
+		}
+
+		trail_size = count;
+
+		return trail[count - 1];
+	}
+
+	return 0;
+}
+
+/*
+ * add the last lookup to the plan for the next boot
+ */
+static void plan_note(uint32_t key, unsigned long size)
+{
+	struct plan_entry *entry;
+	unsigned indx, scan;
+	uint32_t stamp;
+
+	if(!trail_size || trail_size > PLAN_TRAIL || !plan_stamp(trail, trail_size, &stamp))
+		return;
+
+	for(indx = 0; indx < plan_next.count && plan_next.entry[indx].key != key; ++indx)
+		;
+
+	/* when full the largest files stay, they gain the most from preloading */
+
+	if(indx == PLAN_ENTRIES) {
+
+		for(indx = 0, scan = 1; scan < PLAN_ENTRIES; ++scan)
+			if(plan_size[scan] < plan_size[indx])
+				indx = scan;
+
+		if(size <= plan_size[indx])
+			return;
+	}
+
+	entry = &plan_next.entry[indx];
+
+	memset(entry, 0, sizeof(*entry));
+	entry->key = key;
+	memcpy(entry->inum, trail, trail_size * sizeof(trail[0]));
+	entry->stamp = stamp;
+
+	plan_size[indx] = size;
+
+	if(indx == plan_next.count)
+		++plan_next.count;
+}
+
+/*
+ * store the plan if this boot's differs, called when the kernel is launched
+ */
+void boot_plan_commit(void)
+{
+	if(!vol.mounted || !plan_usable || !plan_next.count)
+		return;
+
+	memcpy(plan_next.magic, PLAN_MAGIC, sizeof(plan_next.magic));
+	plan_next.vers = PLAN_VERSION;
+
+	if(!memcmp(plan_next.magic, plan_stored.magic, sizeof(plan_next) - sizeof(plan_next.check)))
+		return;
+
+	DPUTS("ext2: storing boot plan");
+
+	plan_save(&plan_next);
+
+	plan_stored = plan_next;
+}
+
+/*
+ * 'plan' shell command
+ */
+int cmnd_plan(int opsz)
+{
+	unsigned indx, count;
+
 	if(argc > 2)
 		return E_ARGS_OVER;
 
+	if(argc > 1 && strncasecmp(argv[1], "clear", strlen(argv[1])))
+		return E_BAD_VALUE;
+
+	if(!vol.mounted) {
+		puts("no EXT2 volume mounted");
+		return E_UNSPEC;
+	}
+
+	plan_load();
+
+	if(!plan_usable) {
+		puts("no room for a boot plan on this drive");
+		return E_UNSPEC;
+	}
+
+	if(argc > 1) {
+
+		memset(&plan_stored, 0, sizeof(plan_stored));
+		memset(&plan_next, 0, sizeof(plan_next));
+
+		plan_save(&plan_stored);
+
+		return E_NONE;
+	}
+
+	if(!plan_stored.count) {
+		puts("no boot plan");
+		return E_NONE;
+	}
+
+	for(indx = 0; indx < plan_stored.count; ++indx) {
+
+		for(count = 0; count < PLAN_TRAIL && plan_stored.entry[indx].inum[count]; ++count)
+			;
+
+		printf("%08x  inode %u\n", plan_stored.entry[indx].key, count ? plan_stored.entry[indx].inum[count - 1] : 0);
+	}
+
+	return E_NONE;
+}
+
+/*
+ * unmount the volume, for when the drive is wanted for something else
+ */
+void volume_release(void)
+{
+	preload_stop();
+	preload_mounted = 0;
+
 	if(vol.mounted)
 		ext2_umount(&vol);
 
+	iso_umount();
+
 	env_put("mounted-volume", NULL, VAR_OTHER);
+}
 
-	vol.device = ide_open(argc > 1 ? argv[1] : NULL);
+/*
+ * mount volume on named device (or the default)
+ */
+static int volume_mount(const char *name)
+{
+	vol.device = ide_open(name);
 	if(!vol.device)
-		return E_UNSPEC;
+		return 0;
 
 	vol.sector_size = ide_block_size(vol.device);
 
+	/* not EXT2, perhaps it's a CD */
+
 	if(!ext2_mount(&vol, 0))
-		return E_UNSPEC;
+		return iso_mount(vol.device);
 
 	curdir = EXT2_ROOT_INO;
 
+	plan_load();
+	memset(&plan_next, 0, sizeof(plan_next));
+
+	return 1;
+}
+
+/*
+ * mount disk volume
+ */
+int cmnd_mount(int opsz)
+{
+	if(argc > 2)
+		return E_ARGS_OVER;
+
+	volume_release();
+
+	if(!volume_mount(argc > 1 ? argv[1] : NULL))
+		return E_UNSPEC;
+
 	env_put("mounted-volume", ide_dev_name(vol.device), VAR_OTHER);
 
 	return E_NONE;
@@ -662,6 +1028,9 @@ int cmnd_ls(int opsz)
 	unsigned indx, inum;
 	char *path;
 
+	if(iso_mounted())
+		return iso_list();
+
 	if(!vol.mounted) {
 		puts("not mounted");
 		return E_UNSPEC;
@@ -695,10 +1064,13 @@ int cmnd_cd(int opsz)
 	struct ext2_inode inode;
 	unsigned inum;
 
-	if(argc > 1) {
+	if(argc > 2)
+		return E_ARGS_OVER;
 
-		if(argc > 2)
-			return E_ARGS_OVER;
+	if(iso_mounted())
+		return iso_chdir();
+
+	if(argc > 1) {
 
 		if(!vol.mounted) {
 			puts("not mounted");
@@ -735,13 +1107,24 @@ void *file_open(const char *path, unsigned long *size)
 {
 	struct ext2_inode inode;
 	unsigned inum;
+	uint32_t key;
+
+	if(iso_mounted())
+		return iso_open(path, size);
 
 	if(!vol.mounted) {
 		puts("not mounted");
 		return NULL;
 	}
 
-	inum = ext2_lookup(&vol, curdir, path);
+	key = plan_key(path);
+
+	inum = plan_lookup(key);
+	if(inum)
+		DPRINTF("ext2: {%s} from boot plan\n", path);
+	else
+		inum = ext2_lookup(&vol, curdir, path);
+
 	if(!inum) {
 		puts("file not found");
 		return NULL;
@@ -763,27 +1146,25 @@ void *file_open(const char *path, unsigned long *size)
 	if(size)
 		*size = inode.i_size;
 
+	plan_note(key, inode.i_size);
+
 	return (void *) inum;
 }
 
 /*
- * load file into memory
+ * read 'size' bytes of file from 'seek' (a multiple of the block size) to the
+ * same offset from 'where'
  */
-int file_load(void *hdl, void *where, unsigned long size)
+static int file_read(struct ext2_inode *inode, void *where, unsigned long seek, unsigned long size)
 {
-	struct ext2_inode inode;
-	unsigned long seek;
-	unsigned block;
+	unsigned block, count, next;
 	void *copy;
 
-	if(!ext2_inode_fetch(&vol, &inode, (unsigned) hdl))
-		return 0;
-
-	for(seek = 0; size;) {
+	while(size) {
 
 		block = seek / vol.block_size;
 
-		if(!ext2_block_map(&vol, &inode, &block))
+		if(!ext2_block_map(&vol, inode, &block))
 			return 0;
 
 		if(size < vol.block_size) {
@@ -793,20 +1174,332 @@ int file_load(void *hdl, void *where, unsigned long size)
 				return 0;
 
 			memcpy(where + seek, copy, size);
+			digest_update(where + seek, size);
 
 			break;
 		}
 
-		if(!ext2_read_block_raw(&vol, where + seek, block))
+		/* read blocks that follow on disk in one go */
+
+		for(count = 1; block && count < READ_RUN_MAX && (count + 1) * vol.block_size <= size; ++count) {
+
+			next = seek / vol.block_size + count;
+
+			if(!ext2_block_map(&vol, inode, &next))
+				return 0;
+
+			if(next != block + count)
+				break;
+		}
+
+		if(count > 1) {
+
+			if(block + count > vol.super.s_blocks_count) {
+				DPUTS("ext2: block out of range");
+				return 0;
+			}
+
+			if(!block_read_run(vol.device, where + seek, block, count, vol.block_size, vol.sector_size))
+				return 0;
+
+		} else if(!ext2_read_block_raw(&vol, where + seek, block))
 			return 0;
 
-		seek += vol.block_size;
-		size -= vol.block_size;
+		digest_update(where + seek, count * vol.block_size);
+
+		seek += count * vol.block_size;
+		size -= count * vol.block_size;
 	}
 
 	return 1;
 }
 
+/*
+ * find unused preload of file
+ */
+static struct preload *preload_find(unsigned inum, unsigned long size)
+{
+	unsigned indx;
+
+	if(!vol.mounted || strcmp(preload_dev, ide_dev_name(vol.device)) ||
+		memcmp(preload_uuid, vol.super.s_uuid, sizeof(preload_uuid)))
+		return NULL;
+
+	for(indx = 0; indx < preload_count; ++indx)
+		if(preload[indx].inum == inum && preload[indx].size == size)
+			return &preload[indx];
+
+	return NULL;
+}
+
+/*
+ * free the regions of preloads not yet used, 0 if there weren't any
+ */
+static int preload_drop(void)
+{
+	unsigned indx;
+	int freed;
+
+	freed = 0;
+
+	for(indx = 0; indx < preload_count; ++indx)
+		if(preload[indx].inum && !preload[indx].adopted) {
+			heap_region_free(preload[indx].base);
+			preload[indx].inum = 0;
+			freed = 1;
+		}
+
+	return freed;
+}
+
+/*
+ * set up a region for each file in the plan that's still current
+ */
+static void preload_setup(void)
+{
+	struct ext2_inode inode;
+	struct plan_entry *entry;
+	unsigned inum[PLAN_TRAIL];
+	unsigned indx, count;
+	struct preload *pre;
+	uint32_t stamp;
+	void *base;
+
+	strcpy(preload_dev, ide_dev_name(vol.device));
+	memcpy(preload_uuid, vol.super.s_uuid, sizeof(preload_uuid));
+
+	preload_count = 0;
+	preload_next = 0;
+
+	for(indx = 0; indx < plan_stored.count; ++indx) {
+
+		entry = &plan_stored.entry[indx];
+
+		for(count = 0; count < PLAN_TRAIL && entry->inum[count]; ++count)
+			inum[count] = entry->inum[count];
+
+		if(!count || !plan_stamp(inum, count, &stamp) || stamp != entry->stamp)
+			continue;
+
+		if(!ext2_inode_fetch(&vol, &inode, inum[count - 1]) || !S_ISREG(inode.i_mode) ||
+			!inode.i_size || (vol.large_file_mask & inode.i_size_high) ||
+			preload_find(inum[count - 1], inode.i_size))
+			continue;
+
+		base = heap_region_alloc("preload", HEAP_PRELOAD, inode.i_size, HEAP_HI);
+		if(!base)
+			continue;
+
+		pre = &preload[preload_count++];
+
+		pre->inum = inum[count - 1];
+		pre->base = base;
+		pre->size = inode.i_size;
+		pre->done = 0;
+		pre->adopted = 0;
+	}
+
+	DPRINTF("ext2: preloading %u files\n", preload_count);
+}
+
+/*
+ * bring up the disk and start reading the files the boot plan lists in the
+ * background
+ */
+void preload_start(void)
+{
+	if(preload_state != PRELOAD_IDLE && preload_state != PRELOAD_NONE)
+		return;
+
+	preload_state = PRELOAD_WAIT;
+}
+
+/*
+ * 1 once the volume is mounted and the plan looked up, 0 if the disk is
+ * still coming up, -1 if there's nothing to boot from
+ */
+int preload_ready(void)
+{
+	switch(preload_state) {
+
+		case PRELOAD_WAIT:
+			return 0;
+
+		case PRELOAD_READ:
+		case PRELOAD_HELD:
+			return 1;
+	}
+
+	return -1;
+}
+
+/*
+ * stop reading, keeping what's been read
+ */
+void preload_stop(void)
+{
+	if(preload_state == PRELOAD_WAIT)
+		preload_state = PRELOAD_IDLE;
+	else if(preload_state == PRELOAD_READ)
+		preload_state = PRELOAD_HELD;
+}
+
+/*
+ * stop reading and throw away what's not been used
+ */
+void preload_abort(void)
+{
+	preload_stop();
+
+	if(preload_mounted)
+		volume_release();
+
+	preload_drop();
+
+	preload_count = 0;
+	preload_state = PRELOAD_IDLE;
+}
+
+/*
+ * read the next chunk, background task
+ */
+void preload_poll(void)
+{
+	struct ext2_inode inode;
+	struct preload *pre;
+	unsigned long size;
+	int state;
+
+	switch(preload_state) {
+
+		case PRELOAD_WAIT:
+
+			state = ide_ready();
+			if(!state)
+				break;
+
+			if(state < 0 || (!vol.mounted && !iso_mounted() && !volume_mount(NULL))) {
+				preload_state = PRELOAD_NONE;
+				break;
+			}
+
+			preload_mounted = 1;
+
+			/* the boot plan is for EXT2 volumes only */
+
+			if(!vol.mounted) {
+				preload_state = PRELOAD_HELD;
+				break;
+			}
+
+			preload_setup();
+
+			preload_state = PRELOAD_READ;
+			break;
+
+		case PRELOAD_READ:
+
+			if(preload_next >= preload_count) {
+				DPUTS("ext2: preload complete");
+				preload_state = PRELOAD_HELD;
+				break;
+			}
+
+			pre = &preload[preload_next];
+
+			size = pre->size - pre->done;
+			if(size > PRELOAD_CHUNK)
+				size = PRELOAD_CHUNK;
+
+			/* on error keep what we have, 'load' reads the rest */
+
+			if(!ext2_inode_fetch(&vol, &inode, pre->inum) ||
+				!file_read(&inode, pre->base, pre->done, size)) {
+				++preload_next;
+				break;
+			}
+
+			pre->done += size;
+			if(pre->done == pre->size)
+				++preload_next;
+	}
+}
+
+/*
+ * reserve space to load file, which is where it's been preloaded if it has
+ */
+void *file_reserve(void *hdl, unsigned long size)
+{
+	struct preload *pre;
+	void *base;
+
+	preload_stop();
+
+	pre = preload_find((unsigned) hdl, size);
+	if(pre && !pre->adopted) {
+		pre->adopted = 1;
+		return heap_reserve_region(pre->base);
+	}
+
+	base = heap_reserve_hi(size);
+	if(!base && preload_drop())
+		base = heap_reserve_hi(size);
+
+	return base;
+}
+
+/*
+ * load file into memory, taking what's been preloaded
+ */
+int file_load(void *hdl, void *where, unsigned long size)
+{
+	struct ext2_inode inode;
+	struct preload *pre;
+	unsigned long seek;
+
+	if(iso_mounted())
+		return iso_load(hdl, where, size);
+
+	if(!ext2_inode_fetch(&vol, &inode, (unsigned) hdl))
+		return 0;
+
+	seek = 0;
+
+	pre = preload_find((unsigned) hdl, size);
+	if(pre) {
+
+		if(!pre->adopted) {
+			memcpy(where, pre->base, pre->done);
+			heap_region_free(pre->base);
+		}
+
+		if(!pre->adopted || where == pre->base) {
+			seek = pre->done;
+			digest_update(where, seek);
+			DPRINTF("ext2: %luKB preloaded\n", seek >> 10);
+		}
+
+		pre->inum = 0;
+	}
+
+	return file_read(&inode, where, seek, size - seek);
+}
+
+/*
+ * load file, checking digest given for argument
+ */
+static int load_file(void *hdl, void *where, unsigned long size, unsigned arg)
+{
+	digest_begin(arg);
+
+	if(!file_load(hdl, where, size)) {
+		digest_abort();
+		return 0;
+	}
+
+	return digest_end(arg);
+}
+
 /*
  * load file from volume
  */
@@ -814,6 +1507,10 @@ int cmnd_load(int opsz)
 {
 	unsigned long imagesz, initrdsz;
 	void *himage, *hinitrd, *base;
+	size_t space;
+
+	if(!digest_args())
+		return E_BAD_VALUE;
 
 	if(argc < 2)
 		return E_ARGS_UNDER;
@@ -836,35 +1533,51 @@ int cmnd_load(int opsz)
 
 	heap_reset();
 
-	if(hinitrd) {
+	if(hinitrd && !reloc_direct()) {
 
-		base = heap_reserve_hi(initrdsz);
+		base = file_reserve(hinitrd, initrdsz);
 		if(!base) {
 			puts("file too big");
 			return E_UNSPEC;
 		}
 
-		if(!file_load(hinitrd, base, initrdsz))
+		if(!load_file(hinitrd, base, initrdsz, 2))
 			return E_UNSPEC;
 
 		heap_alloc();
 		heap_mark();
 	}
 
-	base = heap_reserve_hi(imagesz);
+	base = file_reserve(himage, imagesz);
 	if(!base) {
 		puts("file too big");
 		heap_reset();
 		return E_UNSPEC;
 	}
 
-	if(!file_load(himage, base, imagesz)) {
+	if(!load_file(himage, base, imagesz, 1)) {
 		heap_reset();
 		return E_UNSPEC;
 	}
 
 	heap_alloc();
 
+	if(hinitrd && reloc_direct()) {
+
+		space = initrdsz;
+
+		base = reloc_direct_addr(&space);
+		if(!base || !load_file(hinitrd, base, initrdsz, 2)) {
+			heap_reset();
+			return E_UNSPEC;
+		}
+
+		if(!reloc_direct_done(base, initrdsz)) {
+			heap_reset();
+			return E_UNSPEC;
+		}
+	}
+
 	heap_initrd_vars();
 
 	heap_info();
@@ -10,10 +10,18 @@
 #include "cpu.h"
 
 #define FLASH_BASE				0x1fc00000
-#define FLASH_P					((volatile uint8_t *) KSEG1(FLASH_BASE))
 
-#define UNLOCK1(v)				do{FLASH_P[0x5555]=(v);}while(0)
-#define UNLOCK2(v)				do{FLASH_P[0x2aaa]=(v);}while(0)
+#ifdef FLASH_EMUL
+# include "flash-emul.h"
+# define FLASH_P					flash_emul_base
+#else
+# define FLASH_P					((volatile uint8_t *) KSEG1(FLASH_BASE))
+# define FLASH_RD(a)				(FLASH_P[a])
+# define FLASH_WR(a,v)			do{FLASH_P[a]=(v);}while(0)
+#endif
+
+#define UNLOCK1(v)				FLASH_WR(0x5555,v)
+#define UNLOCK2(v)				FLASH_WR(0x2aaa,v)
 #define UNLOCK1_VALUE			0xaa
 #define UNLOCK2_VALUE			0x55
 
@@ -32,6 +40,13 @@
 #define DEVICE_AM29F040			0x01a4	/* and TMS29F040 */
 
 #define FLASH_SIZE				(512 << 10)
+#define SECTOR_SIZE				(64 << 10)
+
+static uint8_t sector_save[SECTOR_SIZE];
+
+static unsigned sectors_erased;
+static unsigned bytes_programmed;
+static unsigned bytes_restored;
 
 /*
  * erase Flash block
@@ -46,14 +61,14 @@ static int flash_erase(unsigned long addr)
 	UNLOCK1(UNLOCK1_VALUE);
 	UNLOCK2(UNLOCK2_VALUE);
 
-	FLASH_P[addr] = CMND_ERASE_SECTOR;
+	FLASH_WR(addr, CMND_ERASE_SECTOR);
 
 	tick = ERASE_TIMEOUT;
 	nbad = 0;
 
-	for(prev = FLASH_P[addr];;) {
+	for(prev = FLASH_RD(addr);;) {
 
-		curr = FLASH_P[addr];
+		curr = FLASH_RD(addr);
 		test = (curr ^ prev) & (1 << 6);
 		if(!test)
 			break;
@@ -68,6 +83,8 @@ static int flash_erase(unsigned long addr)
 			break;
 		--tick;
 
+		yield();
+
 		udelay(1000);
 	}
 
@@ -87,14 +104,14 @@ static int flash_program_byte(unsigned long addr, unsigned data)
 	UNLOCK2(UNLOCK2_VALUE);
 	UNLOCK1(CMND_PROGRAM);
 	
-	FLASH_P[addr] = data;
+	FLASH_WR(addr, data);
 
 	tick = PROGRAM_TIMEOUT;
 	nbad = 0;
 
-	for(prev = FLASH_P[addr];;) {
+	for(prev = FLASH_RD(addr);;) {
 
-		curr = FLASH_P[addr];
+		curr = FLASH_RD(addr);
 		test = (curr ^ prev) & (1 << 6);
 		if(!test)
 			break;
@@ -114,41 +131,75 @@ static int flash_program_byte(unsigned long addr, unsigned data)
 
 	UNLOCK1(CMND_RESET);
 
-	return !test && FLASH_P[addr] == data;
+	return !test && FLASH_RD(addr) == data;
 }
 
 /*
- * program block to Flash, erasing as necessary
+ * program block to Flash, only erasing sectors that need it and only
+ * programming bytes that differ
  */
 static int flash_program_block(unsigned long addr, const void *data, size_t size)
 {
-	unsigned indx;
+	unsigned long sect, base, end, indx;
+	const uint8_t *src;
+	int partial;
+
+	sectors_erased = 0;
+	bytes_programmed = 0;
+	bytes_restored = 0;
+
+	src = data;
+
+	for(sect = addr & ~(SECTOR_SIZE - 1); sect < addr + size; sect += SECTOR_SIZE) {
+
+		base = sect < addr ? addr : sect;
+		end = sect + SECTOR_SIZE > addr + size ? addr + size : sect + SECTOR_SIZE;
 
-	/* erase any blocks which we can't overwrite */
+		/* erase if any bit needs to go from 0 to 1 */
 
-	for(indx = 0; indx < size; ++indx)
+		for(indx = base; indx < end; ++indx)
+			if(src[indx - addr] & ~FLASH_RD(indx))
+				break;
+
+		if(indx < end) {
 
-		if(((uint8_t *) data)[indx] & ~FLASH_P[addr + indx]) {
+			/* keep what's in the sector outside the block */
+
+			partial = base != sect || end != sect + SECTOR_SIZE;
+			if(partial)
+				memcpy(sector_save, (void *) (FLASH_P + sect), SECTOR_SIZE);
 
 			putchar('*');
 
-			if(!flash_erase(addr + indx))
-				return addr + indx;
+			if(!flash_erase(sect))
+				return sect;
 
-			/* skip on a bit */
+			++sectors_erased;
 
-			indx = ((addr + indx) | 0xfff) + 1 - addr;
+			if(partial)
+				for(indx = sect; indx < sect + SECTOR_SIZE; ++indx)
+					if((indx < base || indx >= end) && sector_save[indx - sect] != 0xff) {
+						if(!flash_program_byte(indx, sector_save[indx - sect]))
+							return indx;
+						++bytes_restored;
+					}
 		}
 
-	/* now write our data in */
+		/* now write our data in */
+
+		putchar('+');
 
-	for(indx = 0; indx < size; ++indx) {
+		for(indx = base; indx < end; ++indx) {
 
-		if(!(indx & 0x1fff))
-			putchar('+');
+			if(FLASH_RD(indx) != src[indx - addr]) {
+				if(!flash_program_byte(indx, src[indx - addr]))
+					return indx;
+				++bytes_programmed;
+			}
 
-		if(!flash_program_byte(addr + indx, ((uint8_t *) data)[indx]))
-			return addr + indx;
+			if(!(indx & 0xff))
+				yield();
+		}
 	}
 
 	return -1;
@@ -165,7 +216,7 @@ static int flash_locked(unsigned long addr)
 	UNLOCK2(UNLOCK2_VALUE);
 	UNLOCK1(CMND_AUTOSELECT);
 
-	lock = FLASH_P[addr];
+	lock = FLASH_RD(addr);
 
 	UNLOCK1(CMND_RESET);
 
@@ -183,8 +234,8 @@ static unsigned flash_ident(void)
 	UNLOCK2(UNLOCK2_VALUE);
 	UNLOCK1(CMND_AUTOSELECT);
 
-	ident = FLASH_P[AUTOSELECT_VENDOR];
-	ident = FLASH_P[AUTOSELECT_DEVICE] | (ident << 8);
+	ident = FLASH_RD(AUTOSELECT_VENDOR);
+	ident = FLASH_RD(AUTOSELECT_DEVICE) | (ident << 8);
 
 	UNLOCK1(CMND_RESET);
 
@@ -193,7 +244,8 @@ static unsigned flash_ident(void)
 
 int cmnd_flash(int opsz)
 {
-	unsigned long addr, targ, mark;
+	unsigned long addr, targ;
+	struct timer limit;
 	unsigned indx, ident, key;
 	size_t size;
 	char *ptr;
@@ -256,8 +308,8 @@ int cmnd_flash(int opsz)
 	while(kbhit())
 		getch();
 
-	for(mark = MFC0(CP0_COUNT); !kbhit();)
-		if(MFC0(CP0_COUNT) - mark >= 2 * CP0_COUNT_RATE) {
+	for(timer_set(&limit, 2 * 1000); !kbhit();)
+		if(timer_expired(&limit)) {
 			puts("\naborted");
 			return E_UNSPEC;
 		}
@@ -280,6 +332,13 @@ int cmnd_flash(int opsz)
 		return E_UNSPEC;
 	}
 
+	printf("%u of %u sectors erased, %u of %u bytes programmed",
+		sectors_erased, (unsigned) ((targ + size - 1) / SECTOR_SIZE - targ / SECTOR_SIZE + 1),
+		bytes_programmed, (unsigned) size);
+	if(bytes_restored)
+		printf(", %u restored", bytes_restored);
+	putchar('\n');
+
 	return E_NONE;
 }
 
@@ -9,41 +9,299 @@
 #include "lib.h"
 #include "cpu.h"
 
-static size_t image_size;
-static void *image_base;
+#define MAX_REGIONS				16
+#define MAX_REGION_NAME			15
 
-static size_t image_size_mark;
-static void *image_base_mark;
+#define SPAN(r)					(((r)->size + 15) & ~15)
 
-static void *free_lo;
-static void *free_hi;
+static struct region
+{
+	void			*base;
+	size_t		size;
+	unsigned		type;
+	char			name[MAX_REGION_NAME + 1];
+
+} region[MAX_REGIONS];
 
-static void *next_lo;
-static void *next_hi;
+static void *heap_lo;
+static void *heap_hi;
+
+static void *next_base;
 static size_t next_size;
 
+/*
+ * find first free gap at or above address
+ */
+static void *gap_next(void *addr, size_t *size)
+{
+	unsigned indx;
+	void *top;
+	int moved;
+
+	do {
+		moved = 0;
+		for(indx = 0; indx < MAX_REGIONS; ++indx)
+			if(region[indx].type && addr >= region[indx].base && addr < region[indx].base + SPAN(&region[indx])) {
+				addr = region[indx].base + SPAN(&region[indx]);
+				moved = 1;
+			}
+	} while(moved);
+
+	if(addr >= heap_hi) {
+		*size = 0;
+		return NULL;
+	}
+
+	top = heap_hi;
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type && region[indx].base >= addr && region[indx].base < top)
+			top = region[indx].base;
+
+	*size = top - addr;
+
+	return addr;
+}
+
+/*
+ * find a free slot in the region table
+ */
+static struct region *region_slot(void)
+{
+	unsigned indx;
+
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(!region[indx].type)
+			return &region[indx];
+
+	return NULL;
+}
+
+/*
+ * count regions of type
+ */
+static unsigned region_count(unsigned type)
+{
+	unsigned indx, count;
+
+	count = 0;
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type == type)
+			++count;
+
+	return count;
+}
+
+/*
+ * find region by type
+ */
+static struct region *region_type(unsigned type)
+{
+	unsigned indx;
+
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type == type)
+			return &region[indx];
+
+	return NULL;
+}
+
+/*
+ * find region by name
+ */
+static struct region *region_name(const char *name)
+{
+	unsigned indx;
+
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type && !strcmp(region[indx].name, name))
+			return &region[indx];
+
+	return NULL;
+}
+
+/*
+ * set/clear the {name}-start, {name}-end and {name}-size variables
+ */
+static void region_vars(struct region *rgn, int set)
+{
+	char name[MAX_REGION_NAME + 8], text[16];
+	char *ptr;
+
+	ptr = stpcpy(name, rgn->name);
+
+	strcpy(ptr, "-start");
+	sprintf(text, "%lx", (unsigned long) rgn->base);
+	env_put(name, set ? text : NULL, VAR_HEAP);
+
+	strcpy(ptr, "-end");
+	sprintf(text, "%lx", (unsigned long) rgn->base + rgn->size);
+	env_put(name, set ? text : NULL, VAR_HEAP);
+
+	strcpy(ptr, "-size");
+	sprintf(text, "%x", rgn->size);
+	env_put(name, set ? text : NULL, VAR_HEAP);
+}
+
+/*
+ * release region
+ */
+static void region_free(struct region *rgn)
+{
+	if(rgn->type == HEAP_DATA)
+		region_vars(rgn, 0);
+
+	rgn->type = 0;
+}
+
+/*
+ * enter region into table
+ */
+static void *region_add(const char *name, unsigned type, void *base, size_t size)
+{
+	struct region *rgn;
+
+	/* always leave room for an image and initrd */
+
+	if(type == HEAP_DATA && region_count(HEAP_DATA) >= MAX_REGIONS - 2)
+		return NULL;
+
+	rgn = region_slot();
+	if(!rgn)
+		return NULL;
+
+	rgn->base = base;
+	rgn->size = size;
+	rgn->type = type;
+	assert(strlen(name) <= MAX_REGION_NAME);
+	strcpy(rgn->name, name);
+
+	if(type == HEAP_DATA)
+		region_vars(rgn, 1);
+
+	return base;
+}
+
+/*
+ * release the loaded image/initrd, and any region outside the heap limits.
+ * data and preloaded files are kept
+ */
 void heap_reset(void)
 {
 	extern char __text;
 	void *restrict;
+	unsigned indx;
 
 	assert(!((unsigned long) &__text & 15));
 
-	free_lo = KSEG0(0);
-	free_hi = KSEG0(&__text) - (32 << 10);			// XXX
+	heap_lo = KSEG0(0);
+	heap_hi = KSEG0(&__text) - (32 << 10);			// XXX
 
 	restrict = KSEG0(ram_restrict) - (16 << 10);	// XXX
-	if(free_hi > restrict)
-		free_hi = restrict;
+	if(heap_hi > restrict)
+		heap_hi = restrict;
 
-	image_size = 0;
-	image_size_mark = 0;
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type && ((region[indx].type != HEAP_DATA && region[indx].type != HEAP_PRELOAD) ||
+			region[indx].base < heap_lo || region[indx].base + SPAN(&region[indx]) > heap_hi))
+			region_free(&region[indx]);
 
 	env_remove_tag(VAR_INITRD);
 
 	clear_reloc();
 }
 
+/*
+ * allocate region from lowest or highest free space that fits
+ */
+void *heap_region_alloc(const char *name, unsigned type, size_t size, int where)
+{
+	void *addr, *base;
+	size_t gap, span;
+
+	span = (size + 15) & ~15;
+	base = NULL;
+
+	for(addr = gap_next(heap_lo, &gap); addr; addr = gap_next(addr + gap, &gap))
+		if(gap >= span) {
+			base = addr + gap - span;
+			if(where == HEAP_LO) {
+				base = addr;
+				break;
+			}
+		}
+
+	if(!base)
+		return NULL;
+
+	return region_add(name, type, base, size);
+}
+
+/*
+ * size of free space starting at address
+ */
+size_t heap_free_at(void *base)
+{
+	size_t gap;
+
+	if(((unsigned long) base & 15) || base < heap_lo || gap_next(base, &gap) != base)
+		return 0;
+
+	return gap;
+}
+
+/*
+ * allocate region at a fixed address
+ */
+void *heap_region_place(const char *name, unsigned type, void *base, size_t size)
+{
+	if(heap_free_at(base) < ((size + 15) & ~15))
+		return NULL;
+
+	return region_add(name, type, base, size);
+}
+
+/*
+ * release region by base address
+ */
+void heap_region_free(void *base)
+{
+	unsigned indx;
+
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type && region[indx].base == base)
+			region_free(&region[indx]);
+}
+
+/*
+ * find first region of type
+ */
+void *heap_region_find(unsigned type, size_t *size)
+{
+	struct region *rgn;
+
+	rgn = region_type(type);
+
+	if(size)
+		*size = rgn ? rgn->size : 0;
+
+	return rgn ? rgn->base : NULL;
+}
+
+/*
+ * return name of a region of type that overlaps the range
+ */
+const char *heap_overlap(void *base, size_t size, unsigned type)
+{
+	unsigned indx;
+
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type == type && base < region[indx].base + region[indx].size &&
+			base + size > region[indx].base)
+			return region[indx].name;
+
+	return NULL;
+}
+
 void heap_set_initrd(void *base, size_t size)
 {
 	char text[16];
@@ -58,112 +316,308 @@ void heap_set_initrd(void *base, size_t size)
 
 void heap_initrd_vars(void)
 {
-	if(image_size_mark)
-		heap_set_initrd(image_base_mark, image_size_mark);
+	struct region *rgn;
+
+	rgn = region_type(HEAP_INITRD);
+	if(rgn)
+		heap_set_initrd(rgn->base, rgn->size);
 }
 
+/*
+ * size of largest free gap
+ */
 size_t heap_space(void)
 {
-	return free_hi - free_lo;
+	size_t gap, best;
+	void *addr;
+
+	best = 0;
+	for(addr = gap_next(heap_lo, &gap); addr; addr = gap_next(addr + gap, &gap))
+		if(gap > best)
+			best = gap;
+
+	return best;
 }
 
+/*
+ * reserve space at the base of the largest free gap
+ */
 void *heap_reserve_lo(size_t size)
 {
+	size_t gap, best;
+	void *addr;
+
 	next_size = size;
+	next_base = NULL;
+
+	best = 0;
+	for(addr = gap_next(heap_lo, &gap); addr; addr = gap_next(addr + gap, &gap))
+		if(gap > best) {
+			best = gap;
+			next_base = addr;
+		}
+
+	if(((size + 15) & ~15) > best)
+		next_base = NULL;
 
-	size = (size + 15) & ~15;
+	return next_base;
+}
+
+/*
+ * reserve space at a fixed address, the first span bytes may only overlap the
+ * current image (which is released when the reservation is allocated)
+ */
+void *heap_reserve_at(void *base, size_t size, size_t span)
+{
+	unsigned indx;
+
+	next_size = size;
+	next_base = NULL;
 
-	if(size > heap_space())
+	if(((unsigned long) base & 15) || base < heap_lo || base + span > heap_hi)
 		return NULL;
 
-	next_lo = free_lo + size;
-	next_hi = free_hi;
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type && region[indx].type != HEAP_IMAGE &&
+			base < region[indx].base + SPAN(&region[indx]) && base + span > region[indx].base)
+			return NULL;
 
-	return free_lo;
+	next_base = base;
+
+	return next_base;
 }
 
+/*
+ * reserve space at the top of the highest free gap that fits
+ */
 void *heap_reserve_hi(size_t size)
 {
+	size_t gap, span;
+	void *addr;
+
 	next_size = size;
+	next_base = NULL;
 
-	size = (size + 15) & ~15;
+	span = (size + 15) & ~15;
 
-	if(size > heap_space())
-		return NULL;
+	for(addr = gap_next(heap_lo, &gap); addr; addr = gap_next(addr + gap, &gap))
+		if(gap >= span)
+			next_base = addr + gap - span;
+
+	return next_base;
+}
 
-	next_lo = free_lo;
-	next_hi = free_hi - size;
+/*
+ * reserve the space held by a preloaded region, which becomes the image
+ * when the reservation is allocated
+ */
+void *heap_reserve_region(void *base)
+{
+	unsigned indx;
+
+	next_base = NULL;
 
-	return next_hi;
+	for(indx = 0; indx < MAX_REGIONS; ++indx)
+		if(region[indx].type == HEAP_PRELOAD && region[indx].base == base) {
+			next_base = base;
+			next_size = region[indx].size;
+			region_free(&region[indx]);
+			break;
+		}
+
+	return next_base;
 }
 
 void heap_info(void)
 {
-	if(image_size) {
-		printf("%08x %ut\n", image_size, image_size);
-		if(image_size_mark)
-			printf("%08x %ut\n", image_size_mark, image_size_mark);
+	struct region *image, *initrd;
+
+	image = region_type(HEAP_IMAGE);
+	initrd = region_type(HEAP_INITRD);
+
+	if(image) {
+		printf("%08x %ut\n", image->size, image->size);
+		if(initrd)
+			printf("%08x %ut\n", initrd->size, initrd->size);
 	} else
 		puts("no image loaded");
 }
 
+/*
+ * commit last reservation as the image, replacing any previous image
+ */
 void heap_alloc(void)
 {
-	if(next_lo != free_lo) {
+	struct region *rgn;
 
-		image_base = free_lo;
-		free_lo = next_lo;
+	assert(next_base);
 
-	} else {
+	rgn = region_type(HEAP_IMAGE);
+	if(rgn)
+		region_free(rgn);
 
-		image_base = next_hi;
-		free_hi = next_hi;
-	}
-
-	image_size = next_size;
+	region_add("image", HEAP_IMAGE, next_base, next_size);
 }
 
 void *heap_image(size_t *size)
 {
-	if(size)
-		*size = image_size;
-
-	return image_base;
+	return heap_region_find(HEAP_IMAGE, size);
 }
 
+/*
+ * turn the image into the initrd
+ */
 void heap_mark(void)
 {
-	image_base_mark = image_base;
-	image_size_mark = image_size;
+	struct region *rgn;
+
+	rgn = region_type(HEAP_INITRD);
+	if(rgn)
+		region_free(rgn);
+
+	rgn = region_type(HEAP_IMAGE);
+	if(rgn) {
+		rgn->type = HEAP_INITRD;
+		strcpy(rgn->name, "initrd");
+	}
 }
 
 void *heap_mark_image(size_t *size)
 {
-	if(size)
-		*size = image_size_mark;
-
-	return image_base_mark;
+	return heap_region_find(HEAP_INITRD, size);
 }
 
-int cmnd_heap(int opsz)
+/*
+ * shell command - image
+ */
+int cmnd_image(int opsz)
 {
+	struct region *image, *initrd;
+
 	if(argc > 1)
 		return E_ARGS_OVER;
 
-	if(image_size) {
+	image = region_type(HEAP_IMAGE);
+	initrd = region_type(HEAP_INITRD);
+
+	if(image) {
 		printf("%08lx - %08lx (%08x %ut)\n",
-			(unsigned long) image_base, (unsigned long) image_base + image_size - 1,
-			image_size, image_size);
-		if(image_size_mark)
+			(unsigned long) image->base, (unsigned long) image->base + image->size - 1,
+			image->size, image->size);
+		if(initrd)
 			printf("%08lx - %08lx (%08x %ut)\n",
-				(unsigned long) image_base_mark, (unsigned long) image_base_mark + image_size_mark - 1,
-				image_size_mark, image_size_mark);
+				(unsigned long) initrd->base, (unsigned long) initrd->base + initrd->size - 1,
+				initrd->size, initrd->size);
 	} else
 		printf("no image loaded (%uKB)\n", heap_space() >> 10);
 
 	return E_NONE;
 }
 
+/*
+ * list regions and free space in address order
+ */
+static void heap_list(void)
+{
+	static const char *types[] = { "free", "image", "initrd", "data", "cache" };
+	struct region *rgn;
+	unsigned indx;
+	void *addr;
+	size_t gap;
+
+	for(addr = heap_lo; addr < heap_hi;) {
+
+		rgn = NULL;
+		for(indx = 0; indx < MAX_REGIONS; ++indx)
+			if(region[indx].type && region[indx].base >= addr && (!rgn || region[indx].base < rgn->base))
+				rgn = &region[indx];
+
+		if(!rgn || rgn->base > addr) {
+
+			gap = (rgn ? rgn->base : heap_hi) - addr;
+
+			printf("%08lx - %08lx %-6s %08x %ut\n",
+				(unsigned long) addr, (unsigned long) addr + gap - 1, types[0], gap, gap);
+
+			addr += gap;
+		}
+
+		if(rgn) {
+
+			printf("%08lx - %08lx %-6s %08x %ut %s\n",
+				(unsigned long) rgn->base, (unsigned long) rgn->base + rgn->size - 1,
+				types[rgn->type], rgn->size, rgn->size, rgn->name);
+
+			addr = rgn->base + SPAN(rgn);
+
+		} else
+
+			break;
+	}
+}
+
+/*
+ * shell command - heap
+ */
+int cmnd_heap(int opsz)
+{
+	struct region *rgn;
+
+	if(argc < 2) {
+		heap_list();
+		return E_NONE;
+	}
+
+	if(argc < 3)
+		return E_ARGS_UNDER;
+	if(argc > 3)
+		return E_ARGS_OVER;
+
+	if(!strcmp(argv[1], "keep")) {
+
+		rgn = region_type(HEAP_IMAGE);
+		if(!rgn) {
+			puts("no image loaded");
+			return E_UNSPEC;
+		}
+
+		if(strlen(argv[2]) > MAX_REGION_NAME || region_name(argv[2])) {
+			puts("bad region name");
+			return E_BAD_VALUE;
+		}
+
+		if(region_count(HEAP_DATA) >= MAX_REGIONS - 2) {
+			puts("too many regions");
+			return E_UNSPEC;
+		}
+
+		strcpy(rgn->name, argv[2]);
+		rgn->type = HEAP_DATA;
+
+		region_vars(rgn, 1);
+
+		return E_NONE;
+	}
+
+	if(!strcmp(argv[1], "free")) {
+
+		rgn = region_name(argv[2]);
+		if(!rgn) {
+			puts("no such region");
+			return E_UNSPEC;
+		}
+
+		if(rgn->type == HEAP_INITRD)
+			env_remove_tag(VAR_INITRD);
+
+		region_free(rgn);
+
+		return E_NONE;
+	}
+
+	return E_BAD_VALUE;
+}
+
 int cmnd_restrict(int opsz)
 {
 	unsigned long val;
@@ -10,74 +10,131 @@
 #include "cpu.h"
 #include "pci.h"
 #include "galileo.h"
+#include "rawboot.h"
 
 #define PIO_MODE_DEFAULT			0
 
 #define TIMEOUT_RESET				(30 * 100)
 #define TIMEOUT_IDENTIFY			(2 * 100)
 #define TIMEOUT_ATA_READ			(5 * 100)
+#define TIMEOUT_ATA_WRITE			(10 * 100)
+#define TIMEOUT_ATA_FLUSH			(30 * 100)
 #define TIMEOUT_ATAPI_READ			(10 * 100)
 #define TIMEOUT_PACKET				(1 * 100)
 #define TIMEOUT_REQUEST_SENSE		(1 * 100)
 
-#define IDE_REG_DATA					(*(volatile uint16_t *) &BRDG_ISA_SPACE[0x1f0])
-#define IDE_REG_ERROR				(BRDG_ISA_SPACE[0x1f1])
-#define IDE_REG_FEATURE				(BRDG_ISA_SPACE[0x1f1])
-#define IDE_REG_NSECT				(BRDG_ISA_SPACE[0x1f2])
-#define IDE_REG_SECTOR				(BRDG_ISA_SPACE[0x1f3])
-#define IDE_REG_CYL_LO				(BRDG_ISA_SPACE[0x1f4])
-#define IDE_REG_CYL_HI				(BRDG_ISA_SPACE[0x1f5])
-#define IDE_REG_HEAD					(BRDG_ISA_SPACE[0x1f6])
+#define IDE_REG_DATA(c)					(*(volatile uint16_t *) &BRDG_ISA_SPACE[(c)->base + 0])
+#define IDE_REG_ERROR(c)				(BRDG_ISA_SPACE[(c)->base + 1])
+#define IDE_REG_FEATURE(c)				(BRDG_ISA_SPACE[(c)->base + 1])
+#define IDE_REG_NSECT(c)				(BRDG_ISA_SPACE[(c)->base + 2])
+#define IDE_REG_SECTOR(c)				(BRDG_ISA_SPACE[(c)->base + 3])
+#define IDE_REG_CYL_LO(c)				(BRDG_ISA_SPACE[(c)->base + 4])
+#define IDE_REG_CYL_HI(c)				(BRDG_ISA_SPACE[(c)->base + 5])
+#define IDE_REG_HEAD(c)					(BRDG_ISA_SPACE[(c)->base + 6])
 # define REG_HEAD_SLAVE				(1 << 4)
 # define REG_HEAD_LBA				(1 << 6)
 # define REG_HEAD_DEFAULT			((1 << 7) | (1 << 5))
-#define IDE_REG_STATUS				(BRDG_ISA_SPACE[0x1f7])
+#define IDE_REG_STATUS(c)				(BRDG_ISA_SPACE[(c)->base + 7])
 # define REG_STATUS_ERR				(1 << 0)
 # define REG_STATUS_DRQ				(1 << 3)
 # define REG_STATUS_BSY				(1 << 7)
-#define IDE_REG_COMMAND				(BRDG_ISA_SPACE[0x1f7])
-#define IDE_REG_STATUS_ALT			(BRDG_ISA_SPACE[0x3f6])
-#define IDE_REG_CONTROL				(BRDG_ISA_SPACE[0x3f6])
+#define IDE_REG_COMMAND(c)				(BRDG_ISA_SPACE[(c)->base + 7])
+#define IDE_REG_STATUS_ALT(c)			(BRDG_ISA_SPACE[(c)->ctrl])
+#define IDE_REG_CONTROL(c)				(BRDG_ISA_SPACE[(c)->ctrl])
 # define REG_CONTROL_RESET			(1 << 2)
 # define REG_CONTROL_DEFAULT		(1 << 3)
 
 #define ATA_READ						0x20
 #define ATA_READ_EXT					0x24
+#define ATA_WRITE						0x30
+#define ATA_WRITE_EXT				0x34
+#define ATA_FLUSH_CACHE				0xe7
+#define ATA_FLUSH_CACHE_EXT		0xea
 #define ATA_PACKET					0xa0
 #define ATA_ATAPI_IDENTIFY			0xa1
 #define ATA_IDENTIFY					0xec
 #define ATAPI_REQUEST_SENSE		0x03
 #define ATAPI_READ_10				0x28
+#define ATAPI_READ_12				0xa8
 
-#define ATA_READ_BLOCK				64
-#define ATAPI_READ_BLOCK			64
+#define ATA_READ_BLOCK				256
+#define ATA_WRITE_BLOCK				256
+#define ATAPI_READ_BLOCK			64			/* least we'll drop to */
+#define ATAPI_BYTE_LIMIT			0xf800	/* 31 sectors each DRQ */
 
-#define FLAG_RESETTING				(1 << 0)
 #define FLAG_IDENTIFIED				(1 << 1)
 #define FLAG_LBA						(1 << 2)
 #define FLAG_LBA_48					(1 << 3)
 #define FLAG_ATAPI					(1 << 4)
 
+#define CHAN_RESETTING				(1 << 0)
+#define CHAN_EMPTY					(1 << 1)
+#define CHAN_RESET_DONE				(1 << 2)		/* not again until it's needed */
+
 #define PART_TYPE_EXT2				0x83
+#define RESERVED_SECTOR				62			/* last of the first track */
 #define PART_TYPE_RAID				0xfd
 
-static struct ide_device
+#define MD_MAGIC						0xa92b4efc
+#define MD_LEVEL_RAID1				1
+#define MD_MEMBERS					4
+#define MD_CHUNK						256			/* sectors read from one member in turn */
+#define MD_DISK_FAULTY				(1 << 0)		/* 0.90 disk state */
+#define MD_DISK_ACTIVE				(1 << 1)
+#define MD_DISK_SYNC					(1 << 2)
+#define MD_ROLE_MAX					0xff00		/* 1.x roles above are spare or faulty */
+#define MD_FEATURE_RECOVERY		(1 << 1)		/* 1.x member still being rebuilt */
+
+static struct ide_channel
 {
-	const char		*name;
-	unsigned			select;
+	unsigned			base;				/* command block registers */
+	unsigned			ctrl;				/* control register */
+	unsigned			enable;			/* VIA channel enable bit */
+	unsigned			timing;			/* VIA master drive timing register */
+	unsigned			setup;			/* shift of master's VIA address setup bits */
+	unsigned			recover;			/* VIA command timing register */
+
 	unsigned			flags;
-	unsigned			mode;
+	unsigned			reg_head;
+	struct timer	reset_timer;
+	unsigned			reset_drive;
 
-	unsigned long	devsize;
-	unsigned			nsects;
-	unsigned			ncyls;
-	unsigned			nheads;
+} ide_chan[] = {
+	{
+		.base = 0x1f0, .ctrl = 0x3f6, .enable = 1 << 1, .timing = 0x4b, .setup = 6, .recover = 0x4f,
+	}, {
+		.base = 0x170, .ctrl = 0x376, .enable = 1 << 0, .timing = 0x49, .setup = 2, .recover = 0x4e,
+	}
+};
 
-} ide_bus[2] = {
+static struct ide_device
+{
+	const char				*name;
+	struct ide_channel	*chan;
+	unsigned					select;
+	unsigned					flags;
+	unsigned					mode;
+
+	unsigned long			devsize;
+	unsigned long			atapi_max;		/* largest read taken */
+	unsigned					nsects;
+	unsigned					ncyls;
+	unsigned					nheads;
+
+} ide_bus[] = {
 	{
-		.name = "hda"
+		.name = "hda",
+		.chan = &ide_chan[0],
 	}, {
 		.name = "hdb",
+		.chan = &ide_chan[0],
+		.select = REG_HEAD_SLAVE
+	}, {
+		.name = "hdc",
+		.chan = &ide_chan[1],
+	}, {
+		.name = "hdd",
+		.chan = &ide_chan[1],
 		.select = REG_HEAD_SLAVE
 	}
 };
@@ -93,16 +150,87 @@ struct part_entry
 
 } __attribute__((packed));
 
+struct part_table
+{
+	uint8_t				padding[512 - sizeof(uint16_t) - 4 * sizeof(struct part_entry)];
+	struct part_entry	p[4];
+	uint16_t				signature;
+
+} __attribute__((packed));
+
+struct md_info
+{
+	uint8_t				uuid[16];
+	unsigned long		data;
+	unsigned long		size;				/* of the data */
+	uint64_t				events;
+	int					active;			/* member in sync with the set */
+	int					level;
+	const char			*metadata;
+};
+
+/* a read under way, one can be running on each channel at once */
+
+struct ata_request
+{
+	struct ide_device	*dev;
+	void					*data;
+	unsigned long		addr;
+	unsigned				count;			/* sectors still to read */
+	unsigned				nsect;			/* sectors still to come from the current command */
+	unsigned				cmnd;
+	struct timer		limit;
+};
+
+struct md_member
+{
+	struct ide_device	*dev;
+	unsigned long		offset;
+	uint64_t				events;
+	int					failed;
+	unsigned				reads;
+	unsigned long		sectors;
+	unsigned				errors;
+	char					ident[8];
+};
+
 static struct
 {
 	struct ide_device	*dev;
 	unsigned long		offset;
+	unsigned long		size;				/* sectors writes are kept to */
 	unsigned				block;
 	char					ident[8];
 
+	/* RAID1 members, 'members' is 0 unless it's a mirror */
+
+	struct md_member	member[MD_MEMBERS];
+	unsigned				members;
+	const char			*metadata;
+
 } selected;
 
-static unsigned reg_head;
+/*
+ * the secondary channel is only used if asked for
+ */
+static int ide_chan_used(const struct ide_channel *chan)
+{
+	return chan == ide_chan || (nv_store.flags & NVFLAG_IDE_ENABLE_SECONDARY);
+}
+
+/*
+ * any drives identified on any channel
+ */
+static int ide_identified(void)
+{
+	unsigned indx;
+
+	for(indx = 0; indx < elements(ide_bus); ++indx)
+		if(ide_bus[indx].flags & FLAG_IDENTIFIED)
+			return 1;
+
+	return 0;
+}
 
 /*
  * select drive
@@ -113,84 +241,136 @@ static void ide_select(struct ide_device *dev)
 
 	head = REG_HEAD_DEFAULT | dev->select;
 
-	if(reg_head != head) {
+	if(dev->chan->reg_head != head) {
 
-		reg_head = head;
+		dev->chan->reg_head = head;
 
-		IDE_REG_HEAD = reg_head;
+		IDE_REG_HEAD(dev->chan) = head;
 
 		udelay(500);
 	}
 }
 
 /*
- * reset drives but don't wait
+ * a drive on the channel stopped answering, reset it next time round
+ */
+static void ide_chan_fault(struct ide_channel *chan)
+{
+	chan->flags &= ~CHAN_RESET_DONE;
+}
+
+/*
+ * reset drives but don't wait, all channels together. channels that are
+ * being or have been reset are left alone
  */
 static void ide_reset_async(void)
 {
-	if(!(ide_bus[0].flags & FLAG_RESETTING)) {
+	struct ide_channel *chan;
+
+	for(chan = ide_chan; chan < ide_chan + elements(ide_chan); ++chan) {
+
+		if(!ide_chan_used(chan) || (chan->flags & (CHAN_RESETTING | CHAN_RESET_DONE)))
+			continue;
 
-		DPUTS("ide: resetting");
+		DPRINTF("ide: resetting 0x%03x\n", chan->base);
 
-		IDE_REG_CONTROL = REG_CONTROL_DEFAULT | REG_CONTROL_RESET;
+		IDE_REG_CONTROL(chan) = REG_CONTROL_DEFAULT | REG_CONTROL_RESET;
 		udelay(500);
-		IDE_REG_CONTROL = REG_CONTROL_DEFAULT;
+		IDE_REG_CONTROL(chan) = REG_CONTROL_DEFAULT;
 		udelay(500);
 
-		ide_bus[0].flags |= FLAG_RESETTING;
-		ide_bus[1].flags |= FLAG_RESETTING;
+		chan->flags = CHAN_RESETTING;
 
-		reg_head = -1;
+		timer_set(&chan->reset_timer, TIMEOUT_RESET * 10);
+		chan->reset_drive = 0;
+
+		chan->reg_head = -1;
 	}
 }
 
 /*
- * reset drives
+ * check progress of reset, 1 if done, 0 if busy, -1 if timed out. a
+ * channel that floats (reads 0xff) or times out is left empty
  */
-static int ide_reset(void)
+static int ide_reset_poll(void)
 {
-	unsigned mark, timeout;
-	int drive;
+	struct ide_channel *chan;
+	struct ide_device *dev;
+	int busy, found;
 
-	ide_reset_async();
+	busy = found = 0;
 
-	ide_bus[0].flags &= ~FLAG_RESETTING;
-	ide_bus[1].flags &= ~FLAG_RESETTING;
+	for(chan = ide_chan; chan < ide_chan + elements(ide_chan); ++chan) {
 
-	timeout = TIMEOUT_RESET;
+		if(!ide_chan_used(chan))
+			continue;
 
-	drive = 0;
+		for(; chan->flags & CHAN_RESETTING; ++chan->reset_drive) {
 
-	ide_select(&ide_bus[drive]);
+			if(chan->reset_drive == 2) {
+				chan->flags = CHAN_RESET_DONE;
+				break;
+			}
 
-	for(mark = MFC0(CP0_COUNT);;) {
+			for(dev = ide_bus; dev->chan != chan; ++dev)
+				;
 
-		if(MFC0(CP0_COUNT) - mark >= CP0_COUNT_RATE / 100) {
+			ide_select(dev + chan->reset_drive);
 
-			if(!(IDE_REG_STATUS & REG_STATUS_BSY)) {
+			if(IDE_REG_STATUS(chan) == 0xff) {
 
-				if(++drive == 2)
-					break;
+				DPRINTF("ide: nothing at 0x%03x\n", chan->base);
 
-				ide_select(&ide_bus[drive]);
+				chan->flags = CHAN_EMPTY | CHAN_RESET_DONE;
+				break;
+			}
 
-			} else
+			if(IDE_REG_STATUS(chan) & REG_STATUS_BSY) {
 
-				if((int) --timeout <= 0) {
-					DPUTS("ide: reset timeout");
-					return -1;
+				if(timer_expired(&chan->reset_timer)) {
+					DPRINTF("ide: reset timeout 0x%03x\n", chan->base);
+					chan->flags = CHAN_EMPTY | CHAN_RESET_DONE;
+					break;
 				}
 
-			mark += CP0_COUNT_RATE / 100;
+				++busy;
+				break;
+			}
 		}
 
-		if(BREAK()) {
-			ide_reset_async();
+		if(!(chan->flags & CHAN_EMPTY))
+			++found;
+	}
+
+	if(busy)
+		return 0;
+
+	return found ? 1 : -1;
+}
+
+/*
+ * reset drives for a new probe, waiting only for what's left of a reset
+ * already in progress
+ */
+static int ide_reset(void)
+{
+	struct ide_channel *chan;
+	int state;
+
+	for(chan = ide_chan; chan < ide_chan + elements(ide_chan); ++chan)
+		chan->flags &= ~CHAN_RESET_DONE;
+
+	ide_reset_async();
+
+	while(!(state = ide_reset_poll())) {
+
+		if(BREAK())
 			return -1;
-		}
+
+		timer_sleep(10);
 	}
 
-	return 0;
+	return state < 0 ? -1 : 0;
 }
 
 /*
@@ -198,34 +378,32 @@ static int ide_reset(void)
  */
 static int ata_read(struct ide_device *dev, unsigned cmnd, void *data, unsigned count, unsigned timeout)
 {
-	unsigned stat, expire;
-	unsigned long mark;
+	struct timer limit;
+	unsigned stat;
 	void *end;
 
 	assert(!((unsigned long) data & 1));
 	
-	if(IDE_REG_STATUS & (REG_STATUS_BSY | REG_STATUS_DRQ)) {
+	if(IDE_REG_STATUS(dev->chan) & (REG_STATUS_BSY | REG_STATUS_DRQ)) {
 		printf("ide: 0x%02x drive busy\n", cmnd);
 		return -1;
 	}
 
-	IDE_REG_COMMAND = cmnd;
+	IDE_REG_COMMAND(dev->chan) = cmnd;
 	udelay(1);
 
 	for(;;) {
 
-		expire = timeout;
-
-		for(mark = MFC0(CP0_COUNT);;) {
+		for(timer_set(&limit, timeout * 10);;) {
 
-			stat = IDE_REG_STATUS;
+			stat = IDE_REG_STATUS(dev->chan);
 
 			if(!(stat & REG_STATUS_BSY)) {
 
 				if(stat & REG_STATUS_ERR) {
 
 					if(cmnd != ATA_IDENTIFY)
-						printf("ide: 0x%02x error 0x%02x\n", cmnd, IDE_REG_ERROR);
+						printf("ide: 0x%02x error 0x%02x\n", cmnd, IDE_REG_ERROR(dev->chan));
 
 					return -1;
 				}
@@ -237,32 +415,102 @@ static int ata_read(struct ide_device *dev, unsigned cmnd, void *data, unsigned
 					break;
 			}
 
-			if(MFC0(CP0_COUNT) - mark >= CP0_COUNT_RATE / 100) {
+			if(timer_expired(&limit)) {
+				printf("ide: 0x%02x command timeout\n", cmnd);
+				ide_chan_fault(dev->chan);
+				return -1;
+			}
+
+			yield();
+		}
+
+		for(end = data + 512; data < end; data += 16) {
+
+			((uint16_t *) data)[0] = IDE_REG_DATA(dev->chan);
+			((uint16_t *) data)[1] = IDE_REG_DATA(dev->chan);
+			((uint16_t *) data)[2] = IDE_REG_DATA(dev->chan);
+			((uint16_t *) data)[3] = IDE_REG_DATA(dev->chan);
+			((uint16_t *) data)[4] = IDE_REG_DATA(dev->chan);
+			((uint16_t *) data)[5] = IDE_REG_DATA(dev->chan);
+			((uint16_t *) data)[6] = IDE_REG_DATA(dev->chan);
+			((uint16_t *) data)[7] = IDE_REG_DATA(dev->chan);
+		}
+
+		--count;
+
+		IDE_REG_STATUS_ALT(dev->chan);
+
+		yield();
+	}
+}
+
+/*
+ * issue ATA write command to drive, 'count' 0 for a command with no data
+ */
+static int ata_write(struct ide_device *dev, unsigned cmnd, const void *data, unsigned count, unsigned timeout)
+{
+	struct timer limit;
+	const void *end;
+	unsigned stat;
+
+	assert(!((unsigned long) data & 1));
+
+	if(IDE_REG_STATUS(dev->chan) & (REG_STATUS_BSY | REG_STATUS_DRQ)) {
+		printf("ide: 0x%02x drive busy\n", cmnd);
+		return -1;
+	}
+
+	IDE_REG_COMMAND(dev->chan) = cmnd;
+	udelay(1);
+
+	for(;;) {
 
-				if((int) --expire <= 0) {
-					printf("ide: 0x%02x command timeout\n", cmnd);
+		for(timer_set(&limit, timeout * 10);;) {
+
+			stat = IDE_REG_STATUS(dev->chan);
+
+			if(!(stat & REG_STATUS_BSY)) {
+
+				if(stat & REG_STATUS_ERR) {
+					printf("ide: 0x%02x error 0x%02x\n", cmnd, IDE_REG_ERROR(dev->chan));
 					return -1;
 				}
 
-				mark += CP0_COUNT_RATE / 100;
+				/* done once the drive has taken the last sector */
+
+				if(!count)
+					return 0;
+
+				if(stat & REG_STATUS_DRQ)
+					break;
+			}
+
+			if(timer_expired(&limit)) {
+				printf("ide: 0x%02x command timeout\n", cmnd);
+				ide_chan_fault(dev->chan);
+				return -1;
 			}
+
+			yield();
 		}
 
 		for(end = data + 512; data < end; data += 16) {
 
-			((uint16_t *) data)[0] = IDE_REG_DATA;
-			((uint16_t *) data)[1] = IDE_REG_DATA;
-			((uint16_t *) data)[2] = IDE_REG_DATA;
-			((uint16_t *) data)[3] = IDE_REG_DATA;
-			((uint16_t *) data)[4] = IDE_REG_DATA;
-			((uint16_t *) data)[5] = IDE_REG_DATA;
-			((uint16_t *) data)[6] = IDE_REG_DATA;
-			((uint16_t *) data)[7] = IDE_REG_DATA;
+			IDE_REG_DATA(dev->chan) = ((const uint16_t *) data)[0];
+			IDE_REG_DATA(dev->chan) = ((const uint16_t *) data)[1];
+			IDE_REG_DATA(dev->chan) = ((const uint16_t *) data)[2];
+			IDE_REG_DATA(dev->chan) = ((const uint16_t *) data)[3];
+			IDE_REG_DATA(dev->chan) = ((const uint16_t *) data)[4];
+			IDE_REG_DATA(dev->chan) = ((const uint16_t *) data)[5];
+			IDE_REG_DATA(dev->chan) = ((const uint16_t *) data)[6];
+			IDE_REG_DATA(dev->chan) = ((const uint16_t *) data)[7];
 		}
 
 		--count;
 
-		IDE_REG_STATUS_ALT;
+		IDE_REG_STATUS_ALT(dev->chan);
+
+		yield();
 	}
 }
 
@@ -351,6 +599,7 @@ static int ide_atapi_identify(struct ide_device *dev, const void *info)
 #endif
 
 	dev->mode = ide_identify_mode(info);
+	dev->atapi_max = ~0UL;
 
 	dev->flags |= FLAG_IDENTIFIED | FLAG_ATAPI;
 
@@ -436,17 +685,17 @@ static int ide_identify(struct ide_device *dev)
 
 	dev->flags = 0;
 
-	IDE_REG_CYL_LO = 0x55;
-	IDE_REG_CYL_HI = 0xaa;
+	IDE_REG_CYL_LO(dev->chan) = 0x55;
+	IDE_REG_CYL_HI(dev->chan) = 0xaa;
 
-	if(IDE_REG_CYL_LO == 0x55 ||
-		IDE_REG_CYL_HI == 0xaa) {
+	if(IDE_REG_CYL_LO(dev->chan) == 0x55 ||
+		IDE_REG_CYL_HI(dev->chan) == 0xaa) {
 
 		if(!ata_read(dev, ATA_IDENTIFY, data, 1, TIMEOUT_IDENTIFY)) 
 			return ide_ata_identify(dev, data);
 
-		if(IDE_REG_CYL_LO == 0x14 &&
-			IDE_REG_CYL_HI == 0xeb &&
+		if(IDE_REG_CYL_LO(dev->chan) == 0x14 &&
+			IDE_REG_CYL_HI(dev->chan) == 0xeb &&
 			!ata_read(dev, ATA_ATAPI_IDENTIFY, data, 1, TIMEOUT_IDENTIFY)) {
 
 			return ide_atapi_identify(dev, data);
@@ -459,40 +708,44 @@ static int ide_identify(struct ide_device *dev)
 }
 
 /*
- * issue ATAPI read command to drive
+ * issue ATAPI read command to drive, 'blksz' * 'count' bytes taken in
+ * whatever pieces the drive offers them
  */
 static int atapi_read(struct ide_device *dev, const void *cmnd, void *data, unsigned blksz, unsigned count, unsigned timeout)
 {
-	unsigned stat, expire, indx;
-	unsigned long mark;
+	unsigned stat, indx, size;
+	unsigned long left;
+	struct timer limit;
 
 	assert((dev->flags & FLAG_IDENTIFIED) && (dev->flags & FLAG_ATAPI));
 	assert(!((unsigned long) data & 1));
 	assert(!((unsigned long) cmnd & 1));
 	assert(!(blksz & 1));
 	
-	if(IDE_REG_STATUS & (REG_STATUS_BSY | REG_STATUS_DRQ)) {
+	if(IDE_REG_STATUS(dev->chan) & (REG_STATUS_BSY | REG_STATUS_DRQ)) {
 		printf("ide: 0x%04x drive busy\n", ((uint16_t *) cmnd)[0]);
 		return -1;
 	}
 
-	IDE_REG_CYL_LO = blksz;
-	IDE_REG_CYL_HI = blksz >> 8;
+	left = (unsigned long) blksz * count;
 
-	IDE_REG_COMMAND = ATA_PACKET;
-	udelay(1);
+	size = left < ATAPI_BYTE_LIMIT ? left : ATAPI_BYTE_LIMIT;
+
+	IDE_REG_CYL_LO(dev->chan) = size;
+	IDE_REG_CYL_HI(dev->chan) = size >> 8;
 
-	expire = TIMEOUT_PACKET;
+	IDE_REG_COMMAND(dev->chan) = ATA_PACKET;
+	udelay(1);
 
-	for(mark = MFC0(CP0_COUNT);;) {
+	for(timer_set(&limit, TIMEOUT_PACKET * 10);;) {
 
-		stat = IDE_REG_STATUS;
+		stat = IDE_REG_STATUS(dev->chan);
 
 		if(!(stat & REG_STATUS_BSY)) {
 
 			if(stat & REG_STATUS_ERR) {
 
-				printf("ide: packet error 0x%04x 0x%02x\n", ((uint16_t *) cmnd)[0], IDE_REG_ERROR);
+				printf("ide: packet error 0x%04x 0x%02x\n", ((uint16_t *) cmnd)[0], IDE_REG_ERROR(dev->chan));
 
 				return -1;
 			}
@@ -501,35 +754,28 @@ static int atapi_read(struct ide_device *dev, const void *cmnd, void *data, unsi
 				break;
 		}
 
-		if(MFC0(CP0_COUNT) - mark >= CP0_COUNT_RATE / 100) {
-
-			if((int) --expire <= 0) {
-				printf("ide: packet timeout 0x%04x\n", ((uint16_t *) cmnd)[0]);
-				return -1;
-			}
-
-			mark += CP0_COUNT_RATE / 100;
+		if(timer_expired(&limit)) {
+			printf("ide: packet timeout 0x%04x\n", ((uint16_t *) cmnd)[0]);
+			return -1;
 		}
 	}
 
-	IDE_REG_DATA = ((uint16_t *) cmnd)[0];
-	IDE_REG_DATA = ((uint16_t *) cmnd)[1];
-	IDE_REG_DATA = ((uint16_t *) cmnd)[2];
-	IDE_REG_DATA = ((uint16_t *) cmnd)[3];
-	IDE_REG_DATA = ((uint16_t *) cmnd)[4];
-	IDE_REG_DATA = ((uint16_t *) cmnd)[5];
+	IDE_REG_DATA(dev->chan) = ((uint16_t *) cmnd)[0];
+	IDE_REG_DATA(dev->chan) = ((uint16_t *) cmnd)[1];
+	IDE_REG_DATA(dev->chan) = ((uint16_t *) cmnd)[2];
+	IDE_REG_DATA(dev->chan) = ((uint16_t *) cmnd)[3];
+	IDE_REG_DATA(dev->chan) = ((uint16_t *) cmnd)[4];
+	IDE_REG_DATA(dev->chan) = ((uint16_t *) cmnd)[5];
 
 	udelay(5 * 1000);
 
-	for(blksz >>= 1;;) {
-
-		IDE_REG_STATUS_ALT;
+	for(;;) {
 
-		expire = timeout;
+		IDE_REG_STATUS_ALT(dev->chan);
 
-		for(mark = MFC0(CP0_COUNT);;) {
+		for(timer_set(&limit, timeout * 10);;) {
 
-			stat = IDE_REG_STATUS;
+			stat = IDE_REG_STATUS(dev->chan);
 
 			if(!(stat & REG_STATUS_BSY)) {
 
@@ -540,92 +786,245 @@ static int atapi_read(struct ide_device *dev, const void *cmnd, void *data, unsi
 					return -1;
 				}
 
-				if(!count)
+				if(!left)
 					return 0;
 
 				if(stat & REG_STATUS_DRQ)
 					break;
 			}
 
-			if(MFC0(CP0_COUNT) - mark >= CP0_COUNT_RATE / 100) {
+			if(timer_expired(&limit)) {
+				printf("ide: command timeout 0x%04x\n", ((uint16_t *) cmnd)[0]);
+				ide_chan_fault(dev->chan);
+				return -1;
+			}
 
-				if((int) --expire <= 0) {
-					printf("ide: command timeout 0x%04x\n", ((uint16_t *) cmnd)[0]);
-					return -1;
-				}
+			yield();
+		}
 
-				mark += CP0_COUNT_RATE / 100;
-			}
+		/* the drive says how much it has for us this time */
+
+		size = IDE_REG_CYL_LO(dev->chan) | (IDE_REG_CYL_HI(dev->chan) << 8);
+
+		if(!size || (size & 1) || size > left) {
+			printf("ide: bad transfer size %u\n", size);
+			return -1;
 		}
 
-		for(indx = 0; indx < blksz; ++indx)
-			((uint16_t *) data)[indx] = IDE_REG_DATA;
+		for(indx = 0; indx < size / 2; ++indx)
+			((uint16_t *) data)[indx] = IDE_REG_DATA(dev->chan);
 
-		--count;
+		data += size;
+		left -= size;
+
+		yield();
 	}
 }
 
 /*
- * read sectors from drive
+ * load the task file for a transfer, 1 if it needs the LBA48 command
  */
-int ata_read_sectors(struct ide_device *dev, void *data, unsigned long addr, unsigned count)
+static int ata_task_file(struct ide_device *dev, unsigned long addr, unsigned nsect)
 {
 	unsigned long sector;
-	unsigned cmnd, nsect;
+	int ext;
+
+	ext = 0;
+
+	if(dev->flags & FLAG_LBA) {
+
+		assert(dev->chan->reg_head & REG_HEAD_LBA);
+
+		if(dev->flags & FLAG_LBA_48) {
+
+			ext = 1;
+
+			IDE_REG_CYL_HI(dev->chan) = 0;
+			IDE_REG_CYL_LO(dev->chan) = 0;
+			IDE_REG_SECTOR(dev->chan) = addr >> 24;
+
+			IDE_REG_NSECT(dev->chan) = nsect >> 8;
 
+		} else
+
+			IDE_REG_HEAD(dev->chan) = dev->chan->reg_head | (addr >> 24);
+
+		IDE_REG_CYL_HI(dev->chan) = addr >> 16;
+		IDE_REG_CYL_LO(dev->chan) = addr >> 8;
+		IDE_REG_SECTOR(dev->chan) = addr;
+
+	} else {
+
+		assert(!(dev->chan->reg_head & REG_HEAD_LBA));
+
+		IDE_REG_SECTOR(dev->chan) = addr % dev->nsects + 1;
+		sector = addr / dev->nsects;
+		IDE_REG_HEAD(dev->chan) = dev->chan->reg_head | sector % dev->nheads;
+		sector /= dev->nheads;
+		IDE_REG_CYL_HI(dev->chan) = sector >> 8;
+		IDE_REG_CYL_LO(dev->chan) = sector;
+	}
+
+	IDE_REG_NSECT(dev->chan) = nsect;		/* 0 for 256 */
+
+	return ext;
+}
+
+/*
+ * issue the next command of a read
+ */
+static int ata_issue(struct ata_request *req)
+{
+	struct ide_device *dev;
+
+	dev = req->dev;
+
+	ide_select(dev);
+
+	if(IDE_REG_STATUS(dev->chan) & (REG_STATUS_BSY | REG_STATUS_DRQ)) {
+		printf("ide: %s drive busy\n", dev->name);
+		return -1;
+	}
+
+	req->nsect = req->count > ATA_READ_BLOCK ? ATA_READ_BLOCK : req->count;
+
+	req->cmnd = ata_task_file(dev, req->addr, req->nsect) ? ATA_READ_EXT : ATA_READ;
+
+	IDE_REG_COMMAND(dev->chan) = req->cmnd;
+	udelay(1);
+
+	timer_set(&req->limit, TIMEOUT_ATA_READ * 10);
+
+	return 0;
+}
+
+/*
+ * start reading sectors from drive
+ */
+static int ata_start(struct ata_request *req, struct ide_device *dev, void *data, unsigned long addr, unsigned count)
+{
 	assert(dev->flags & FLAG_IDENTIFIED);
+	assert(!((unsigned long) data & 1));
 
 	if(addr + count >= dev->devsize) {
 		puts("ide: attempt to read past end of disk");
 		return -1;
 	}
 
-	ide_select(dev);
+	req->dev = dev;
+	req->data = data;
+	req->addr = addr;
+	req->count = count;
+	req->nsect = 0;
+
+	return count ? ata_issue(req) : 0;
+}
+
+/*
+ * move a read on without waiting, a sector at a time. 1 once it's done, 0
+ * if there's more to come, -1 if it failed
+ */
+static int ata_complete(struct ata_request *req)
+{
+	struct ide_device *dev;
+	unsigned stat;
+	void *end;
 
-	for(cmnd = ATA_READ; count;) {
+	dev = req->dev;
 
-		if(dev->flags & FLAG_LBA) {
+	stat = IDE_REG_STATUS(dev->chan);
 
-			assert(reg_head & REG_HEAD_LBA);
+	if(!(stat & REG_STATUS_BSY)) {
 
-			if(dev->flags & FLAG_LBA_48) {
+		if(stat & REG_STATUS_ERR) {
+			printf("ide: 0x%02x error 0x%02x\n", req->cmnd, IDE_REG_ERROR(dev->chan));
+			return -1;
+		}
 
-				cmnd = ATA_READ_EXT;
+		/* command finished, on to the next if there is one */
 
-				IDE_REG_CYL_HI = 0;
-				IDE_REG_CYL_LO = 0;
-				IDE_REG_SECTOR = addr >> 24;
+		if(!req->nsect)
+			return req->count ? ata_issue(req) : 1;
 
-				IDE_REG_NSECT = 0;
+		if(stat & REG_STATUS_DRQ) {
 
-			} else
+			for(end = req->data + 512; req->data < end; req->data += 16) {
 
-				IDE_REG_HEAD = reg_head | (addr >> 24);
+				((uint16_t *) req->data)[0] = IDE_REG_DATA(dev->chan);
+				((uint16_t *) req->data)[1] = IDE_REG_DATA(dev->chan);
+				((uint16_t *) req->data)[2] = IDE_REG_DATA(dev->chan);
+				((uint16_t *) req->data)[3] = IDE_REG_DATA(dev->chan);
+				((uint16_t *) req->data)[4] = IDE_REG_DATA(dev->chan);
+				((uint16_t *) req->data)[5] = IDE_REG_DATA(dev->chan);
+				((uint16_t *) req->data)[6] = IDE_REG_DATA(dev->chan);
+				((uint16_t *) req->data)[7] = IDE_REG_DATA(dev->chan);
+			}
 
-			IDE_REG_CYL_HI = addr >> 16;
-			IDE_REG_CYL_LO = addr >> 8;
-			IDE_REG_SECTOR = addr;
+			IDE_REG_STATUS_ALT(dev->chan);
 
-		} else {
+			++req->addr;
+			--req->count;
+			--req->nsect;
 
-			assert(!(reg_head & REG_HEAD_LBA));
+			timer_set(&req->limit, TIMEOUT_ATA_READ * 10);
 
-			IDE_REG_SECTOR = addr % dev->nsects + 1;
-			sector = addr / dev->nsects;
-			IDE_REG_HEAD = reg_head | sector % dev->nheads;
-			sector /= dev->nheads;
-			IDE_REG_CYL_HI = sector >> 8;
-			IDE_REG_CYL_LO = sector;
+			return 0;
 		}
+	}
+
+	if(timer_expired(&req->limit)) {
+		printf("ide: 0x%02x command timeout\n", req->cmnd);
+		ide_chan_fault(dev->chan);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * read sectors from drive
+ */
+int ata_read_sectors(struct ide_device *dev, void *data, unsigned long addr, unsigned count)
+{
+	struct ata_request req;
+	int state;
+
+	if(ata_start(&req, dev, data, addr, count))
+		return -1;
+
+	while(!(state = ata_complete(&req)))
+		yield();
+
+	return state < 0 ? -1 : 0;
+}
 
-		nsect = count > ATA_READ_BLOCK ? ATA_READ_BLOCK : count;
-		IDE_REG_NSECT = nsect;
+/*
+ * write sectors to drive
+ */
+static int ata_write_sectors(struct ide_device *dev, const void *data, unsigned long addr, unsigned count)
+{
+	unsigned cmnd, nsect;
+
+	assert(dev->flags & FLAG_IDENTIFIED);
+
+	if(addr + count > dev->devsize) {
+		puts("ide: attempt to write past end of disk");
+		return -1;
+	}
+
+	ide_select(dev);
+
+	while(count) {
 
-		if(ata_read(dev, cmnd, data, nsect, TIMEOUT_ATA_READ))
+		nsect = count > ATA_WRITE_BLOCK ? ATA_WRITE_BLOCK : count;
+
+		cmnd = ata_task_file(dev, addr, nsect) ? ATA_WRITE_EXT : ATA_WRITE;
+
+		if(ata_write(dev, cmnd, data, nsect, TIMEOUT_ATA_WRITE))
 			return -1;
 
-		addr += ATA_READ_BLOCK;
-		data += ATA_READ_BLOCK * 512;
+		addr += ATA_WRITE_BLOCK;
+		data += ATA_WRITE_BLOCK * 512;
 		count -= nsect;
 	}
 
@@ -673,7 +1072,7 @@ static int atapi_sense(struct ide_device *dev)
 int atapi_read_sectors(struct ide_device *dev, void *data, unsigned long addr, unsigned count)
 {
 	static char emsg[32];
-	unsigned work, retry, mark;
+	unsigned work, retry;
 	unsigned long end;
 	union {
 		uint16_t	h[6];
@@ -684,17 +1083,18 @@ int atapi_read_sectors(struct ide_device *dev, void *data, unsigned long addr, u
 
 	ide_select(dev);
 
-	cmnd.b[0]	= ATAPI_READ_10;
 	cmnd.b[1]	= 0x00;
-	cmnd.b[6]	= 0x00;
-	cmnd.b[9]	= 0x00;
 	cmnd.b[10]	= 0x00;
 	cmnd.b[11]	= 0x00;
 
-	for(end = addr + count; addr < end;) {
+	for(end = addr + count, retry = 0; addr < end;) {
+
+		/* as much as the drive takes, carefully after an error */
 
 		work = end - addr;
-		if(work > ATAPI_READ_BLOCK)
+		if(work > dev->atapi_max)
+			work = dev->atapi_max;
+		if(retry && work > ATAPI_READ_BLOCK)
 			work = ATAPI_READ_BLOCK;
 
 		cmnd.b[2] = addr >> 24;
@@ -702,60 +1102,385 @@ int atapi_read_sectors(struct ide_device *dev, void *data, unsigned long addr, u
 		cmnd.b[4] = addr >> 8;
 		cmnd.b[5] = addr;
 
-		cmnd.b[7] = work >> 8;
-		cmnd.b[8] = work;
+		if(work > 0xffff) {
 
-		for(retry = 1;; ++retry) {
+			cmnd.b[0] = ATAPI_READ_12;
+			cmnd.b[6] = work >> 24;
+			cmnd.b[7] = work >> 16;
+			cmnd.b[8] = work >> 8;
+			cmnd.b[9] = work;
 
-			if(!atapi_read(dev, cmnd.b, data, 2048, work, TIMEOUT_ATAPI_READ))
-				break;
+		} else {
 
-			if(retry == 20)
-				return -1;
+			cmnd.b[0] = ATAPI_READ_10;
+			cmnd.b[6] = 0x00;
+			cmnd.b[7] = work >> 8;
+			cmnd.b[8] = work;
+			cmnd.b[9] = 0x00;
+		}
 
-			sense = atapi_sense(dev);
+		if(!atapi_read(dev, cmnd.b, data, 2048, work, TIMEOUT_ATAPI_READ)) {
+			addr += work;
+			data += work * 2048;
+			retry = 0;
+			continue;
+		}
 
-			if(sense < 0) {
+		if(++retry == 20)
+			return -1;
 
-				if(ide_reset() < 0)
-					return -1;
-				ide_select(dev);
+		sense = atapi_sense(dev);
 
-			} else {
+		if(sense < 0) {
 
-				cause = emsg;
+			if(ide_reset() < 0)
+				return -1;
+			ide_select(dev);
 
-				switch(sense) {
-					case 0x023a00:
-						DPRINTF("ide.%s: error {No Medium}\n", dev->name);
-						return -1;
-					case 0x062800:
-						cause = "Media Change";
-						break;
-					case 0x062900:
-						cause = "Reset Complete";
-						break;
-					case 0x020401:
-						cause = "Spinning Up";
-						break;
-					default:
-						sprintf(cause, "#%06x", sense);
-				}
+		} else if(work > ATAPI_READ_BLOCK && ((sense & 0x0fff00) == 0x052000 || (sense & 0x0fff00) == 0x052400)) {
 
-				DPRINTF("ide: error {%s}, retry\n", cause);
-			}
+			/* drive won't take a read that big, remember for next time */
 
-			for(mark = MFC0(CP0_COUNT); MFC0(CP0_COUNT) - mark < CP0_COUNT_RATE / 2;)
-				;
+			dev->atapi_max = work > 0xffff ? 0xffff : work / 2;
+			if(dev->atapi_max < ATAPI_READ_BLOCK)
+				dev->atapi_max = ATAPI_READ_BLOCK;
+
+			DPRINTF("ide.%s: reads limited to %lu sectors\n", dev->name, dev->atapi_max);
+
+			retry = 0;
+			continue;
+
+		} else {
+
+			cause = emsg;
+
+			switch(sense) {
+				case 0x023a00:
+					DPRINTF("ide.%s: error {No Medium}\n", dev->name);
+					return -1;
+				case 0x062800:
+					cause = "Media Change";
+					break;
+				case 0x062900:
+					cause = "Reset Complete";
+					break;
+				case 0x020401:
+					cause = "Spinning Up";
+					break;
+				default:
+					sprintf(cause, "#%06x", sense);
+			}
+
+			DPRINTF("ide: error {%s}, retry\n", cause);
+		}
+
+		timer_sleep(500);
+	}
+
+	return 0;
+}
+
+static unsigned md_le32(const void *ptr)
+{
+	const uint8_t *p = ptr;
+
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+/*
+ * look for an md superblock in a partition, 0.90 near the end, 1.0 at the
+ * end, 1.1 at the start or 1.2 4K in. 1 if there is one, with the set's
+ * UUID, level, where its data starts and ends, its event count and whether
+ * this member is active
+ */
+static int md_super(struct ide_device *dev, unsigned long start, unsigned long size, struct md_info *info)
+{
+	static const char *metadata[] = { "0.90", "1.0", "1.1", "1.2" };
+	static uint8_t sb[1024];
+
+	unsigned long where[elements(metadata)];
+	unsigned indx, slot, role;
+
+	where[0] = (size & ~127UL) - 128;
+	where[1] = (size - 16) & ~7UL;
+	where[2] = 0;
+	where[3] = 8;
+
+	for(indx = 0; indx < elements(metadata); ++indx) {
+
+		if(size < 256 || ata_read_sectors(dev, sb, start + where[indx], 2) || md_le32(sb) != MD_MAGIC)
+			continue;
+
+		if(!indx) {
+
+			/* this member's descriptor is in the last 128 bytes of 4K */
+
+			if(md_le32(sb + 4) || ata_read_sectors(dev, sb + 512, start + where[0] + 7, 1))
+				continue;
+
+			info->level = md_le32(sb + 7 * 4);
+			info->data = 0;
+			info->size = where[0];
+			info->events = ((uint64_t) md_le32(sb + 40 * 4) << 32) | md_le32(sb + 39 * 4);
+
+			role = md_le32(sb + 512 + 384 + 4 * 4);
+			info->active = (role & (MD_DISK_FAULTY | MD_DISK_ACTIVE | MD_DISK_SYNC)) == (MD_DISK_ACTIVE | MD_DISK_SYNC);
+
+			memcpy(info->uuid + 0, sb + 5 * 4, 4);
+			memcpy(info->uuid + 4, sb + 13 * 4, 12);
+
+		} else {
+
+			/* must say it's where we found it, and data below 2TB */
+
+			if(md_le32(sb + 4) != 1 || md_le32(sb + 144) != where[indx] || md_le32(sb + 148) ||
+				md_le32(sb + 132) || md_le32(sb + 140))
+				continue;
+
+			info->level = md_le32(sb + 72);
+			info->data = md_le32(sb + 128);
+			info->size = md_le32(sb + 136);
+			info->events = ((uint64_t) md_le32(sb + 204) << 32) | md_le32(sb + 200);
+
+			/* role from dev_roles[dev_number], if it's in what we read */
+
+			slot = md_le32(sb + 160);
+			role = slot < md_le32(sb + 220) && 256 + 2 * slot + 2 <= sizeof(sb) ?
+				sb[256 + 2 * slot] | (sb[257 + 2 * slot] << 8) : ~0U;
+
+			info->active = role < MD_ROLE_MAX && !(md_le32(sb + 8) & MD_FEATURE_RECOVERY);
+
+			memcpy(info->uuid, sb + 16, 16);
+		}
+
+		info->metadata = metadata[indx];
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static void md_member_add(struct ide_device *dev, unsigned long start, const struct md_info *info, const char *ident)
+{
+	struct md_member *mbr;
+
+	if(!info->active) {
+		DPRINTF("ide: %s not active\n", ident);
+		return;
+	}
+
+	mbr = &selected.member[selected.members++];
+
+	memset(mbr, 0, sizeof(*mbr));
+	mbr->dev = dev;
+	mbr->offset = start + info->data;
+	mbr->events = info->events;
+	strcpy(mbr->ident, ident);
+}
+
+/*
+ * if the partition is in a RAID1 set find the other members, so reads can
+ * be spread across them all. only active members that are up to date (have
+ * the highest event count) are used
+ */
+static void md_open(struct ide_device *dev, unsigned long start, unsigned long size)
+{
+	static struct part_table table;
+
+	struct md_info info, other;
+	struct ide_device *peer;
+	struct part_entry *ent;
+	unsigned indx, count;
+	uint64_t events;
+	char ident[8];
+
+	if(!md_super(dev, start, size, &info))
+		return;
+
+	DPRINTF("ide: md %s level %d\n", info.metadata, info.level);
+
+	selected.offset = start + info.data;
+	selected.size = info.size;
+
+	if(info.level != MD_LEVEL_RAID1)
+		return;
+
+	md_member_add(dev, start, &info, selected.ident);
+
+	for(peer = ide_bus; peer < ide_bus + elements(ide_bus); ++peer) {
+
+		if((peer->flags & (FLAG_IDENTIFIED | FLAG_ATAPI)) != FLAG_IDENTIFIED)
+			continue;
+
+		if(ata_read_sectors(peer, &table, 0, 1) || table.signature != 0xaa55)
+			continue;
+
+		for(ent = table.p; ent < table.p + elements(table.p) && selected.members < MD_MEMBERS; ++ent) {
+
+			if(ent->type != PART_TYPE_RAID || (peer == dev && ent->start_lba == start))
+				continue;
+
+			if(!md_super(peer, ent->start_lba, ent->size_lba, &other) || memcmp(other.uuid, info.uuid, sizeof(info.uuid)))
+				continue;
+
+			sprintf(ident, "%s%u", peer->name, (unsigned) (ent - table.p) + 1);
+			md_member_add(peer, ent->start_lba, &other, ident);
+		}
+	}
+
+	/* drop members that missed updates */
+
+	for(events = 0, indx = 0; indx < selected.members; ++indx)
+		if(selected.member[indx].events > events)
+			events = selected.member[indx].events;
+
+	for(count = 0, indx = 0; indx < selected.members; ++indx) {
+
+		if(selected.member[indx].events != events) {
+			DPRINTF("ide: %s out of date\n", selected.member[indx].ident);
+			continue;
 		}
 
-		addr += work;
-		data += work * 2048;
+		DPRINTF("ide: mirror %s\n", selected.member[indx].ident);
+
+		selected.member[count++] = selected.member[indx];
+	}
+
+	selected.members = count;
+
+	selected.metadata = info.metadata;
+
+	/* one member is read directly, unless it's another than the one opened */
+
+	if(!selected.members)
+		printf("ide: %s has no active mirror members\n", selected.ident);
+	else if(selected.members == 1 && selected.member[0].dev == dev && selected.member[0].offset == selected.offset)
+		selected.members = 0;
+}
+
+static void md_fail(struct md_member *mbr)
+{
+	++mbr->errors;
+	mbr->failed = 1;
+
+	printf("ide: %s failed, dropped from mirror\n", mbr->ident);
+}
+
+/*
+ * read from a mirror, a chunk from each member in turn. members on different
+ * channels read their chunks at the same time, members sharing a channel take
+ * turns. a chunk that fails is read again from the members that are left
+ */
+static int md_read_sectors(void *data, unsigned long addr, unsigned count)
+{
+	struct ata_request req[MD_MEMBERS];
+	struct md_member *mbr[MD_MEMBERS];
+	unsigned long base[MD_MEMBERS];
+	unsigned nreq, nsect, indx, busy, used, first;
+	struct md_member *next;
+	int state[MD_MEMBERS];
+
+	while(count) {
+
+		/* start a chunk on each channel */
+
+		nreq = 0;
+		used = 0;
+		first = addr / MD_CHUNK;
+
+		for(indx = 0; indx < selected.members && count; ++indx) {
+
+			next = &selected.member[(first + indx) % selected.members];
+			if(next->failed || (used & (1 << (next->dev->chan - ide_chan))))
+				continue;
+
+			nsect = MD_CHUNK - addr % MD_CHUNK;
+			if(nsect > count)
+				nsect = count;
+
+			if(ata_start(&req[nreq], next->dev, data, addr + next->offset, nsect)) {
+				md_fail(next);
+				continue;
+			}
+
+			used |= 1 << (next->dev->chan - ide_chan);
+
+			mbr[nreq] = next;
+			base[nreq] = addr;
+			state[nreq] = 0;
+			++nreq;
+
+			addr += nsect;
+			data += nsect * 512;
+			count -= nsect;
+		}
+
+		if(!nreq)
+			return -1;
+
+		/* and wait for them all */
+
+		do {
+
+			for(busy = indx = 0; indx < nreq; ++indx)
+				if(!state[indx]) {
+					state[indx] = ata_complete(&req[indx]);
+					busy |= !state[indx];
+				}
+
+			yield();
+
+		} while(busy);
+
+		for(indx = 0; indx < nreq; ++indx) {
+
+			if(state[indx] > 0) {
+
+				++mbr[indx]->reads;
+				mbr[indx]->sectors += req[indx].addr - mbr[indx]->offset - base[indx];
+
+			} else {
+
+				/* what's left of the chunk, from another member */
+
+				md_fail(mbr[indx]);
+
+				if(md_read_sectors(req[indx].data, req[indx].addr - mbr[indx]->offset, req[indx].count))
+					return -1;
+			}
+		}
 	}
 
 	return 0;
 }
 
+/*
+ * write to every working member of a mirror
+ */
+static int md_write_sectors(const void *data, unsigned long addr, unsigned count)
+{
+	struct md_member *mbr;
+	int done;
+
+	done = 0;
+
+	for(mbr = selected.member; mbr < selected.member + selected.members; ++mbr) {
+
+		if(mbr->failed)
+			continue;
+
+		if(!ata_write_sectors(mbr->dev, data, addr + mbr->offset, count)) {
+			done = 1;
+			continue;
+		}
+
+		md_fail(mbr);
+	}
+
+	return done ? 0 : -1;
+}
+
 /*
  * read sectors from drive
  */
@@ -763,6 +1488,9 @@ int ide_read_sectors(void *device, void *data, unsigned long addr, unsigned coun
 {
 	assert(device == &selected);
 
+	if(selected.members)
+		return md_read_sectors(data, addr, count);
+
 	addr += selected.offset;
 
 	return (selected.dev->flags & FLAG_ATAPI) ?
@@ -770,6 +1498,145 @@ int ide_read_sectors(void *device, void *data, unsigned long addr, unsigned coun
 		ata_read_sectors(selected.dev, data, addr, count);
 }
 
+/*
+ * write sectors to drive, hard disks only
+ */
+int ide_write_sectors(void *device, const void *data, unsigned long addr, unsigned count)
+{
+	assert(device == &selected);
+
+	if(selected.dev->flags & FLAG_ATAPI) {
+		puts("ide: can't write to a CDROM");
+		return -1;
+	}
+
+	if(addr + count > selected.size || addr + count < addr) {
+		printf("ide: attempt to write past end of %s\n", selected.ident);
+		return -1;
+	}
+
+	block_flush(device);
+
+	if(selected.members)
+		return md_write_sectors(data, addr, count);
+
+	return ata_write_sectors(selected.dev, data, addr + selected.offset, count);
+}
+
+static int ata_flush(struct ide_device *dev)
+{
+	ide_select(dev);
+
+	return ata_write(dev, (dev->flags & FLAG_LBA_48) ? ATA_FLUSH_CACHE_EXT : ATA_FLUSH_CACHE, NULL, 0, TIMEOUT_ATA_FLUSH);
+}
+
+/*
+ * have the drive commit its write cache, every working member of a mirror
+ */
+int ide_flush(void *device)
+{
+	struct md_member *mbr;
+	int stat;
+
+	assert(device == &selected);
+
+	if(selected.dev->flags & FLAG_ATAPI)
+		return 0;
+
+	if(!selected.members)
+		return ata_flush(selected.dev);
+
+	stat = 0;
+
+	for(mbr = selected.member; mbr < selected.member + selected.members; ++mbr)
+		if(!mbr->failed && ata_flush(mbr->dev))
+			stat = -1;
+
+	return stat;
+}
+
+/*
+ * number of members if a mirror is open, 0 otherwise
+ */
+unsigned ide_mirrors(void *device)
+{
+	assert(device == &selected);
+
+	return selected.members;
+}
+
+/*
+ * read sectors from one member of a mirror, -1 if it's been dropped
+ */
+int ide_read_mirror(void *device, unsigned which, void *data, unsigned long addr, unsigned count)
+{
+	struct md_member *mbr;
+
+	assert(device == &selected && which < selected.members);
+
+	mbr = &selected.member[which];
+
+	if(mbr->failed)
+		return -1;
+
+	return ata_read_sectors(mbr->dev, data, addr + mbr->offset, count);
+}
+
+const char *ide_mirror_name(void *device, unsigned which)
+{
+	assert(device == &selected && which < selected.members);
+
+	return selected.member[which].ident;
+}
+
+/*
+ * a sector of the drive in the gap between the partition table and the
+ * first partition is kept for CoLo, if the drive has a gap that large
+ */
+static int ide_reserved(void)
+{
+	static struct part_table table;
+	unsigned indx;
+
+	if(selected.dev->flags & FLAG_ATAPI)
+		return 0;
+
+	if(ata_read_sectors(selected.dev, &table, 0, 1) || table.signature != 0xaa55)
+		return 0;
+
+	for(indx = 0; indx < elements(table.p); ++indx)
+		if(table.p[indx].type && table.p[indx].start_lba <= RESERVED_SECTOR)
+			return 0;
+
+	return 1;
+}
+
+/*
+ * read the reserved sector of the drive the partition is on
+ */
+int ide_reserved_read(void *device, void *data)
+{
+	assert(device == &selected);
+
+	if(!ide_reserved())
+		return -1;
+
+	return ata_read_sectors(selected.dev, data, RESERVED_SECTOR, 1);
+}
+
+/*
+ * write the reserved sector of the drive the partition is on
+ */
+int ide_reserved_write(void *device, const void *data)
+{
+	assert(device == &selected);
+
+	if(!ide_reserved())
+		return -1;
+
+	return ata_write_sectors(selected.dev, data, RESERVED_SECTOR, 1);
+}
+
 /*
  * get drive sector size
  */
@@ -780,6 +1647,16 @@ int ide_block_size(void *device)
 	return selected.block;
 }
 
+/*
+ * get partition size in sectors
+ */
+unsigned long ide_size(void *device)
+{
+	assert(device == &selected);
+
+	return selected.size;
+}
+
 /*
  * get partition identification
  */
@@ -793,12 +1670,14 @@ const char *ide_dev_name(void *device)
 /*
  * set timing for PIO mode
  */
-static void ide_timing(unsigned mode)
+static void ide_timing(struct ide_channel *chan, unsigned mode)
 {
+	unsigned setup;
+
 	if(mode != 4)
 		return;
 
-	DPUTS("ide: mode 4 timing");
+	DPRINTF("ide: mode 4 timing 0x%03x\n", chan->base);
 
 #	define PCI_CLOCKS(t)			((unsigned)((1LL*PCI_CLOCK*(t)+999999999)/1000000000))
 
@@ -806,11 +1685,13 @@ static void ide_timing(unsigned mode)
 #	define NCLKS_ACTIVE			PCI_CLOCKS(70)
 #	define NCLKS_RECOVER			PCI_CLOCKS(25)
 
-	/* set port timing */
+	/* set port timing, the address setup register is shared by both channels */
 
-	pcicfg_write_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x4b, ((NCLKS_ACTIVE - 1) << 4) | (NCLKS_RECOVER - 1));
-	pcicfg_write_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x4c, ((NCLKS_SETUP - 1) << 6) | 0x3f);
-	pcicfg_write_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x4f, ((NCLKS_ACTIVE - 1) << 4) | (NCLKS_RECOVER - 1));
+	setup = pcicfg_read_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x4c) & ~(3 << chan->setup);
+
+	pcicfg_write_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, chan->timing, ((NCLKS_ACTIVE - 1) << 4) | (NCLKS_RECOVER - 1));
+	pcicfg_write_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x4c, ((NCLKS_SETUP - 1) << chan->setup) | setup);
+	pcicfg_write_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, chan->recover, ((NCLKS_ACTIVE - 1) << 4) | (NCLKS_RECOVER - 1));
 
 	/* enable prefetch buffer */
 
@@ -823,71 +1704,135 @@ static void ide_timing(unsigned mode)
  */
 void ide_init(void)
 {
+	struct ide_channel *chan;
+
 	/* enable VIA IDE I/O access */
 
 	pcicfg_write_half(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x04, 0x0001 |
 		pcicfg_read_half(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x40));
 
-	/* enable primary channel */
+	/* enable primary channel, and the secondary if wanted */
 
-	pcicfg_write_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x40, 0x02 |
-		pcicfg_read_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x40));
+	for(chan = ide_chan; chan < ide_chan + elements(ide_chan); ++chan)
+		if(ide_chan_used(chan)) {
 
-	ide_timing(PIO_MODE_DEFAULT);
+			pcicfg_write_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x40, chan->enable |
+				pcicfg_read_byte(PCI_DEV_VIA, PCI_FNC_VIA_IDE, 0x40));
+
+			ide_timing(chan, PIO_MODE_DEFAULT);
+		}
 
 	ide_reset_async();
 }
 
+/* identify yields, so a background task can find a probe under way */
+
+static int ide_probing;
+
 /*
- * return handle to drive/partition
+ * identify drives after a reset and set the timing to suit, 0 if none found
  */
-void *ide_open(const char *name)
+static int ide_probe(void)
 {
-	struct part_table
-	{
-		uint8_t				padding[512 - sizeof(uint16_t) - 4 * sizeof(struct part_entry)];
-		struct part_entry	p[4];
-		uint16_t				signature;
+	struct ide_channel *chan;
+	struct ide_device *dev;
+	unsigned mode;
+	int found;
+
+	found = 0;
+
+	ide_probing = 1;
+
+	for(dev = ide_bus; dev < ide_bus + elements(ide_bus); ++dev)
+		dev->flags = 0;
+
+	for(chan = ide_chan; chan < ide_chan + elements(ide_chan); ++chan) {
+
+		if(!ide_chan_used(chan) || (chan->flags & CHAN_EMPTY))
+			continue;
+
+		mode = 10;
+
+		for(dev = ide_bus; dev < ide_bus + elements(ide_bus); ++dev) {
+
+			if(dev->chan != chan || ((dev->select & REG_HEAD_SLAVE) && !(nv_store.flags & NVFLAG_IDE_ENABLE_SLAVE)))
+				continue;
+
+			ide_identify(dev);
+
+			if((dev->flags & FLAG_IDENTIFIED) && dev->mode < mode)
+				mode = dev->mode;
+		}
+
+		if(mode == 10)
+			continue;
+
+		found = 1;
+
+		if(!(nv_store.flags & NVFLAG_IDE_DISABLE_TIMING))
+			ide_timing(chan, mode);
+	}
+
+	ide_probing = 0;
+
+	return found;
+}
+
+/*
+ * get the drives ready without waiting, for callers that can't block. 1 if
+ * they can be opened, 0 if a reset or probe is still running, -1 if there
+ * are none
+ */
+int ide_ready(void)
+{
+	int state;
+
+	if(ide_probing)
+		return 0;
+
+	if(ide_identified())
+		return 1;
+
+	ide_reset_async();
 
-	} __attribute__((packed));
+	state = ide_reset_poll();
+	if(state <= 0)
+		return state;
 
+	return ide_probe() ? 1 : -1;
+}
+
+/*
+ * return handle to drive/partition, 'raw' selects raw boot partitions
+ * rather than file system ones
+ */
+static void *ide_open_part(const char *name, int raw)
+{
 	static const char *prefix[] = { "/dev/hd", "hd" };
 	static struct part_table table;
 	int disk, cdrom, drive, part;
-	unsigned indx, size, mode;
+	unsigned indx, size;
 	char *ptr;
 
 	assert(sizeof(table) == 512);
 
-	if(!((ide_bus[0].flags | ide_bus[1].flags) & FLAG_IDENTIFIED)) {
+	if(!ide_identified()) {
 
 		if(ide_reset() < 0) {
 			puts("aborted");
 			return NULL;
 		}
 
-		ide_identify(&ide_bus[0]);
-		if(nv_store.flags & NVFLAG_IDE_ENABLE_SLAVE)
-			ide_identify(&ide_bus[1]);
-
-		if(!((ide_bus[0].flags | ide_bus[1].flags) & FLAG_IDENTIFIED)) {
+		if(!ide_probe()) {
 			puts("no devices found");
 			return NULL;
 		}
-
-		mode = 10;
-		for(indx = 0; indx < 2; ++indx)
-			if((ide_bus[indx].flags & FLAG_IDENTIFIED) && ide_bus[indx].mode < mode)
-					mode = ide_bus[indx].mode;
-
-		if(!(nv_store.flags & NVFLAG_IDE_DISABLE_TIMING))
-			ide_timing(mode);
 	}
 
 	disk = -1;
 	cdrom = -1;
 
-	for(indx = 0; indx < 2; ++indx)
+	for(indx = 0; indx < elements(ide_bus); ++indx)
 		if(ide_bus[indx].flags & FLAG_IDENTIFIED) {
 			if(ide_bus[indx].flags & FLAG_ATAPI) {
 				if(cdrom < 0)
@@ -919,7 +1864,7 @@ void *ide_open(const char *name)
 				size = strlen(prefix[indx]);
 				if(!strncasecmp(name, prefix[indx], size)) {
 
-					if(toupper(name[size]) == 'A' || toupper(name[size]) == 'B') {
+					if(toupper(name[size]) >= 'A' && toupper(name[size]) < 'A' + elements(ide_bus)) {
 
 						part = 0;
 
@@ -928,7 +1873,7 @@ void *ide_open(const char *name)
 							part = strtoul(ptr, &ptr, 10);
 
 						if(!*ptr)
-							drive = (name[size] - 'A') & 1;
+							drive = toupper(name[size]) - 'A';
 					}
 
 					break;
@@ -949,6 +1894,8 @@ void *ide_open(const char *name)
 
 	selected.dev = &ide_bus[drive];
 	selected.offset = 0;
+	selected.size = ide_bus[drive].devsize;
+	selected.members = 0;
 	selected.block = (ide_bus[drive].flags & FLAG_ATAPI) ? 2048 : 512;
 
 	if(!part) {
@@ -978,7 +1925,23 @@ void *ide_open(const char *name)
 		return NULL;
 	}
 
-	if(part > 0) {
+	if(raw) {
+
+		if(part > 0 && table.p[--part].type != RAWBOOT_PART_TYPE) {
+			puts("not a raw boot partition");
+			return NULL;
+		}
+
+		for(indx = 0; part < 0 && indx < elements(table.p); ++indx)
+			if(table.p[indx].type == RAWBOOT_PART_TYPE)
+				part = indx;
+
+		if(part < 0) {
+			puts("no raw boot partitions");
+			return NULL;
+		}
+
+	} else if(part > 0) {
 	
 		switch(table.p[--part].type) {
 
@@ -1021,10 +1984,48 @@ void *ide_open(const char *name)
 	}
 
 	selected.offset = table.p[part].start_lba;
+	selected.size = table.p[part].size_lba;
 
 	sprintf(selected.ident, "hd%c%d", drive + 'a', part + 1);
 
+	if(!raw && table.p[part].type == PART_TYPE_RAID)
+		md_open(selected.dev, table.p[part].start_lba, table.p[part].size_lba);
+
 	return &selected;
 }
 
+void *ide_open(const char *name)
+{
+	return ide_open_part(name, 0);
+}
+
+void *ide_open_raw(const char *name)
+{
+	return ide_open_part(name, 1);
+}
+
+/*
+ * 'raid' shell command, shows how reads are spread across a mirror
+ */
+int cmnd_raid(int opsz)
+{
+	struct md_member *mbr;
+
+	if(argc > 1)
+		return E_ARGS_OVER;
+
+	if(!selected.dev || !selected.members) {
+		puts("no mirror open");
+		return E_UNSPEC;
+	}
+
+	printf("RAID1 (metadata %s) %u members\n", selected.metadata, selected.members);
+
+	for(mbr = selected.member; mbr < selected.member + selected.members; ++mbr)
+		printf("%-6s %8u reads %10lu sectors %4u errors%s\n",
+			mbr->ident, mbr->reads, mbr->sectors, mbr->errors, mbr->failed ? " (failed)" : "");
+
+	return E_NONE;
+}
+
 /* vi:set ts=3 sw=3 cin path=include,../include: */
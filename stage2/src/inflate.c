@@ -9,12 +9,21 @@
 
 #define WSIZE							0x8000
 
+/* input buffer when streaming, with room to step back over lookahead */
+
+#define INBUF_SIZE					0x4000
+#define INBUF_BACK					8
+
+/* worst case growth of deflate data, for decompressing in place */
+
+#define INPLACE_MARGIN(n)			(((n) >> 12) + (64 << 10) + 128)
+
 #define Tracevv(x)
 #define Tracecv(x,y)
 
 #define memzero(p,n)					do{memset((p),0,(n));}while(0)
 #define fprintf(s,p,a...)
-#define get_byte()					(*inptr++)
+#define get_byte()					(inptr < inend ? *inptr++ : fill_inbuf())
 
 typedef unsigned char				uch;
 typedef unsigned short				ush;
@@ -23,11 +32,18 @@ typedef unsigned long				ulg;
 static uch window[WSIZE];
 static ush outcnt;
 static const uch *inptr;
+static const uch *inend;
 static uch *outdata;
 static size_t outptr;
 static size_t outmax;
+static int outstop;
 static ulg crc;
 
+static uch inbuf[INBUF_BACK + INBUF_SIZE];
+static unsigned (*infill)(void *, unsigned);
+static int inerror;
+static void (*outsink)(const void *, unsigned);
+
 static int inflate(void);
 
 #undef malloc
@@ -119,87 +135,212 @@ int gzip_check(const void *image, size_t size)
 	return size >= 11 && ((uint8_t *) image)[0] == 0x1f && ((uint8_t *) image)[1] == 0x8b;
 }
 
-int decompress(const void *in, void *out, size_t max)
+/*
+ * refill the input buffer when streaming, keeping the last few bytes
+ */
+static uch fill_inbuf(void)
+{
+	unsigned size;
+
+	memmove(inbuf, inend - INBUF_BACK, INBUF_BACK);
+
+	size = (infill && !inerror) ? infill(inbuf + INBUF_BACK, INBUF_SIZE) : 0;
+	if(!size) {
+		inerror = 1;
+		return 0;
+	}
+
+	inptr = inbuf + INBUF_BACK;
+	inend = inptr + size;
+
+	return *inptr++;
+}
+
+static ulg get_long(void)
 {
-	unsigned flag;
 	ulg tmp;
-	int res;
 
-	inptr = in;
+	tmp = get_byte();
+	tmp |= (ulg) get_byte() << 8;
+	tmp |= (ulg) get_byte() << 16;
+	tmp |= (ulg) get_byte() << 24;
+
+	return tmp;
+}
+
+/*
+ * check and skip the gzip header
+ */
+static int gzip_header(void)
+{
+	unsigned flag, skip;
 
-	if(!gzip_check(inptr, 0x100))
+	if(get_byte() != 0x1f || get_byte() != 0x8b)
 		return INFLATE_ERR_NOT_GZIP;
-	inptr += 2;
 
-	if(*inptr++ != 0x08)												// "deflate" method
+	if(get_byte() != 0x08)											// "deflate" method
 		return INFLATE_ERR_NOT_DEFLATE;
 
-	flag = *inptr++;
+	flag = get_byte();
 
-	inptr += 4;															// skip time stamp
-	++inptr;																// skip extra flags
-	++inptr;																// skip OS type
+	for(skip = 4 + 1 + 1; skip; --skip)							// skip time stamp, extra flags, OS type
+		get_byte();
 
-	if(flag & (1 << 2))												// skip extra headers
-		inptr += 2 + (inptr[0] | ((unsigned) inptr[1] << 8));
+	if(flag & (1 << 2)) {											// skip extra headers
+		skip = get_byte();
+		for(skip |= get_byte() << 8; skip; --skip)
+			get_byte();
+	}
 
 	if(flag & (1 << 3))												// skip filename
-		while(*inptr++)
+		while(get_byte() && !inerror)
 			;
 
 	if(flag & (1 << 4))												// skip comment
-		while(*inptr++)
+		while(get_byte() && !inerror)
 			;
 
-	if(flag & (1 << 1))												// skip header CRC
-		inptr += 2;
+	if(flag & (1 << 1)) {											// skip header CRC
+		get_byte();
+		get_byte();
+	}
+
+	return inerror ? INFLATE_ERR_READ : 0;
+}
+
+/*
+ * inflate the data following the header and check the trailer
+ */
+static int gzip_body(void)
+{
+	int res;
 
 	outcnt = 0;
-	outdata = out;
 	outptr = 0;
-	outmax = max;
 	crc = 0xffffffff;
 
 	res = inflate();
+	if(inerror)
+		return INFLATE_ERR_READ;
 	if(res)
 		return -res;
 
-	tmp = inptr[3];													// fetch CRC
-	tmp = (tmp << 8) | inptr[2];
-	tmp = (tmp << 8) | inptr[1];
-	tmp = (tmp << 8) | inptr[0];
-
-	if(tmp != ~crc)
-		return INFLATE_ERR_BAD_CRC;
+	if(outstop)
+		return outptr;
 
-	tmp = inptr[7];													// fetch original length
-	tmp = (tmp << 8) | inptr[6];
-	tmp = (tmp << 8) | inptr[5];
-	tmp = (tmp << 8) | inptr[4];
+	if(get_long() != (~crc & 0xffffffff))
+		return inerror ? INFLATE_ERR_READ : INFLATE_ERR_BAD_CRC;
 
-	if(tmp != outptr)
-		return INFLATE_ERR_BAD_LENGTH;
+	if(get_long() != (outptr & 0xffffffff))
+		return inerror ? INFLATE_ERR_READ : INFLATE_ERR_BAD_LENGTH;
 
 	return outptr;
 }
 
-int unzip(const void *base, size_t size)
+int decompress(const void *in, void *out, size_t max)
+{
+	int res;
+
+	if(!gzip_check(in, 0x100))
+		return INFLATE_ERR_NOT_GZIP;
+
+	inptr = in;
+	inend = (const uch *) ~0UL;
+	infill = NULL;
+	inerror = 0;
+
+	outsink = NULL;
+	outdata = out;
+	outmax = max;
+
+	res = gzip_header();
+	if(res)
+		return res;
+
+	return gzip_body();
+}
+
+/*
+ * decompress a gzip stream pulled through 'fill' and pushed out through
+ * 'sink' a window at a time, 0 or error
+ */
+int inflate_stream(unsigned (*fill)(void *, unsigned), void (*sink)(const void *, unsigned))
+{
+	int res;
+
+	inptr = inbuf + INBUF_BACK;
+	inend = inptr;
+	infill = fill;
+	inerror = 0;
+
+	outsink = sink;
+	outdata = NULL;
+	outmax = 0;
+
+	res = gzip_header();
+	if(!res)
+		res = gzip_body();
+
+	infill = NULL;
+	outsink = NULL;
+
+	return res < 0 ? res : 0;
+}
+
+/*
+ * uncompressed size from gzip trailer
+ */
+size_t gzip_size(const void *base, size_t size)
 {
 	size_t uncomp;
+
+	uncomp = ((uint8_t *) base)[size - 1];
+	uncomp = ((uint8_t *) base)[size - 2] | (uncomp << 8);
+	uncomp = ((uint8_t *) base)[size - 3] | (uncomp << 8);
+	uncomp = ((uint8_t *) base)[size - 4] | (uncomp << 8);
+
+	return uncomp;
+}
+
+/*
+ * decompress just the start of a gzip image
+ */
+int gzip_peek(const void *base, void *out, size_t max)
+{
+	int res;
+
+	outstop = 1;
+	res = decompress(base, out, max);
+	outstop = 0;
+
+	return res;
+}
+
+int unzip(const void *base, size_t size)
+{
+	size_t uncomp, span;
+	int error, inplace;
 	void *targ;
-	int error;
 
 	if(!gzip_check(base, size)) {
 		puts("not compressed");
 		return 0;
 	}
 
-	uncomp = ((uint8_t *) base)[size - 1];
-	uncomp = ((uint8_t *) base)[size - 2] | (uncomp << 8);
-	uncomp = ((uint8_t *) base)[size - 3] | (uncomp << 8);
-	uncomp = ((uint8_t *) base)[size - 4] | (uncomp << 8);
+	uncomp = gzip_size(base, size);
 
-	targ = heap_reserve_hi(uncomp);
+	/*
+	 * try and decompress in place, with the compressed data at the tail of
+	 * the output and enough margin that the output never overtakes the input
+	 */
+
+	span = (uncomp > size ? uncomp : size) + INPLACE_MARGIN(uncomp);
+
+	targ = heap_reserve_at((void *) (((unsigned long) base + size - span) & ~15), uncomp, span);
+	inplace = targ != NULL;
+
+	if(!targ)
+		targ = heap_reserve_hi(uncomp);
 
 	if(!targ) {
 		puts("too large");
@@ -212,6 +353,12 @@ int unzip(const void *base, size_t size)
 
 	if(error < 0) {
 		printf("decompression failed #%d\n", -error);
+
+		/* image was overwritten */
+
+		if(inplace)
+			heap_region_free((void *) base);
+
 		return 0;
 	}
 
@@ -242,15 +389,27 @@ static void flush_window(void)
 {
 	ush idx;
 
-	for(idx = 0; idx < outcnt; ++idx) {
+	if(outsink) {
 
-		if(outptr < outmax)
-			outdata[outptr++] = window[idx];
+		for(idx = 0; idx < outcnt; ++idx)
+			crc = gzip_crc[(crc & 0xff) ^ window[idx]] ^ (crc >> 8);
 
-		crc = gzip_crc[(crc & 0xff) ^ window[idx]] ^ (crc >> 8);
-	}
+		outsink(window, outcnt);
+		outptr += outcnt;
+
+	} else
+
+		for(idx = 0; idx < outcnt; ++idx) {
+
+			if(outptr < outmax)
+				outdata[outptr++] = window[idx];
+
+			crc = gzip_crc[(crc & 0xff) ^ window[idx]] ^ (crc >> 8);
+		}
 
 	outcnt = 0;
+
+	yield();
 }
 
 /* inflate.c -- Not copyrighted 1992 by Mark Adler
@@ -464,7 +623,8 @@ static const ush mask_bits[] = {
 #else
 #  define NEXTBYTE()  (uch)get_byte()
 #endif
-#define NEEDBITS(n) {while(k<(n)){b|=((ulg)NEXTBYTE())<<k;k+=8;}}
+/* a failed refill when streaming gives up on the block */
+#define NEEDBITS(n) {while(k<(n)){b|=((ulg)NEXTBYTE())<<k;k+=8;if(inerror)return 4;}}
 #define DUMPBITS(n) {b>>=(n);k-=(n);}
 
 
@@ -1187,7 +1347,7 @@ static int inflate(void)
       return r;
     if (hufts > h)
       h = hufts;
-  } while (!e);
+  } while (!e && !(outstop && outptr >= outmax));
 
   /* Undo too much lookahead. The next read will be byte aligned so we
    * can discard unused bits in the last meaningful byte.
@@ -0,0 +1,520 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ *
+ * ISO9660 volumes, with Rock Ridge names where the disc has them. Files are
+ * a single contiguous extent so a load is one read straight into memory.
+ */
+
+#include "lib.h"
+
+#define ISO_SECTOR					2048
+#define ISO_VD_FIRST					16
+#define ISO_VD_LAST					32
+#define ISO_VD_PRIMARY				1
+#define ISO_VD_END					255
+#define ISO_NAME_MAX					255
+#define ISO_PATH_MAX					256
+
+#define ISO_FLAG_DIR					(1 << 1)
+#define ISO_FLAG_MORE				(1 << 7)		/* multi-extent file */
+
+#define RR_NM_CONTINUE				(1 << 0)
+
+static struct
+{
+	void				*device;
+	unsigned			sector_size;
+	unsigned long	root;
+	unsigned long	root_size;
+	unsigned long	cwd;
+	unsigned long	cwd_size;
+	unsigned			susp_skip;
+	int				rock;
+	int				mounted;
+	char				path[ISO_PATH_MAX];
+
+} iso;
+
+struct iso_dir
+{
+	unsigned long	extent;
+	unsigned long	size;
+	unsigned long	offset;
+};
+
+struct iso_entry
+{
+	unsigned long	extent;
+	unsigned long	size;
+	unsigned			flags;
+	int				rock;				/* name from Rock Ridge */
+	char				name[ISO_NAME_MAX + 1];
+};
+
+static unsigned long iso_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+static const uint8_t *iso_sector(unsigned long sector)
+{
+	return block_read(iso.device, sector, ISO_SECTOR, iso.sector_size);
+}
+
+/*
+ * pick the Rock Ridge name out of a record's system use area, 1 if there
+ * was one. names continued in another sector (CE) aren't followed
+ */
+static int iso_rock_name(const uint8_t *rec, char *name)
+{
+	unsigned posn, size, used;
+	const uint8_t *sue;
+
+	posn = 33 + rec[32] + !(rec[32] & 1) + iso.susp_skip;
+	used = 0;
+
+	for(; posn + 4 <= rec[0]; posn += size) {
+
+		sue = rec + posn;
+		size = sue[2];
+
+		if(size < 4 || posn + size > rec[0] || (sue[0] == 'S' && sue[1] == 'T'))
+			break;
+
+		if(sue[0] != 'N' || sue[1] != 'M' || size < 5)
+			continue;
+
+		if(used + size - 5 > ISO_NAME_MAX)
+			return 0;
+
+		memcpy(name + used, sue + 5, size - 5);
+		used += size - 5;
+
+		if(!(sue[4] & RR_NM_CONTINUE))
+			break;
+	}
+
+	if(!used)
+		return 0;
+
+	name[used] = '\0';
+
+	return 1;
+}
+
+/*
+ * unpack directory record
+ */
+static void iso_record(const uint8_t *rec, struct iso_entry *ent)
+{
+	unsigned size;
+
+	ent->extent = iso_le32(rec + 2);
+	ent->size = iso_le32(rec + 10);
+	ent->flags = rec[25];
+	ent->rock = 0;
+
+	size = rec[32];
+
+	if(size == 1 && rec[33] <= 1) {
+		strcpy(ent->name, rec[33] ? ".." : ".");
+		return;
+	}
+
+	if(iso.rock && iso_rock_name(rec, ent->name)) {
+		ent->rock = 1;
+		return;
+	}
+
+	/* plain ISO name, less the version and a trailing dot */
+
+	memcpy(ent->name, rec + 33, size);
+	ent->name[size] = '\0';
+
+	while(size && ent->name[size - 1] != ';')
+		--size;
+	if(size)
+		ent->name[--size] = '\0';
+	else
+		size = strlen(ent->name);
+
+	if(size && ent->name[size - 1] == '.')
+		ent->name[size - 1] = '\0';
+}
+
+/*
+ * fetch next directory entry, 0 at the end, -1 on error
+ */
+static int iso_next(struct iso_dir *dir, struct iso_entry *ent)
+{
+	const uint8_t *data, *rec;
+	unsigned posn;
+
+	for(;;) {
+
+		if(dir->offset >= dir->size)
+			return 0;
+
+		data = iso_sector(dir->extent + dir->offset / ISO_SECTOR);
+		if(!data)
+			return -1;
+
+		posn = dir->offset % ISO_SECTOR;
+		rec = data + posn;
+
+		/* records don't cross sectors, the rest is padding */
+
+		if(!rec[0]) {
+			dir->offset += ISO_SECTOR - posn;
+			continue;
+		}
+
+		if(rec[0] < 34 || posn + rec[0] > ISO_SECTOR || 33 + rec[32] > rec[0]) {
+			DPUTS("iso9660: directory corrupt");
+			return -1;
+		}
+
+		dir->offset += rec[0];
+
+		iso_record(rec, ent);
+
+		return 1;
+	}
+}
+
+/*
+ * look up path from the current directory, 1 if found, 0 if not, -1 on
+ * error
+ */
+static int iso_lookup(const char *path, struct iso_entry *ent)
+{
+	struct iso_dir dir;
+	unsigned size;
+	int stat;
+
+	ent->extent = iso.cwd;
+	ent->size = iso.cwd_size;
+
+	if(*path == '/') {
+		ent->extent = iso.root;
+		ent->size = iso.root_size;
+	}
+
+	ent->flags = ISO_FLAG_DIR;
+
+	for(;;) {
+
+		while(*path == '/')
+			++path;
+
+		if(!*path)
+			return 1;
+
+		for(size = 0; path[size] && path[size] != '/'; ++size)
+			;
+
+		if(size == 1 && path[0] == '.') {
+			++path;
+			continue;
+		}
+
+		if(!(ent->flags & ISO_FLAG_DIR))
+			return 0;
+
+		dir.extent = ent->extent;
+		dir.size = ent->size;
+		dir.offset = 0;
+
+		while((stat = iso_next(&dir, ent)) > 0) {
+
+			if(strlen(ent->name) != size)
+				continue;
+
+			if(ent->rock ? !strncmp(ent->name, path, size) : !strncasecmp(ent->name, path, size))
+				break;
+		}
+
+		if(stat <= 0)
+			return stat;
+
+		path += size;
+	}
+}
+
+/*
+ * mount volume
+ */
+int iso_mount(void *device)
+{
+	const uint8_t *data;
+	unsigned long sector;
+	unsigned posn;
+
+	iso.device = device;
+	iso.sector_size = ide_block_size(device);
+
+	for(sector = ISO_VD_FIRST;; ++sector) {
+
+		data = iso_sector(sector);
+		if(!data)
+			return 0;
+
+		if(memcmp(data + 1, "CD001", 5) || data[0] == ISO_VD_END || sector == ISO_VD_LAST) {
+			DPUTS("iso9660: no primary volume descriptor");
+			return 0;
+		}
+
+		if(data[0] == ISO_VD_PRIMARY)
+			break;
+	}
+
+	if((data[128] | (data[129] << 8)) != ISO_SECTOR) {
+		DPUTS("iso9660: unsupported block size");
+		return 0;
+	}
+
+	iso.root = iso_le32(data + 156 + 2);
+	iso.root_size = iso_le32(data + 156 + 10);
+
+	/* Rock Ridge volumes start the root's "." with an SP entry */
+
+	iso.rock = 0;
+	iso.susp_skip = 0;
+
+	data = iso_sector(iso.root);
+	if(!data)
+		return 0;
+
+	posn = 33 + data[32] + !(data[32] & 1);
+
+	if(data[0] >= posn + 7 && data[posn] == 'S' && data[posn + 1] == 'P' &&
+		data[posn + 4] == 0xbe && data[posn + 5] == 0xef)
+	{
+		iso.rock = 1;
+		iso.susp_skip = data[posn + 6];
+		DPUTS("iso9660: Rock Ridge");
+	}
+
+	iso.cwd = iso.root;
+	iso.cwd_size = iso.root_size;
+	strcpy(iso.path, "/");
+
+	iso.mounted = 1;
+
+	return 1;
+}
+
+/*
+ * unmount volume
+ */
+void iso_umount(void)
+{
+	if(!iso.mounted)
+		return;
+
+	block_flush(iso.device);
+
+	iso.mounted = 0;
+}
+
+int iso_mounted(void)
+{
+	return iso.mounted;
+}
+
+/*
+ * open file and return handle
+ */
+void *iso_open(const char *path, unsigned long *size)
+{
+	struct iso_entry ent;
+	int stat;
+
+	stat = iso_lookup(path, &ent);
+	if(stat <= 0) {
+		if(!stat)
+			puts("file not found");
+		return NULL;
+	}
+
+	if(ent.flags & ISO_FLAG_DIR) {
+		puts("not a file");
+		return NULL;
+	}
+
+	if(ent.flags & ISO_FLAG_MORE) {
+		puts("file too large");
+		return NULL;
+	}
+
+	if(size)
+		*size = ent.size;
+
+	/* an empty file needn't have an extent, but nothing's read from it */
+
+	return (void *) (ent.extent ? ent.extent : iso.root);
+}
+
+/*
+ * load file into memory, whole sectors in one read, then the tail
+ */
+int iso_load(void *hdl, void *where, unsigned long size)
+{
+	unsigned long extent, count;
+	const uint8_t *data;
+
+	extent = (unsigned long) hdl;
+	count = size / ISO_SECTOR;
+
+	if(count) {
+
+		if(!block_read_run(iso.device, where, extent, count, ISO_SECTOR, iso.sector_size))
+			return 0;
+
+		digest_update(where, count * ISO_SECTOR);
+	}
+
+	size %= ISO_SECTOR;
+
+	if(size) {
+
+		data = iso_sector(extent + count);
+		if(!data)
+			return 0;
+
+		memcpy(where + count * ISO_SECTOR, data, size);
+		digest_update(where + count * ISO_SECTOR, size);
+	}
+
+	return 1;
+}
+
+/*
+ * list directory or file
+ */
+static int iso_list_entry(const char *path)
+{
+	struct iso_entry ent;
+	struct iso_dir dir;
+	int stat;
+
+	stat = iso_lookup(path, &ent);
+	if(stat <= 0)
+		return stat;
+
+	if(!(ent.flags & ISO_FLAG_DIR)) {
+		printf("%10lu  ", ent.size);
+		putstring_safe(path, -1);
+		putchar('\n');
+		return 1;
+	}
+
+	dir.extent = ent.extent;
+	dir.size = ent.size;
+	dir.offset = 0;
+
+	while((stat = iso_next(&dir, &ent)) > 0) {
+
+		printf("%10lu  ", ent.size);
+		putstring_safe(ent.name, -1);
+
+		if(ent.flags & ISO_FLAG_DIR)
+			putchar('/');
+
+		putchar('\n');
+	}
+
+	return !stat;
+}
+
+/*
+ * 'ls' on an ISO9660 volume
+ */
+int iso_list(void)
+{
+	unsigned indx;
+	char *path;
+
+	for(indx = 1; indx == 1 || indx < argc; ++indx) {
+
+		path = indx < argc ? argv[indx] : ".";
+
+		if(iso_list_entry(path) <= 0)
+			printf("file not found \"%s\"\n", path);
+	}
+
+	return E_NONE;
+}
+
+/*
+ * 'cd' on an ISO9660 volume, the path is kept as a string as directories
+ * don't know their names
+ */
+int iso_chdir(void)
+{
+	char work[ISO_PATH_MAX];
+	struct iso_entry ent;
+	unsigned used, size;
+	const char *path;
+
+	if(argc > 1) {
+
+		path = argv[1];
+
+		if(iso_lookup(path, &ent) <= 0) {
+			puts("directory not found");
+			return E_UNSPEC;
+		}
+
+		if(!(ent.flags & ISO_FLAG_DIR)) {
+			puts("not a directory");
+			return E_UNSPEC;
+		}
+
+		strcpy(work, *path == '/' ? "/" : iso.path);
+		used = strlen(work);
+
+		while(*path) {
+
+			for(size = 0; path[size] && path[size] != '/'; ++size)
+				;
+
+			if(size == 2 && path[0] == '.' && path[1] == '.') {
+				while(used > 1 && work[used - 1] != '/')
+					--used;
+				if(used > 1)
+					--used;
+			} else if(size && (size != 1 || path[0] != '.')) {
+				if(used + size + 2 > sizeof(work)) {
+					puts("path too long");
+					return E_UNSPEC;
+				}
+				if(used > 1)
+					work[used++] = '/';
+				memcpy(work + used, path, size);
+				used += size;
+			}
+
+			work[used] = '\0';
+
+			path += size;
+			if(*path)
+				++path;
+		}
+
+		strcpy(iso.path, work);
+
+		iso.cwd = ent.extent;
+		iso.cwd_size = ent.size;
+	}
+
+	puts(iso.path);
+
+	return E_NONE;
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
@@ -10,7 +10,7 @@
 #include "cpu.h"
 #include "keymap.h"
 
-#define INTER_KEY_TIMEOUT				(CP0_COUNT_RATE / 20)
+#define INTER_KEY_TIMEOUT				50						// ms
 #define MAX_BIND_CHARS					16
 
 #define screen_vt100_bind				minicom_vt102_bind
@@ -97,7 +97,7 @@ int kgetch(void)
 	static char buf[MAX_BIND_CHARS];
 	const struct keybind_t *bind;
 	static unsigned fill;
-	unsigned long mark;
+	struct timer limit;
 	unsigned indx;
 	char chr;
 
@@ -121,7 +121,7 @@ int kgetch(void)
 			return bind[indx].code;
 		}
 
-		for(mark = MFC0(CP0_COUNT); !kbhit() && MFC0(CP0_COUNT) - mark < INTER_KEY_TIMEOUT;)
+		for(timer_set(&limit, INTER_KEY_TIMEOUT); !kbhit() && !timer_expired(&limit);)
 			;
 
 		if(!kbhit())
@@ -141,7 +141,7 @@ int kgetch(void)
 int cmnd_keyshow(int opsz)
 {
 	static char buf[MAX_BIND_CHARS];
-	unsigned long mark;
+	struct timer limit;
 	unsigned indx, key;
 
 	if(argc > 1)
@@ -156,7 +156,7 @@ int cmnd_keyshow(int opsz)
 			buf[indx] = key;
 		++indx;
 
-		for(mark = MFC0(CP0_COUNT); !kbhit() && MFC0(CP0_COUNT) - mark < CP0_COUNT_RATE;)
+		for(timer_set(&limit, 1000); !kbhit() && !timer_expired(&limit);)
 			;
 
 	} while(kbhit());
@@ -15,9 +15,12 @@
 
 #define BUTTON_DEBOUNCE				50
 
-#define LCD_TIMEOUT					(CP0_COUNT_RATE/50)	// 20ms
+#define LCD_TIMEOUT					20						// ms
+#define LCD_REFRESH					100					// ms
+#define LCD_ROWS						2
 #define LCD_COLUMNS					16
 #define LCD_ROW_OFFSET				0x40
+#define LCD_ADDR_UNKNOWN			(~0U)
 
 #define LCD_BASE						((volatile unsigned *) BRDG_NCS3_BASE)
 #define _LCD_WRITE(r,d)				do{LCD_BASE[!!(r)*4]=(unsigned)(d)<<24;}while(0)
@@ -34,23 +37,30 @@ static int lcd_menu_init(const char **, unsigned, unsigned);
 
 int (*lcd_menu)(const char **, unsigned, unsigned) = lcd_menu_init;
 
+static char lcd_frame[LCD_ROWS][LCD_COLUMNS];		/* what we want shown */
+static char lcd_shadow[LCD_ROWS][LCD_COLUMNS];		/* what is shown */
+static unsigned lcd_known;									/* rows with a valid shadow */
+static unsigned lcd_dirty;									/* rows changed since the flush */
+static unsigned lcd_addr = LCD_ADDR_UNKNOWN;
+static struct timer lcd_refresh;
+
 /*
  * wait for LCD ready
  */
 static void lcd_wait(void)
 {
-	unsigned mark;
+	struct timer limit;
 
-	for(mark = MFC0(CP0_COUNT); (_LCD_READ(0) & LCD_BUSY) && MFC0(CP0_COUNT) - mark < LCD_TIMEOUT;)
+	for(timer_set(&limit, LCD_TIMEOUT); (_LCD_READ(0) & LCD_BUSY) && !timer_expired(&limit);)
 		udelay(2);
 
 	udelay(10);
 }
 
 /*
- * write text to LCD
+ * put text in the frame (pad with spaces)
  */
-static void lcd_text(const char *str, int size)
+static void lcd_text(int row, int col, const char *str, int size)
 {
 	unsigned indx;
 
@@ -58,10 +68,54 @@ static void lcd_text(const char *str, int size)
 
 	if(str)
 		for(; indx < (unsigned) size && str[indx]; ++indx)
-			LCD_WRITE(1, str[indx]);
+			lcd_frame[row][col + indx] = str[indx];
 
 	for(; indx < size; ++indx)
-		LCD_WRITE(1, ' ');
+		lcd_frame[row][col + indx] = ' ';
+
+	lcd_dirty |= 1 << row;
+}
+
+/*
+ * send the characters that changed, moving the cursor only over gaps
+ */
+void lcd_flush(void)
+{
+	unsigned row, col, addr;
+
+	for(row = 0; row < LCD_ROWS; ++row) {
+
+		if(!(lcd_dirty & (1 << row)))
+			continue;
+
+		for(col = 0; col < LCD_COLUMNS; ++col) {
+
+			if((lcd_known & (1 << row)) && lcd_frame[row][col] == lcd_shadow[row][col])
+				continue;
+
+			addr = LCD_ROW_OFFSET * row + col;
+			if(addr != lcd_addr)
+				LCD_WRITE(0, LCD_DDRAM_ADDR | addr);
+
+			LCD_WRITE(1, lcd_frame[row][col]);
+
+			lcd_shadow[row][col] = lcd_frame[row][col];
+			lcd_addr = addr + 1;
+		}
+	}
+
+	lcd_known |= lcd_dirty;
+	lcd_dirty = 0;
+	timer_set(&lcd_refresh, LCD_REFRESH);
+}
+
+/*
+ * send deferred updates, at most every LCD_REFRESH
+ */
+void lcd_poll(void)
+{
+	if(lcd_dirty && timer_expired(&lcd_refresh))
+		lcd_flush();
 }
 
 /*
@@ -69,9 +123,17 @@ static void lcd_text(const char *str, int size)
  */
 void lcd_line(int row, const char *str)
 {
-	LCD_WRITE(0, LCD_DDRAM_ADDR | (LCD_ROW_OFFSET * !!row));
+	lcd_text(!!row, 0, str, LCD_COLUMNS);
 
-	lcd_text(str, LCD_COLUMNS);
+	lcd_flush();
+}
+
+/*
+ * write text to a line of the LCD later, for use on busy paths
+ */
+void lcd_post(int row, const char *str)
+{
+	lcd_text(!!row, 0, str, LCD_COLUMNS);
 }
 
 /*
@@ -91,6 +153,8 @@ static void lcd_prog_chars(void)
 
 		for(indx = 0; indx < sizeof(data); ++indx)
 			LCD_WRITE(1, data[indx]);
+
+		lcd_addr = LCD_ADDR_UNKNOWN;
 	}
 }
 
@@ -121,7 +185,7 @@ static void lcd_scroll(const char *str, int dir)
 {
 	static char lcd[LCD_COLUMNS - 2];
 	char buf[LCD_COLUMNS - 2];
-	unsigned idx, num, mark;
+	unsigned idx, num;
 
 	lcd_centre(buf, str, sizeof(buf));
 
@@ -131,10 +195,10 @@ static void lcd_scroll(const char *str, int dir)
 
 		lcd_prog_chars();
 
-		LCD_WRITE(0, LCD_DDRAM_ADDR | LCD_ROW_OFFSET);
-		LCD_WRITE(1, '\001');
-		lcd_text(lcd, LCD_COLUMNS - 2);
-		LCD_WRITE(1, '\002');
+		lcd_text(1, 0, "\001", 1);
+		lcd_text(1, 1, lcd, LCD_COLUMNS - 2);
+		lcd_text(1, LCD_COLUMNS - 1, "\002", 1);
+		lcd_flush();
 
 		return;
 	}
@@ -154,14 +218,13 @@ static void lcd_scroll(const char *str, int dir)
 			lcd[0] = buf[num - 1];
 		}
 
-		LCD_WRITE(0, (LCD_DDRAM_ADDR | LCD_ROW_OFFSET) + 1);
-		lcd_text(lcd, LCD_COLUMNS - 2);
+		lcd_text(1, 1, lcd, LCD_COLUMNS - 2);
+		lcd_flush();
 
 		if(!--num)
 			break;
 
-		for(mark = MFC0(CP0_COUNT); MFC0(CP0_COUNT) - mark < CP0_COUNT_RATE / 33;)
-			;
+		timer_sleep(30);
 	}
 }
 
@@ -170,7 +233,8 @@ static void lcd_scroll(const char *str, int dir)
  */
 static int lcd_menu_horz(const char **options, unsigned count, unsigned timeout)
 {
-	unsigned done, mark, sel, btn, prv;
+	unsigned done, sel, btn, prv;
+	struct timer limit;
 	char buf[LCD_COLUMNS];
 	int dir;
 
@@ -178,8 +242,7 @@ static int lcd_menu_horz(const char **options, unsigned count, unsigned timeout)
 		return LCD_MENU_BAD_ARGS;
 
 	lcd_centre(buf, options[0], sizeof(buf));
-	LCD_WRITE(0, LCD_DDRAM_ADDR);
-	lcd_text(buf, sizeof(buf));
+	lcd_text(0, 0, buf, sizeof(buf));
 
 	lcd_scroll(options[1], 0);
 
@@ -191,7 +254,7 @@ static int lcd_menu_horz(const char **options, unsigned count, unsigned timeout)
 		if(timeout && done > timeout)
 			return LCD_MENU_TIMEOUT;
 
-		for(mark = MFC0(CP0_COUNT); MFC0(CP0_COUNT) - mark < ((CP0_COUNT_RATE + 500) / 1000) * BUTTON_DEBOUNCE;)
+		for(timer_set(&limit, BUTTON_DEBOUNCE); !timer_expired(&limit);)
 			if(BREAK())
 				return LCD_MENU_BREAK;
 
@@ -236,7 +299,8 @@ static int lcd_menu_horz(const char **options, unsigned count, unsigned timeout)
  */
 static int lcd_menu_vert(const char **options, unsigned count, unsigned timeout)
 {
-	unsigned mark, done, row, top, btn;
+	unsigned done, row, top, btn;
+	struct timer limit;
 	int prv;
 
 	if(count < 2)
@@ -251,22 +315,22 @@ static int lcd_menu_vert(const char **options, unsigned count, unsigned timeout)
 
 	for(;;) {
 
-		LCD_WRITE(0, LCD_DDRAM_ADDR);
-		LCD_WRITE(1, row ? ' ' : '\002');
-		lcd_text(options[top], LCD_COLUMNS - 2);
-		LCD_WRITE(1, row ? ' ' : '\001');
+		lcd_text(0, 0, row ? " " : "\002", 1);
+		lcd_text(0, 1, options[top], LCD_COLUMNS - 2);
+		lcd_text(0, LCD_COLUMNS - 1, row ? " " : "\001", 1);
+
+		lcd_text(1, 0, row ? "\002" : " ", 1);
+		lcd_text(1, 1, options[top + 1], LCD_COLUMNS - 2);
+		lcd_text(1, LCD_COLUMNS - 1, row ? "\001" : " ", 1);
 
-		LCD_WRITE(0, LCD_DDRAM_ADDR | LCD_ROW_OFFSET);
-		LCD_WRITE(1, row ? '\002' : ' ');
-		lcd_text(options[top + 1], LCD_COLUMNS - 2);
-		LCD_WRITE(1, row ? '\001' : ' ');
+		lcd_flush();
 
 		for(done = 0;; done += BUTTON_DEBOUNCE) {
 
 			if(timeout && done > timeout)
 				return LCD_MENU_TIMEOUT;
 
-			for(mark = MFC0(CP0_COUNT); MFC0(CP0_COUNT) - mark < ((CP0_COUNT_RATE + 500) / 1000) * BUTTON_DEBOUNCE;)
+			for(timer_set(&limit, BUTTON_DEBOUNCE); !timer_expired(&limit);)
 				if(BREAK())
 					return LCD_MENU_BREAK;
 
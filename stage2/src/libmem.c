@@ -9,13 +9,12 @@
 #include "lib.h"
 #include "cpu.h"
 
-void *memcpy(void *dst, const void *src, size_t size)
+#define COPY_CHUNK				(64 << 10)
+
+static void copy_up(void *dst, const void *src, size_t size)
 {
 	void *ptr, *end;
 
-	if(!size || dst == src)
-		return dst;
-
 	ptr = dst;
 	end = ptr + size;
 
@@ -33,23 +32,14 @@ void *memcpy(void *dst, const void *src, size_t size)
 		*(uint8_t *) ptr = *(uint8_t *) src;
 		++ptr, ++src;
 	}
-
-	return dst;
 }
 
-void *memmove(void *dst, const void *src, size_t size)
+static void copy_down(void *dst, const void *src, size_t size)
 {
 	const void *esrc;
 	void *edst;
 
-	if(!size || src == dst)
-		return dst;
-
 	esrc = src + size;
-	
-	if(src >= dst || esrc <= dst)
-		return memcpy(dst, src, size);
-
 	edst = dst + size;
 
 	while(edst > dst && ((unsigned long) edst & 3)) {
@@ -66,6 +56,45 @@ void *memmove(void *dst, const void *src, size_t size)
 		--edst, --esrc;
 		*(uint8_t *) edst = *(uint8_t *) esrc;
 	}
+}
+
+/*
+ * big copies (images) are done in pieces, letting the background tasks
+ * run in between
+ */
+void *memcpy(void *dst, const void *src, size_t size)
+{
+	size_t done;
+
+	if(!size || dst == src)
+		return dst;
+
+	for(done = 0; size - done > COPY_CHUNK; done += COPY_CHUNK) {
+		copy_up(dst + done, src + done, COPY_CHUNK);
+		yield();
+	}
+
+	copy_up(dst + done, src + done, size - done);
+
+	return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t size)
+{
+	if(!size || src == dst)
+		return dst;
+
+	if(src >= dst || src + size <= dst)
+		return memcpy(dst, src, size);
+
+	/* overlapping with the destination above, copy from the top down */
+
+	for(; size > COPY_CHUNK; size -= COPY_CHUNK) {
+		copy_down(dst + size - COPY_CHUNK, src + size - COPY_CHUNK, COPY_CHUNK);
+		yield();
+	}
+
+	copy_down(dst, src, size);
 
 	return dst;
 }
@@ -17,15 +17,19 @@ size_t ram_size, ram_restrict;
 
 static int do_boot(unsigned switches)
 {
-	unsigned long mark;
+	struct timer limit;
+
+	boot_preload();
 
 	if(!(switches & (BUTTON_ENTER | BUTTON_SELECT)))
 		return boot(BOOT_MENU);
 
 	if(!(nv_store.flags & NVFLAG_CONSOLE_DISABLE))
-		for(mark = MFC0(CP0_COUNT); MFC0(CP0_COUNT) - mark < CP0_COUNT_RATE * 2 / 3;)
-			if(BREAK())
+		for(timer_set(&limit, 667); !timer_expired(&limit);)
+			if(BREAK()) {
+				preload_abort();
 				return E_NONE;
+			}
 
 	return boot(BOOT_DEFAULT);
 }
@@ -42,6 +46,13 @@ void loader(size_t bank0, size_t bank1, unsigned switches)
 
 	nv_get(!(switches & BUTTON_CLEAR));
 
+	/* start the slow devices now, boot paths wait only on what they use */
+
+	tulip_init();
+	tulip_start();
+
+	ide_init();
+
 	puts("\n[ \"CoLo\" v" _STR(VER_MAJOR) "." _STR(VER_MINOR) " ]");
 
 	serial_scan();
@@ -56,10 +67,6 @@ void loader(size_t bank0, size_t bank1, unsigned switches)
 
 	printf("pci: unit type <%s>\n", pci_unit_name());
 
-	tulip_init();
-
-	ide_init();
-
 	block_init();
 
 	heap_reset();
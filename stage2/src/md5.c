@@ -82,6 +82,17 @@ MD5Update(struct MD5Context *ctx, md5byte const *buf, unsigned len)
 	buf += t;
 	len -= t;
 
+#ifndef WORDS_BIGENDIAN
+	/* Aligned data can be transformed where it lies */
+	if (!((unsigned long)buf & 3)) {
+		while (len >= 64) {
+			MD5Transform(ctx->buf, (UWORD32 const *)buf);
+			buf += 64;
+			len -= 64;
+		}
+	}
+#endif
+
 	/* Process data in 64-byte chunks */
 	while (len >= 64) {
 		memcpy(ctx->in, buf, 64);
@@ -128,7 +139,7 @@ MD5Final(md5byte digest[16], struct MD5Context *ctx)
 
 	byteSwap(ctx->buf, 4);
 	memcpy(digest, ctx->buf, 16);
-	memset(ctx, 0, sizeof(ctx));	/* In case it's sensitive */
+	memset(ctx, 0, sizeof(*ctx));	/* In case it's sensitive */
 }
 
 #ifndef ASM_MD5
@@ -9,6 +9,7 @@
 #include "lib.h"
 #include "cpu.h"
 #include "md5.h"
+#include "sha256.h"
 
 #define DEFAULT_ADDR					0x80000000
 
@@ -266,42 +267,56 @@ int cmnd_dump(int opsz)
 	return E_NONE;
 }
 
-int cmnd_md5sum(int opsz)
+/*
+ * parse arguments for md5sum/sha256sum
+ */
+static void *hash_args(size_t *size)
 {
-	struct MD5Context ctx;
-	uint8_t digest[16];
 	unsigned long addr;
-	unsigned indx;
-	size_t size;
 	char *ptr;
 
 	if(argc > 1) {
 
-		if(argc == 2)
-			return E_ARGS_COUNT;
-		if(argc > 3)
-			return E_ARGS_OVER;
-
 		addr = evaluate(argv[1], &ptr);
 		if(*ptr)
-			return E_BAD_EXPR;
+			return NULL;
 
-		size = evaluate(argv[2], &ptr);
+		*size = evaluate(argv[2], &ptr);
 		if(*ptr)
-			return E_BAD_EXPR;
+			return NULL;
 
-	} else {
+		return kseg_addr(addr, *size);
+	}
 
-		addr = (unsigned long) heap_image(&size);
+	addr = (unsigned long) heap_image(size);
 
-		if(!size) {
-			puts("no data loaded");
-			return E_UNSPEC;
-		}
+	if(!*size) {
+		puts("no data loaded");
+		return NULL;
 	}
 
+	return (void *) addr;
+}
+
+int cmnd_md5sum(int opsz)
+{
+	struct MD5Context ctx;
+	uint8_t digest[16];
+	unsigned indx;
+	size_t size;
+	void *base;
+
+	if(argc == 2)
+		return E_ARGS_COUNT;
+	if(argc > 3)
+		return E_ARGS_OVER;
+
+	base = hash_args(&size);
+	if(!base)
+		return argc > 1 ? E_BAD_EXPR : E_UNSPEC;
+
 	MD5Init(&ctx);
-	MD5Update(&ctx, kseg_addr(addr, size), size);
+	MD5Update(&ctx, base, size);
 	MD5Final(digest, &ctx);
 
 	for(indx = 0; indx < sizeof(digest); ++indx)
@@ -311,4 +326,32 @@ int cmnd_md5sum(int opsz)
 	return E_NONE;
 }
 
+int cmnd_sha256sum(int opsz)
+{
+	struct SHA256Context ctx;
+	uint8_t digest[32];
+	unsigned indx;
+	size_t size;
+	void *base;
+
+	if(argc == 2)
+		return E_ARGS_COUNT;
+	if(argc > 3)
+		return E_ARGS_OVER;
+
+	base = hash_args(&size);
+	if(!base)
+		return argc > 1 ? E_BAD_EXPR : E_UNSPEC;
+
+	SHA256Init(&ctx);
+	SHA256Update(&ctx, base, size);
+	SHA256Final(digest, &ctx);
+
+	for(indx = 0; indx < sizeof(digest); ++indx)
+		printf("%02x", digest[indx]);
+	putchar('\n');
+
+	return E_NONE;
+}
+
 /* vi:set ts=3 sw=3 cin path=include,../include: */
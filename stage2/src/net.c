@@ -161,6 +161,60 @@ void net_down(int dhcp)
 	DPUTS("net: interface down");
 }
 
+static struct timer progress;
+static unsigned progress_bytes;
+
+static void progress_show(struct timer *timer)
+{
+	char text[16];
+
+	sprintf(text, "%uKB", progress_bytes / 1024);
+
+	printf(" %s\r", text);
+	lcd_post(1, text);
+}
+
+/*
+ * show load progress every 250ms until progress_stop()
+ */
+void progress_start(void)
+{
+	progress_bytes = 0;
+
+	putstring(" 0KB\r");
+
+	serial_nowait(1);
+
+	timer_start(&progress, 250, 250, progress_show, NULL);
+}
+
+void progress_update(unsigned bytes)
+{
+	progress_bytes = bytes;
+}
+
+/*
+ * stop the display, with a summary if the load worked
+ */
+void progress_stop(int done)
+{
+	unsigned tick;
+
+	timer_stop(&progress);
+
+	serial_nowait(0);
+
+	if(!done)
+		return;
+
+	tick = progress.fired;
+
+	if(tick)
+		printf("%uKB loaded (%uKB/sec)\n", (progress_bytes + 512) / 1024, (progress_bytes + 128) / (256 * tick));
+	else
+		printf("%uKB loaded\n", (progress_bytes + 512) / 1024);
+}
+
 int cmnd_net(int opsz)
 {
 	unsigned addr, mask, gway, argn;
@@ -8,22 +8,32 @@
 
 #include "lib.h"
 #include "net.h"
+#include "cpu.h"
 
-#define MAX_PAYLOAD								512
+#define MAX_PAYLOAD								(1500 - IP_HDRSZ - UDP_HDRSZ)
+#define MAX_QUEUED								4						/* leave the rest of the pool to the stack */
 
 #define DEFAULT_SRC_PORT						6665
 #define DEFAULT_DST_PORT						6666
 
-#define TRANSMIT_POLL_COUNT					20
+#define FLUSH_LINE								(CP0_COUNT_RATE / 1000)		/* idle after a newline */
+#define FLUSH_LIMIT								(CP0_COUNT_RATE / 50)		/* oldest unsent byte */
 
 static struct frame *rx_head;
 static struct frame *rx_tail;
 static struct frame *tx_head;
 static struct frame *tx_tail;
 static unsigned rx_part;
-static unsigned tx_seen;
+static unsigned tx_queued;
+static unsigned tx_first;
+static unsigned tx_last;
+static int tx_busy;
 static int udp_sock = -1;
 
+static unsigned stat_datagrams;
+static unsigned stat_bytes;
+static unsigned stat_dropped;
+
 /*
  * is net console enabled
  */
@@ -32,6 +42,40 @@ int netcon_enabled(void)
 	return udp_sock >= 0;
 }
 
+/*
+ * send queued output, the partly filled last frame only once it's due
+ */
+static void transmit(int force)
+{
+	struct frame *frame;
+	unsigned size, now;
+
+	now = MFC0(CP0_COUNT);
+
+	tx_busy = 1;
+
+	while(tx_head) {
+
+		frame = tx_head->link;
+		size = FRAME_SIZE(tx_head);
+
+		if(!frame && !force && size < MAX_PAYLOAD &&
+			now - tx_first < FLUSH_LIMIT &&
+			(((char *) FRAME_PAYLOAD(tx_head))[size - 1] != '\n' || now - tx_last < FLUSH_LINE))
+			break;
+
+		udp_send(udp_sock, tx_head);
+
+		++stat_datagrams;
+		stat_bytes += size;
+
+		tx_head = frame;
+		--tx_queued;
+	}
+
+	tx_busy = 0;
+}
+
 /*
  * disable net console
  */
@@ -41,6 +85,8 @@ void netcon_disable(void)
 
 	if(udp_sock >= 0) {
 
+		transmit(1);
+
 		udp_close(udp_sock);
 		udp_sock = -1;
 
@@ -51,13 +97,6 @@ void netcon_disable(void)
 			rx_head = frame;
 		}
 
-		while(tx_head) {
-			
-			frame = tx_head->link;
-			frame_free(tx_head);
-			tx_head = frame;
-		}
-
 		DPUTS("netcon: disabled");
 
 		env_remove_tag(VAR_NETCON);
@@ -73,17 +112,7 @@ int netcon_poll(void)
 
 	if(udp_sock >= 0) {
 
-		while(tx_head) {
-
-			frame = tx_head->link;
-			if(!frame && ++tx_seen < TRANSMIT_POLL_COUNT)
-				break;
-
-			udp_send(udp_sock, tx_head);
-
-			tx_head = frame;
-			tx_seen = 0;
-		}
+		transmit(0);
 
 		for(;;) {
 
@@ -152,7 +181,8 @@ unsigned netcon_read(void *data, unsigned size)
 }
 
 /*
- * write net console output
+ * write net console output, queued until the poll sends it unless the queue
+ * fills up first
  */
 unsigned netcon_write(const void *data, unsigned size)
 {
@@ -161,7 +191,7 @@ unsigned netcon_write(const void *data, unsigned size)
 
 	copy = 0;
 
-	if(udp_sock >= 0)
+	if(udp_sock >= 0) {
 
 		while(copy < size) {
 
@@ -185,6 +215,14 @@ unsigned netcon_write(const void *data, unsigned size)
 
 			} else {
 
+				/* send what's queued rather than lose the rest */
+
+				if(tx_queued == MAX_QUEUED) {
+					if(tx_busy)
+						break;
+					transmit(1);
+				}
+
 				frame = frame_alloc();
 				if(!frame)
 					break;
@@ -198,9 +236,17 @@ unsigned netcon_write(const void *data, unsigned size)
 				else
 					tx_head = frame;
 				tx_tail = frame;
+
+				++tx_queued;
+
+				tx_first = MFC0(CP0_COUNT);
 			}
 		}
 
+		tx_last = MFC0(CP0_COUNT);
+		stat_dropped += size - copy;
+	}
+
 	return copy;
 }
 
@@ -223,6 +269,19 @@ int cmnd_netcon(int opsz)
 	if(argc > 4)
 		return E_ARGS_OVER;
 
+	if(!strcasecmp(argv[1], "stats")) {
+
+		if(argc > 2)
+			return E_ARGS_OVER;
+
+		printf("%u datagrams, %u bytes", stat_datagrams, stat_bytes);
+		if(stat_datagrams)
+			printf(" (%u per datagram)", stat_bytes / stat_datagrams);
+		printf(", %u bytes dropped\n", stat_dropped);
+
+		return E_NONE;
+	}
+
 	if(!inet_aton(argv[1], &host)) {
 		puts("invalid address");
 		return E_UNSPEC;
@@ -263,6 +322,10 @@ int cmnd_netcon(int opsz)
 
 	udp_sock = udp_socket();
 
+	stat_datagrams = 0;
+	stat_bytes = 0;
+	stat_dropped = 0;
+
 	if(udp_sock < 0) {
 		puts("no socket available");
 		return E_UNSPEC;
@@ -12,6 +12,7 @@
 
 #define RPC_SEND_PACKETS_MAX			10
 #define NFS_READ_BLOCK					512
+#define NFS_STREAM_WINDOW				4
 #define SYMLINK_PATH_MAX				10
 
 #define RPC_PORTMAP_PORT				111
@@ -122,53 +123,127 @@ static union
 
 } scratch;
 
+static unsigned rpc_xid;
+
+/* streaming keeps a few READs in flight, each with a block to land in */
+
+#define SLOT_FREE							0
+#define SLOT_WAIT							1
+#define SLOT_FULL							2
+
+static struct
+{
+	unsigned			state;
+	unsigned			xid;
+	unsigned			offset;
+	unsigned			size;
+	unsigned			retries;
+	struct timer	limit;
+	uint8_t			data[NFS_READ_BLOCK];
+
+} nfs_slot[NFS_STREAM_WINDOW];
+
+static struct nfs_object nfs_file;
+static unsigned nfs_sent;
+static unsigned nfs_done;
+static unsigned nfs_size;
+static unsigned nfs_port_mnt;
+static uint32_t nfs_server;
+static const char *nfs_root;
+static int nfs_sock;
+
 /*
- * issue SUN RPC call and wait for reply
+ * send SUN RPC call
  */
-static struct frame *rpc_make_call(int sock, unsigned prog, unsigned vers, unsigned proc, const void *args, unsigned argsz)
+static void rpc_send(int sock, unsigned xid, unsigned prog, unsigned vers, unsigned proc, const void *args, unsigned argsz)
 {
-	static unsigned xid;
-
-	unsigned retry, mark, stat, size, hdsz;
 	struct frame *frame;
 	void *data;
 
-	++xid;
+	frame = frame_alloc();
+	if(!frame)
+		return;
 
-	for(retry = 0; retry < RPC_SEND_PACKETS_MAX; ++retry) {
+	FRAME_INIT(frame, HARDWARE_HDRSZ + IP_HDRSZ + UDP_HDRSZ, 0x3c + argsz);
 
-		frame = frame_alloc();
-		if(frame) {
+	data = FRAME_PAYLOAD(frame);
 
-			FRAME_INIT(frame, HARDWARE_HDRSZ + IP_HDRSZ + UDP_HDRSZ, 0x3c + argsz);
+	NET_WRITE_LONG(data + 0x00, xid);
+	NET_WRITE_LONG(data + 0x04, RPC_CALL);
+	NET_WRITE_LONG(data + 0x08, RPC_VERSION);
+	NET_WRITE_LONG(data + 0x0c, prog);
+	NET_WRITE_LONG(data + 0x10, vers);
+	NET_WRITE_LONG(data + 0x14, proc);
 
-			data = FRAME_PAYLOAD(frame);
+	NET_WRITE_LONG(data + 0x18, RPC_AUTH_UNIX);
+	NET_WRITE_LONG(data + 0x1c, 5 * 4);
+	NET_WRITE_LONG(data + 0x20, 0);		/* stamp		*/
+	NET_WRITE_LONG(data + 0x24, 0);		/* hostname	*/
+	NET_WRITE_LONG(data + 0x28, 0);		/* uid		*/
+	NET_WRITE_LONG(data + 0x2c, 0);		/* gid		*/
+	NET_WRITE_LONG(data + 0x30, 0);		/* aux gids	*/
 
-			NET_WRITE_LONG(data + 0x00, xid);
-			NET_WRITE_LONG(data + 0x04, RPC_CALL);
-			NET_WRITE_LONG(data + 0x08, RPC_VERSION);
-			NET_WRITE_LONG(data + 0x0c, prog);
-			NET_WRITE_LONG(data + 0x10, vers);
-			NET_WRITE_LONG(data + 0x14, proc);
+	NET_WRITE_LONG(data + 0x34, RPC_AUTH_NULL);
+	NET_WRITE_LONG(data + 0x38, 0);
 
-			NET_WRITE_LONG(data + 0x18, RPC_AUTH_UNIX);
-			NET_WRITE_LONG(data + 0x1c, 5 * 4);
-			NET_WRITE_LONG(data + 0x20, 0);		/* stamp		*/
-			NET_WRITE_LONG(data + 0x24, 0);		/* hostname	*/
-			NET_WRITE_LONG(data + 0x28, 0);		/* uid		*/
-			NET_WRITE_LONG(data + 0x2c, 0);		/* gid		*/
-			NET_WRITE_LONG(data + 0x30, 0);		/* aux gids	*/
+	if(args)
+		memcpy(data + 0x3c, args, argsz);
 
-			NET_WRITE_LONG(data + 0x34, RPC_AUTH_NULL);
-			NET_WRITE_LONG(data + 0x38, 0);
+	udp_send(sock, frame);
+}
 
-			if(args)
-				memcpy(data + 0x3c, args, argsz);
+/*
+ * check for the reply to call 'xid', 1 if it is (and the header's been
+ * stripped), 0 if it isn't, -1 if the call failed
+ */
+static int rpc_reply(struct frame *frame, unsigned xid, unsigned prog, unsigned vers, unsigned proc)
+{
+	unsigned stat, size, hdsz;
+	void *data;
 
-			udp_send(sock, frame);
-		}
+	data = FRAME_PAYLOAD(frame);
+	size = FRAME_SIZE(frame);
+
+	if(size < 6 * 4 ||
+		NET_READ_LONG(data + 0x00) != xid ||
+		NET_READ_LONG(data + 0x04) != RPC_REPLY)
+		return 0;
 
-		for(mark = MFC0(CP0_COUNT); MFC0(CP0_COUNT) - mark < CP0_COUNT_RATE * 2;) {
+	hdsz = (NET_READ_LONG(data + 0x10) + 3) & ~3;
+	hdsz = 5 * 4 + hdsz + 4;
+
+	if(hdsz > size) {
+		printf("RPC call %u/%u.%u failed (invalid verifier)\n", prog, vers, proc);
+		return -1;
+	}
+
+	stat = NET_READ_LONG(data + hdsz - 4);
+	if(stat != RPC_SUCCESS || NET_READ_LONG(data + 0x08) != RPC_MSG_ACCEPTED) {
+		printf("RPC call %u/%u.%u failed (status %u)\n", prog, vers, proc, stat);
+		return -1;
+	}
+
+	FRAME_STRIP(frame, hdsz);
+
+	return 1;
+}
+
+/*
+ * issue SUN RPC call and wait for reply
+ */
+static struct frame *rpc_make_call(int sock, unsigned prog, unsigned vers, unsigned proc, const void *args, unsigned argsz)
+{
+	struct timer limit;
+	struct frame *frame;
+	unsigned retry;
+
+	++rpc_xid;
+
+	for(retry = 0; retry < RPC_SEND_PACKETS_MAX; ++retry) {
+
+		rpc_send(sock, rpc_xid, prog, vers, proc, args, argsz);
+
+		for(timer_set(&limit, 2 * 1000); !timer_expired(&limit);) {
 
 			if(BREAK()) {
 				puts("aborted   ");
@@ -178,32 +253,14 @@ static struct frame *rpc_make_call(int sock, unsigned prog, unsigned vers, unsig
 			frame = udp_recv(sock);
 			if(frame) {
 
-				data = FRAME_PAYLOAD(frame);
-				size = FRAME_SIZE(frame);
-
-				if(size >= 6 * 4 && 
-					NET_READ_LONG(data + 0x00) == xid &&
-					NET_READ_LONG(data + 0x04) == RPC_REPLY) {
+				switch(rpc_reply(frame, rpc_xid, prog, vers, proc)) {
 
-					hdsz = (NET_READ_LONG(data + 0x10) + 3) & ~3;
-					hdsz = 5 * 4 + hdsz + 4;
+					case 1:
+						return frame;
 
-					if(hdsz > size) {
-						printf("RPC call %u/%u.%u failed (invalid verifier)\n", prog, vers, proc);
+					case -1:
 						frame_free(frame);
 						return NULL;
-					}
-
-					stat = NET_READ_LONG(data + hdsz - 4);
-					if(stat != RPC_SUCCESS || NET_READ_LONG(data + 0x08) != RPC_MSG_ACCEPTED) {
-						printf("RPC call %u/%u.%u failed (status %u)\n", prog, vers, proc, stat);
-						frame_free(frame);
-						return NULL;
-					}
-
-					FRAME_STRIP(frame, hdsz);
-
-					return frame;
 				}
 
 				frame_free(frame);
@@ -444,18 +501,63 @@ static int nfs_lookup(int sock, const struct nfs_object *dir, const char *path,
 }
 
 /*
- * read a file over NFS
+ * build READ arguments in the scratch buffer, returns their size
  */
-static int nfs_read_file(int sock, const struct nfs_object *obj, void *buffer, unsigned total)
+static unsigned nfs_read_args(const struct nfs_object *obj, unsigned offset, unsigned copy)
 {
-	unsigned offset, copy, size, stat, read, update, mark, tick;
-	struct frame *frame;
+	memcpy(scratch.b, &obj->handle, NFS_FHSIZE);
+
+	NET_WRITE_LONG(&scratch.w[NFS_FHSIZE / 4], offset);
+	NET_WRITE_LONG(&scratch.w[NFS_FHSIZE / 4 + 1], copy);
+	NET_WRITE_LONG(&scratch.w[NFS_FHSIZE / 4 + 2], 0);
+
+	return NFS_FHSIZE + 3 * 4;
+}
+
+/*
+ * check READ reply holds the 'copy' bytes asked for, returns where they are
+ */
+static void *nfs_read_reply(struct frame *frame, unsigned copy)
+{
+	unsigned size, stat, read;
 	void *data;
 
-	putstring(" 0KB\r");
+	size = FRAME_SIZE(frame);
+	if(size < 4) {
+		puts("read invalid reply");
+		return NULL;
+	}
+
+	data = FRAME_PAYLOAD(frame);
+	stat = NET_READ_LONG(data);
+
+	if(stat != NFS_OK || size < 4 + NFS_FASIZE + 4) {
+		printf("read failed (%s)\n", nfs_error(stat));
+		return NULL;
+	}
+
+	read = NET_READ_LONG(data + 4 + NFS_FASIZE);
+	if(4 + (sizeof(struct nfs_object) - NFS_FHSIZE) + 4 + read > size) {
+		puts("read invalid reply size");
+		return NULL;
+	}
+
+	if(read != copy) {
+		puts("read file size different");
+		return NULL;
+	}
+
+	return data + 4 + NFS_FASIZE + 4;
+}
 
-	update = MFC0(CP0_COUNT);
-	tick = 0;
+/*
+ * read file data over NFS
+ */
+static int nfs_read_data(int sock, const struct nfs_object *obj, void *buffer, unsigned total)
+{
+	unsigned offset, copy, argsz;
+	struct frame *frame;
+	void *data;
 
 	for(offset = 0; offset < total;) {
 
@@ -463,66 +565,45 @@ static int nfs_read_file(int sock, const struct nfs_object *obj, void *buffer, u
 		if(copy > NFS_READ_BLOCK)
 			copy = NFS_READ_BLOCK;
 
-		memcpy(scratch.b, &obj->handle, NFS_FHSIZE);
-
-		NET_WRITE_LONG(&scratch.w[NFS_FHSIZE / 4], offset);
-		NET_WRITE_LONG(&scratch.w[NFS_FHSIZE / 4 + 1], copy);
-		NET_WRITE_LONG(&scratch.w[NFS_FHSIZE / 4 + 2], 0);
+		argsz = nfs_read_args(obj, offset, copy);
 
-		frame = rpc_make_call(sock, RPC_NFS_PROG, RPC_NFS_VERS, RPC_NFS_READ, scratch.b, NFS_FHSIZE + 3 * 4);
+		frame = rpc_make_call(sock, RPC_NFS_PROG, RPC_NFS_VERS, RPC_NFS_READ, scratch.b, argsz);
 		if(!frame)
 			return 0;
 
-		size = FRAME_SIZE(frame);
-		if(size < 4) {
-			puts("read invalid reply");
+		data = nfs_read_reply(frame, copy);
+		if(!data) {
 			frame_free(frame);
 			return 0;
 		}
 
-		data = FRAME_PAYLOAD(frame);
-		stat = NET_READ_LONG(data);
-
-		if(stat != NFS_OK || size < 4 + NFS_FASIZE + 4) {
-			printf("read failed (%s)\n", nfs_error(stat));
-			frame_free(frame);
-			return 0;
-		}
+		memcpy(buffer + offset, data, copy);
+		digest_update(buffer + offset, copy);
 
-		read = NET_READ_LONG(data + 4 + NFS_FASIZE);
-		if(4 + (sizeof(struct nfs_object) - NFS_FHSIZE) + 4 + read > size) {
-			puts("read invalid reply size");
-			frame_free(frame);
-			return 0;
-		}
+		frame_free(frame);
 
-		if(read != copy) {
-			puts("read file size different");
-			frame_free(frame);
-			return 0;
-		}
+		offset += copy;
 
-		memcpy(buffer + offset, data + 4 + NFS_FASIZE + 4, read);
+		progress_update(offset);
+	}
 
-		frame_free(frame);
+	return 1;
+}
 
-		offset += read;
+/*
+ * read a file over NFS
+ */
+static int nfs_read_file(int sock, const struct nfs_object *obj, void *buffer, unsigned total)
+{
+	int done;
 
-		mark = MFC0(CP0_COUNT);
+	progress_start();
 
-		if(mark - update >= CP0_COUNT_RATE / 4) {
-			update = mark;
-			++tick;
-			printf(" %uKB\r", offset / 1024);
-		}
-	}
+	done = nfs_read_data(sock, obj, buffer, total);
 
-	if(tick)
-		printf("%uKB loaded (%uKB/sec)\n", (offset + 512) / 1024, (offset + 128) / (256 * tick));
-	else
-		printf("%uKB loaded\n", (offset + 512) / 1024);
+	progress_stop(done);
 
-	return 1;
+	return done;
 }
 
 /*
@@ -781,62 +862,259 @@ static int dump_node(void *arg, const char *name, struct nfs_object *obj)
 	return 0;
 }
 
-int cmnd_nfs(int opsz)
+/*
+ * unmount 'root' and close the socket
+ */
+static void nfs_close(int sock, uint32_t server, unsigned port_mnt, const char *root)
 {
-	unsigned port_mnt, port_nfs, mode, size;
-	struct nfs_object mount, file;
-	uint32_t server;
-	int sock, error;
-	void *base;
+	udp_connect(sock, server, port_mnt);
 
-	if(argc < 3)
-		return E_ARGS_UNDER;
-	if(argc > 5)
-		return E_ARGS_OVER;
+	if(nfs_umount(sock, root) || nfs_umount_all(sock))
+		DPRINTF("nfs: unmounted \"%s\"\n", root);
 
-	if(!inet_aton(argv[1], &server)) {
-		puts("invalid address");
-		return E_UNSPEC;
-	}
+	udp_close(sock);
+}
 
-	if(!net_is_up())
-		return E_NET_DOWN;
+/*
+ * mount 'root' and get its attributes, returns the socket (connected to
+ * the NFS service) or -1
+ */
+static int nfs_open(uint32_t server, const char *root, struct nfs_object *mount, unsigned *port_mnt)
+{
+	unsigned port_nfs;
+	int sock;
 
 	sock = udp_socket();
 	if(sock < 0) {
 		puts("no socket");
-		return E_UNSPEC;
+		return -1;
 	}
 
 	udp_bind_range(sock, 768, 1024);
 
-	port_mnt = rpc_portmap(sock, server, RPC_MOUNT_PROG, RPC_MOUNT_VERS);
-	if(!port_mnt) {
+	*port_mnt = rpc_portmap(sock, server, RPC_MOUNT_PROG, RPC_MOUNT_VERS);
+	if(!*port_mnt) {
 		udp_close(sock);
-		return E_UNSPEC;
+		return -1;
 	}
 
 	port_nfs = rpc_portmap(sock, server, RPC_NFS_PROG, RPC_NFS_VERS);
 	if(!port_nfs) {
 		udp_close(sock);
-		return E_UNSPEC;
+		return -1;
 	}
 
-	udp_connect(sock, server, port_mnt);
+	udp_connect(sock, server, *port_mnt);
 
-	if(!nfs_mount(sock, argv[2], &mount)) {
+	if(!nfs_mount(sock, root, mount)) {
 		udp_close(sock);
-		return E_UNSPEC;
+		return -1;
 	}
 
-	DPRINTF("nfs: mounted \"%s\"\n", argv[2]);
+	DPRINTF("nfs: mounted \"%s\"\n", root);
 
 	udp_connect(sock, server, port_nfs);
 
-	error = E_UNSPEC;
+	if(!nfs_get_attr(sock, mount)) {
+		nfs_close(sock, server, *port_mnt, root);
+		return -1;
+	}
 
-	if(!nfs_get_attr(sock, &mount))
-		goto umount;
+	return sock;
+}
+
+/*
+ * (re)send a READ for stream slot
+ */
+static void nfs_slot_send(unsigned indx)
+{
+	unsigned argsz;
+
+	argsz = nfs_read_args(&nfs_file, nfs_slot[indx].offset, nfs_slot[indx].size);
+
+	rpc_send(nfs_sock, nfs_slot[indx].xid, RPC_NFS_PROG, RPC_NFS_VERS, RPC_NFS_READ, scratch.b, argsz);
+
+	timer_set(&nfs_slot[indx].limit, 2 * 1000);
+}
+
+/*
+ * stream a file over NFS. replies can come in any order so they're held in
+ * their slots until they can be put in order, a slot is only reused when
+ * its data has gone into the stream, which is the flow control
+ */
+static void nfs_pump(void)
+{
+	struct frame *frame;
+	unsigned indx, xid;
+	void *data;
+	int stat;
+
+	/* take the replies that have come in */
+
+	while((frame = udp_recv(nfs_sock))) {
+
+		xid = FRAME_SIZE(frame) >= 4 ? NET_READ_LONG(FRAME_PAYLOAD(frame)) : 0;
+
+		for(indx = 0; indx < NFS_STREAM_WINDOW; ++indx)
+			if(nfs_slot[indx].state == SLOT_WAIT && nfs_slot[indx].xid == xid)
+				break;
+
+		stat = indx < NFS_STREAM_WINDOW ? rpc_reply(frame, xid, RPC_NFS_PROG, RPC_NFS_VERS, RPC_NFS_READ) : 0;
+		if(stat > 0) {
+
+			data = nfs_read_reply(frame, nfs_slot[indx].size);
+			if(data) {
+				memcpy(nfs_slot[indx].data, data, nfs_slot[indx].size);
+				nfs_slot[indx].state = SLOT_FULL;
+			} else
+				stat = -1;
+		}
+
+		frame_free(frame);
+
+		if(stat < 0) {
+			stream_end(0);
+			return;
+		}
+	}
+
+	/* pass on what's next, in order */
+
+	for(indx = 0; indx < NFS_STREAM_WINDOW;)
+		if(nfs_slot[indx].state == SLOT_FULL && nfs_slot[indx].offset == nfs_done) {
+
+			if(stream_room() < nfs_slot[indx].size)
+				break;
+
+			stream_put(nfs_slot[indx].data, nfs_slot[indx].size);
+
+			nfs_done += nfs_slot[indx].size;
+			nfs_slot[indx].state = SLOT_FREE;
+
+			indx = 0;
+
+		} else
+			++indx;
+
+	if(nfs_done == nfs_size) {
+		stream_end(1);
+		return;
+	}
+
+	/* keep the window full, repeating any that have gone unanswered */
+
+	for(indx = 0; indx < NFS_STREAM_WINDOW; ++indx)
+		switch(nfs_slot[indx].state) {
+
+			case SLOT_FREE:
+				if(nfs_sent == nfs_size)
+					break;
+
+				nfs_slot[indx].state = SLOT_WAIT;
+				nfs_slot[indx].xid = ++rpc_xid;
+				nfs_slot[indx].offset = nfs_sent;
+				nfs_slot[indx].size = nfs_size - nfs_sent;
+				if(nfs_slot[indx].size > NFS_READ_BLOCK)
+					nfs_slot[indx].size = NFS_READ_BLOCK;
+				nfs_slot[indx].retries = 0;
+
+				nfs_sent += nfs_slot[indx].size;
+
+				nfs_slot_send(indx);
+				break;
+
+			case SLOT_WAIT:
+				if(!timer_expired(&nfs_slot[indx].limit))
+					break;
+
+				if(++nfs_slot[indx].retries == RPC_SEND_PACKETS_MAX) {
+					puts("no response");
+					stream_end(0);
+					return;
+				}
+
+				nfs_slot_send(indx);
+				break;
+		}
+}
+
+static void nfs_stream_close(void)
+{
+	nfs_close(nfs_sock, nfs_server, nfs_port_mnt, nfs_root);
+}
+
+/*
+ * mount 'root' and start streaming file 'path' from it into the stream,
+ * 'size' is set to its length
+ */
+int nfs_stream(uint32_t server, const char *root, const char *path, unsigned long *size)
+{
+	struct nfs_object mount;
+	unsigned indx;
+
+	nfs_sock = nfs_open(server, root, &mount, &nfs_port_mnt);
+	if(nfs_sock < 0)
+		return 0;
+
+	nfs_server = server;
+	nfs_root = root;
+
+	nfs_file = mount;
+
+	if(!nfs_path_lookup(nfs_sock, &mount, &nfs_file, path)) {
+		nfs_stream_close();
+		return 0;
+	}
+
+	if(!S_ISREG(NET_READ_LONG(&nfs_file.mode))) {
+		puts("not a file");
+		nfs_stream_close();
+		return 0;
+	}
+
+	nfs_size = NET_READ_LONG(&nfs_file.size);
+	*size = nfs_size;
+	nfs_sent = 0;
+	nfs_done = 0;
+
+	for(indx = 0; indx < NFS_STREAM_WINDOW; ++indx)
+		nfs_slot[indx].state = SLOT_FREE;
+
+	stream_source(nfs_pump, nfs_stream_close);
+
+	return 1;
+}
+
+int cmnd_nfs(int opsz)
+{
+	unsigned port_mnt, mode, size;
+	size_t space;
+	struct nfs_object mount, file;
+	uint32_t server;
+	int sock, error;
+	void *base;
+
+	if(!digest_args())
+		return E_BAD_VALUE;
+
+	if(argc < 3)
+		return E_ARGS_UNDER;
+	if(argc > 5)
+		return E_ARGS_OVER;
+
+	if(!inet_aton(argv[1], &server)) {
+		puts("invalid address");
+		return E_UNSPEC;
+	}
+
+	if(!net_is_up())
+		return E_NET_DOWN;
+
+	sock = nfs_open(server, argv[2], &mount, &port_mnt);
+	if(sock < 0)
+		return E_UNSPEC;
+
+	error = E_UNSPEC;
 
 	if(argc < 4) {
 
@@ -848,7 +1126,7 @@ int cmnd_nfs(int opsz)
 
 	heap_reset();
 
-	if(argc > 4) {
+	if(argc > 4 && !reloc_direct()) {
 
 		file = mount;
 
@@ -869,7 +1147,9 @@ int cmnd_nfs(int opsz)
 			goto umount;
 		}
 
-		if(!nfs_read_file(sock, &file, base, size))
+		digest_begin(4);
+
+		if(!nfs_read_file(sock, &file, base, size) || !digest_end(4))
 			goto umount;
 
 		heap_alloc();
@@ -908,24 +1188,62 @@ int cmnd_nfs(int opsz)
 		goto umount;
 	}
 
-	if(!nfs_read_file(sock, &file, base, size)) {
+	digest_begin(3);
+
+	if(!nfs_read_file(sock, &file, base, size) || !digest_end(3)) {
 		heap_reset();
 		goto umount;
 	}
 
 	heap_alloc();
+
+	if(argc > 4 && reloc_direct()) {
+
+		file = mount;
+
+		if(!nfs_path_lookup(sock, &mount, &file, argv[4])) {
+			heap_reset();
+			goto umount;
+		}
+
+		mode = NET_READ_LONG(&file.mode);
+		if(!S_ISREG(mode)) {
+			puts("not a file");
+			heap_reset();
+			goto umount;
+		}
+
+		size = NET_READ_LONG(&file.size);
+		space = size;
+
+		base = reloc_direct_addr(&space);
+		if(!base) {
+			heap_reset();
+			goto umount;
+		}
+
+		digest_begin(4);
+
+		if(!nfs_read_file(sock, &file, base, size) || !digest_end(4)) {
+			heap_reset();
+			goto umount;
+		}
+
+		if(!reloc_direct_done(base, size)) {
+			heap_reset();
+			goto umount;
+		}
+	}
+
 	heap_initrd_vars();
 	heap_info();
 
 	error = E_NONE;
 
 umount:
-	udp_connect(sock, server, port_mnt);
+	digest_abort();
 
-	if(nfs_umount(sock, argv[2]) || nfs_umount_all(sock))
-		DPRINTF("nfs: unmounted \"%s\"\n", argv[2]);
-
-	udp_close(sock);
+	nfs_close(sock, server, port_mnt, argv[2]);
 
 	return error;
 }
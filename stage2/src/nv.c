@@ -12,6 +12,17 @@
 
 #define MENU_TIMEOUT				(10 * 1000)
 
+/*
+ * RTC RAM layout, as far as the Cobalt firmware and Linux use it
+ *
+ *	0x00 - 0x0d		clock registers
+ *	0x0e - 0x12		CMOS version, flags and drive info
+ *	0x20 - 0x26		CoLo settings (was the Cobalt boot method and device)
+ *	0x27 - 0x3f		unused
+ *	0x40 - 0x4f		system serial number and checksum
+ *	0x50 - 0x63		ROM revision, BTO code and address, uptime, boot count
+ */
+
 #define RTC_ADDR_STORE			0x20
 
 struct nv_store nv_store;
@@ -43,17 +54,17 @@ unsigned rtc_read(unsigned addr)
 }
 
 /*
- * check/write CRC for block
+ * check/write CRC for block (first byte is the CRC)
  */
-static unsigned nv_crc(struct nv_store *store)
+static unsigned nv_crc(const void *store, unsigned size)
 {
 	unsigned crc, indx, loop, data;
 
 	crc = 0;
 
-	for(indx = 1; indx < store->size; ++indx) {
+	for(indx = 1; indx < size; ++indx) {
 
-		data = ((uint8_t *) store)[indx];
+		data = ((const uint8_t *) store)[indx];
 
 		for(loop = 8; loop--; data >>= 1) {
 
@@ -83,7 +94,7 @@ void nv_get(int clear)
 		for(indx = 0; indx < sizeof(nv_store); ++indx)
 			((uint8_t *) &nv_store)[indx] = rtc_read(RTC_ADDR_STORE + indx);
 
-		if(nv_store.size < 3 || nv_store.size > sizeof(nv_store) || nv_store.crc != nv_crc(&nv_store))
+		if(nv_store.size < 3 || nv_store.size > sizeof(nv_store) || nv_store.crc != nv_crc(&nv_store, nv_store.size))
 			memset(&nv_store, 0, sizeof(nv_store));
 
 		if(nv_store.vers == NV_STORE_VERSION)
@@ -109,7 +120,7 @@ void nv_put(void)
 
 	nv_store.vers = NV_STORE_VERSION;
 	nv_store.size = sizeof(nv_store);
-	nv_store.crc = nv_crc(&nv_store);
+	nv_store.crc = nv_crc(&nv_store, nv_store.size);
 
 	for(indx = 0; indx < sizeof(nv_store); ++indx)
 		rtc_write(RTC_ADDR_STORE + indx, ((uint8_t *) &nv_store)[indx]);
@@ -0,0 +1,224 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ *
+ * Raw boot partitions hold a header, the kernel and an optional initrd laid
+ * out one after the other (see rawboot.h and tools/rawboot-tool). There's no
+ * file system to walk so each image is read with a single request straight
+ * to where 'load' would have put it.
+ */
+
+#include "lib.h"
+#include "md5.h"
+#include "rawboot.h"
+
+static union
+{
+	struct rawboot_header	hdr;
+	uint8_t						sector[RAWBOOT_SECTOR];
+
+} buf;
+
+static unsigned get_le32(const void *ptr)
+{
+	const uint8_t *p = ptr;
+
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+/*
+ * read and check the header
+ */
+static int rawboot_header(void *dev, unsigned *offset, unsigned *size, const uint8_t **sum)
+{
+	struct MD5Context ctx;
+	unsigned long limit, count;
+	uint8_t dig[16];
+	unsigned indx;
+
+	if(ide_read_sectors(dev, &buf, 0, 1))
+		return 0;
+
+	if(memcmp(buf.hdr.magic, RAWBOOT_MAGIC, RAWBOOT_MAGIC_SZ)) {
+		puts("no raw boot image");
+		return 0;
+	}
+
+	MD5Init(&ctx);
+	MD5Update(&ctx, buf.sector, (uint8_t *) buf.hdr.hdr_md5 - buf.sector);
+	MD5Final(dig, &ctx);
+
+	if(memcmp(dig, buf.hdr.hdr_md5, sizeof(dig))) {
+		puts("raw boot header corrupt");
+		return 0;
+	}
+
+	if(get_le32(&buf.hdr.version) != RAWBOOT_VERSION) {
+		puts("unsupported raw boot image version");
+		return 0;
+	}
+
+	offset[0] = get_le32(&buf.hdr.kernel_offset);
+	size[0] = get_le32(&buf.hdr.kernel_size);
+	sum[0] = buf.hdr.kernel_md5;
+
+	offset[1] = get_le32(&buf.hdr.initrd_offset);
+	size[1] = get_le32(&buf.hdr.initrd_size);
+	sum[1] = buf.hdr.initrd_md5;
+
+	if(!size[0] || !offset[0] || (size[1] && !offset[1])) {
+		puts("raw boot header corrupt");
+		return 0;
+	}
+
+	/* reads are only bounded by the end of the disk, keep to the partition */
+
+	limit = ide_size(dev);
+
+	for(indx = 0; indx < 2; ++indx) {
+
+		if(!size[indx])
+			continue;
+
+		count = size[indx] / RAWBOOT_SECTOR + !!(size[indx] % RAWBOOT_SECTOR);
+
+		if(offset[indx] > limit || count > limit - offset[indx]) {
+			puts("raw boot image runs past end of partition");
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * read one image, whole sectors straight to memory and the tail via the
+ * sector buffer, then check its digest
+ */
+static int rawboot_read(void *dev, void *where, unsigned offset, unsigned size, const uint8_t *sum)
+{
+	static uint8_t tail[RAWBOOT_SECTOR];
+
+	struct MD5Context ctx;
+	unsigned count, part;
+	uint8_t dig[16];
+
+	count = size / RAWBOOT_SECTOR;
+	part = size % RAWBOOT_SECTOR;
+
+	if(count && ide_read_sectors(dev, where, offset, count))
+		return 0;
+
+	if(part) {
+
+		if(ide_read_sectors(dev, tail, offset + count, 1))
+			return 0;
+
+		memcpy(where + count * RAWBOOT_SECTOR, tail, part);
+	}
+
+	MD5Init(&ctx);
+	MD5Update(&ctx, where, size);
+	MD5Final(dig, &ctx);
+
+	if(memcmp(dig, sum, sizeof(dig))) {
+		puts("checksum mismatch");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * load kernel and initrd from raw boot partition
+ */
+int cmnd_rawboot(int opsz)
+{
+	unsigned offset[2], size[2];
+	const uint8_t *sum[2];
+	void *dev, *base;
+	size_t space;
+
+	if(argc > 2)
+		return E_ARGS_OVER;
+
+	volume_release();
+
+	dev = ide_open_raw(argc > 1 ? argv[1] : NULL);
+	if(!dev)
+		return E_UNSPEC;
+
+	if(ide_block_size(dev) != RAWBOOT_SECTOR) {
+		puts("raw boot needs a hard disk");
+		return E_UNSPEC;
+	}
+
+	if(!rawboot_header(dev, offset, size, sum))
+		return E_UNSPEC;
+
+	printf("%s: kernel %uKB", ide_dev_name(dev), (size[0] + 512) / 1024);
+	if(size[1])
+		printf(", initrd %uKB", (size[1] + 512) / 1024);
+	putchar('\n');
+
+	heap_reset();
+
+	if(size[1] && !reloc_direct()) {
+
+		base = heap_reserve_hi(size[1]);
+		if(!base) {
+			puts("initrd too big");
+			heap_reset();
+			return E_UNSPEC;
+		}
+
+		if(!rawboot_read(dev, base, offset[1], size[1], sum[1])) {
+			heap_reset();
+			return E_UNSPEC;
+		}
+
+		heap_alloc();
+		heap_mark();
+	}
+
+	base = heap_reserve_hi(size[0]);
+	if(!base) {
+		puts("kernel too big");
+		heap_reset();
+		return E_UNSPEC;
+	}
+
+	if(!rawboot_read(dev, base, offset[0], size[0], sum[0])) {
+		heap_reset();
+		return E_UNSPEC;
+	}
+
+	heap_alloc();
+
+	if(size[1] && reloc_direct()) {
+
+		space = size[1];
+
+		base = reloc_direct_addr(&space);
+		if(!base || !rawboot_read(dev, base, offset[1], size[1], sum[1])) {
+			heap_reset();
+			return E_UNSPEC;
+		}
+
+		if(!reloc_direct_done(base, size[1])) {
+			heap_reset();
+			return E_UNSPEC;
+		}
+	}
+
+	heap_initrd_vars();
+
+	heap_info();
+
+	return E_NONE;
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
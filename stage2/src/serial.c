@@ -26,6 +26,8 @@
 
 #define PCI_BASE_ADDR				0x10108000
 
+#define UART_FIFO_SIZE				16
+
 #define _UART_THR(p)					((p)->base[0])
 #define _UART_RHR(p)					((p)->base[0])
 #define _UART_BRL(p)					((p)->base[0])
@@ -86,8 +88,10 @@ static const unsigned rates[] =
 	230400,
 };
 
-static unsigned queue_in, queue_out;
-static char out_queue[2048];
+static unsigned queue_in, queue_out, queue_net;
+static unsigned queue_dropped;
+static int queue_nowait;
+static char out_queue[16 << 10];
 static unsigned baud;
 static enum { ST_UNINIT = 0, ST_DISABLED, ST_ENABLED } state;
 static struct uart_info uart_ports[4];
@@ -191,17 +195,23 @@ static unsigned stored_baud(void)
 	return rates[nv_store.baud - 1];
 }
 
-static unsigned flush_netcon(void)
+/*
+ * hand netcon what it will take, it has its own read position
+ */
+static void flush_netcon(void)
 {
-	unsigned indx, copy, fill;
+	unsigned indx, fill;
 
-	for(copy = queue_out;;) {
+	if(!netcon_enabled()) {
+		queue_net = queue_in;
+		return;
+	}
 
-		fill = queue_in - copy;
-		if(!fill)
-			break;
+	while(queue_net != queue_in) {
 
-		indx = copy % sizeof(out_queue);
+		fill = queue_in - queue_net;
+
+		indx = queue_net % sizeof(out_queue);
 		if(indx + fill > sizeof(out_queue))
 			fill = sizeof(out_queue) - indx;
 
@@ -209,31 +219,38 @@ static unsigned flush_netcon(void)
 		if(!fill)
 			break;
 
-		copy += fill;
+		queue_net += fill;
 	}
-
-	return copy - queue_out;
 }
 
+/*
+ * top up the UART FIFO without waiting, whatever doesn't fit stays queued
+ * until the next poll
+ */
 static void flush_ring(void)
 {
-	unsigned copy;
+	unsigned count;
 
-	copy = flush_netcon();
+	flush_netcon();
 
-	if(state == ST_ENABLED)
+	if(state == ST_ENABLED) {
 
-		while(queue_in != queue_out) {
+		if(queue_out != queue_in && (UART_LSR & UART_LSR_THRE))
+			for(count = 0; count < UART_FIFO_SIZE && queue_out != queue_in; ++count)
+				UART_THR = out_queue[queue_out++ % sizeof(out_queue)];
 
-			while(!(UART_LSR & UART_LSR_THRE))
-				;
+	} else
 
-			UART_THR = out_queue[queue_out++ % sizeof(out_queue)];
-		}
-
-	else
+		queue_out = queue_net;
+}
 
-		queue_out += copy;
+/*
+ * background task, see task.c
+ */
+void serial_poll(void)
+{
+	if(queue_out != queue_in || queue_net != queue_in)
+		flush_ring();
 }
 
 void serial_scan(void)
@@ -249,10 +266,34 @@ void serial_scan(void)
 	}
 }
 
+/*
+ * program the divisor, 0 if the port can't get within 2% of the rate
+ */
+static int set_baud(unsigned rate)
+{
+	unsigned div, real;
+
+	div = (uart_port->clock + rate * 8) / (rate * 16);
+	if(!div || div > 0xffff)
+		return 0;
+
+	real = uart_port->clock / (div * 16);
+	if((real > rate ? real - rate : rate - real) > rate / 50)
+		return 0;
+
+	UART_LCR = UART_LCR_DL_EN | UART_LCR_STOP2 | UART_LCR_DATA8;
+	UART_BRL = div;
+	UART_BRH = div >> 8;
+	UART_LCR = UART_LCR_STOP2 | UART_LCR_DATA8;
+
+	baud = rate;
+
+	return 1;
+}
+
 void serial_enable(int enable)
 {
 	static char buf[16];
-	unsigned div;
 
 	if(!enable) {
 
@@ -271,14 +312,9 @@ void serial_enable(int enable)
 
 		uart_port = &uart_ports[0];
 
-		baud = stored_baud();
-		div = (uart_port->clock + baud * 8) / (baud * 16);
-
 		UART_MCR = UART_MCR_OP1 | UART_MCR_RTS | UART_MCR_DTR;
-		UART_LCR = UART_LCR_DL_EN | UART_LCR_STOP2 | UART_LCR_DATA8;
-		UART_BRL = div;
-		UART_BRH = div >> 8;
-		UART_LCR = UART_LCR_STOP2 | UART_LCR_DATA8;
+		if(!set_baud(stored_baud()))
+			set_baud(BAUD_RATE);
 		UART_FCR = UART_FCR_FIFO_EN;
 	}
 
@@ -292,9 +328,79 @@ void serial_enable(int enable)
 
 void drain(void)
 {
-	if(state == ST_ENABLED)
+	if(state == ST_ENABLED) {
+
+		while(queue_out != queue_in)
+			yield();
+
 		while(~UART_LSR & (UART_LSR_THRE | UART_LSR_TEMPTY))
 			yield();
+	}
+}
+
+/*
+ * change the port speed (must be in the table), returns the old speed or 0
+ *
+ * a rate of 0 just returns the current speed
+ */
+unsigned serial_speed(unsigned rate)
+{
+	unsigned indx, prev;
+
+	if(state != ST_ENABLED)
+		return 0;
+
+	if(!rate)
+		return baud;
+
+	for(indx = 0; indx < elements(rates) && rates[indx] != rate; ++indx)
+		;
+
+	if(indx == elements(rates))
+		return 0;
+
+	prev = baud;
+
+	drain();
+
+	if(!set_baud(rate))
+		return 0;
+
+	return prev;
+}
+
+/*
+ * raw byte receive for binary transfers, -1 on timeout (CP0 count ticks)
+ *
+ * this reads the UART directly, kbhit() polls too slowly to keep up with
+ * the FIFO at high rates
+ */
+int serial_getc(unsigned timeout)
+{
+	unsigned mark;
+
+	if(state != ST_ENABLED)
+		return -1;
+
+	for(mark = MFC0(CP0_COUNT); !(UART_LSR & UART_LSR_RDR);)
+		if(MFC0(CP0_COUNT) - mark >= timeout)
+			return -1;
+
+	return UART_RHR;
+}
+
+/*
+ * raw byte transmit, bypasses the console queue and netcon
+ */
+void serial_putc(int chr)
+{
+	if(state == ST_ENABLED) {
+
+		while(!(UART_LSR & UART_LSR_THRE))
+			;
+
+		UART_THR = chr;
+	}
 }
 
 /*
@@ -325,6 +431,8 @@ int kbhit(void)
 	if(netcon_poll())
 		return 1;
 
+	lcd_poll();
+
 	yield();
 
 	return 0;
@@ -346,13 +454,52 @@ int getch(void)
 	return 0;
 }
 
+/*
+ * output that doesn't fit the queue is dropped on the transfer paths, anywhere
+ * else we wait for room
+ */
+void serial_nowait(int nowait)
+{
+	queue_nowait = nowait;
+}
+
+/*
+ * wait for room in the queue, 0 if the character is to be dropped
+ */
+static int queue_room(void)
+{
+	unsigned net;
+
+	while(queue_in - queue_out >= sizeof(out_queue) || queue_in - queue_net >= sizeof(out_queue)) {
+
+		if(queue_nowait)
+			return 0;
+
+		net = queue_net;
+
+		flush_ring();
+		yield();
+
+		/* netcon can't take any more, lose its oldest rather than hang */
+
+		if(queue_net == net && queue_in - queue_net >= sizeof(out_queue)) {
+			++queue_dropped;
+			++queue_net;
+		}
+	}
+
+	return 1;
+}
+
 void putchar(int chr)
 {
 	if(chr == '\n')
 		putchar('\r');
 
-	if(queue_in - queue_out >= sizeof(out_queue))
-		++queue_out;
+	if(!queue_room()) {
+		++queue_dropped;
+		return;
+	}
 
 	out_queue[queue_in++ % sizeof(out_queue)] = chr;
 
@@ -387,6 +534,13 @@ int cmnd_serial(int opsz)
 
 	size = strlen(argv[1]);
 
+	if(!strncasecmp(argv[1], "stats", size)) {
+
+		printf("%u bytes queued, %u bytes dropped\n", queue_in - queue_out, queue_dropped);
+
+		return E_NONE;
+	}
+
 	if(!strncasecmp(argv[1], "default", size)) {
 
 		puts(_STR(BAUD_RATE));
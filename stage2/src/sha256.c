@@ -0,0 +1,181 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ *
+ * SHA-256 as described in FIPS 180-2
+ */
+
+#include "lib.h"
+#include "sha256.h"
+
+#define ROR(x,n)				((x) >> (n) | (x) << (32 - (n)))
+
+#define CH(x,y,z)				((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x,y,z)			(((x) & (y)) | ((z) & ((x) | (y))))
+#define S0(x)					(ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define S1(x)					(ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define G0(x)					(ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define G1(x)					(ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+
+#define LOAD_BE(p)			((UWORD32) (p)[0] << 24 | (UWORD32) (p)[1] << 16 | (UWORD32) (p)[2] << 8 | (p)[3])
+
+static const UWORD32 k[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/*
+ * one round, with the working variables rotated by renaming rather than copying
+ */
+#define ROUND(a,b,c,d,e,f,g,h,i)	do{\
+												t = h + S1(e) + CH(e, f, g) + k[i] + w[(i) & 15];\
+												d += t;\
+												h = t + S0(a) + MAJ(a, b, c);\
+											}while(0)
+
+#define EXPAND(i)						(w[(i) & 15] += G1(w[((i) - 2) & 15]) + w[((i) - 7) & 15] + G0(w[((i) - 15) & 15]))
+
+/*
+ * process one 64 byte block
+ */
+static void SHA256Transform(UWORD32 state[8], const uint8_t *block)
+{
+	UWORD32 a, b, c, d, e, f, g, h, t, w[16];
+	unsigned i;
+
+	for(i = 0; i < 16; ++i)
+		w[i] = LOAD_BE(block + i * 4);
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+
+	for(i = 0; i < 64; i += 8) {
+
+		if(i >= 16) {
+			EXPAND(i + 0);
+			EXPAND(i + 1);
+			EXPAND(i + 2);
+			EXPAND(i + 3);
+			EXPAND(i + 4);
+			EXPAND(i + 5);
+			EXPAND(i + 6);
+			EXPAND(i + 7);
+		}
+
+		ROUND(a, b, c, d, e, f, g, h, i + 0);
+		ROUND(h, a, b, c, d, e, f, g, i + 1);
+		ROUND(g, h, a, b, c, d, e, f, i + 2);
+		ROUND(f, g, h, a, b, c, d, e, i + 3);
+		ROUND(e, f, g, h, a, b, c, d, i + 4);
+		ROUND(d, e, f, g, h, a, b, c, i + 5);
+		ROUND(c, d, e, f, g, h, a, b, i + 6);
+		ROUND(b, c, d, e, f, g, h, a, i + 7);
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+void SHA256Init(struct SHA256Context *ctx)
+{
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+
+	ctx->bytes[0] = 0;
+	ctx->bytes[1] = 0;
+}
+
+void SHA256Update(struct SHA256Context *ctx, const uint8_t *buf, unsigned len)
+{
+	unsigned used, t;
+
+	used = ctx->bytes[0] & 63;
+
+	t = ctx->bytes[0];
+	if((ctx->bytes[0] = t + len) < t)
+		ctx->bytes[1]++;
+
+	/* top up partial block */
+
+	if(used) {
+
+		t = 64 - used;
+		if(t > len) {
+			memcpy(ctx->in + used, buf, len);
+			return;
+		}
+
+		memcpy(ctx->in + used, buf, t);
+		SHA256Transform(ctx->state, ctx->in);
+		buf += t;
+		len -= t;
+	}
+
+	/* whole blocks straight from the caller's buffer */
+
+	for(; len >= 64; buf += 64, len -= 64)
+		SHA256Transform(ctx->state, buf);
+
+	memcpy(ctx->in, buf, len);
+}
+
+void SHA256Final(uint8_t digest[32], struct SHA256Context *ctx)
+{
+	UWORD32 hi, lo;
+	unsigned used, i;
+
+	hi = ctx->bytes[1] << 3 | ctx->bytes[0] >> 29;
+	lo = ctx->bytes[0] << 3;
+
+	used = ctx->bytes[0] & 63;
+
+	ctx->in[used++] = 0x80;
+
+	if(used > 56) {
+		memset(ctx->in + used, 0, 64 - used);
+		SHA256Transform(ctx->state, ctx->in);
+		used = 0;
+	}
+
+	memset(ctx->in + used, 0, 56 - used);
+
+	for(i = 0; i < 4; ++i) {
+		ctx->in[56 + i] = hi >> (24 - i * 8);
+		ctx->in[60 + i] = lo >> (24 - i * 8);
+	}
+
+	SHA256Transform(ctx->state, ctx->in);
+
+	for(i = 0; i < 32; ++i)
+		digest[i] = ctx->state[i / 4] >> (24 - (i & 3) * 8);
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
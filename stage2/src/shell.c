@@ -16,6 +16,9 @@
 extern int cmnd_execute(int);
 extern int cmnd_mount(int);
 extern int cmnd_ls(int);
+extern int cmnd_plan(int);
+extern int cmnd_rawboot(int);
+extern int cmnd_raid(int);
 extern int cmnd_cd(int);
 extern int cmnd_load(int);
 extern int cmnd_read(int);
@@ -23,11 +26,14 @@ extern int cmnd_write(int);
 extern int cmnd_dump(int);
 extern int cmnd_history(int);
 extern int cmnd_md5sum(int);
+extern int cmnd_sha256sum(int);
 extern int cmnd_srec(int);
+extern int cmnd_xmodem(int);
 extern int cmnd_keymap(int);
 extern int cmnd_keyshow(int);
 extern int cmnd_flash(int);
 extern int cmnd_heap(int);
+extern int cmnd_image(int);
 extern int cmnd_unzip(int);
 extern int cmnd_net(int);
 extern int cmnd_tftp(int);
@@ -36,7 +42,9 @@ extern int cmnd_pci(int);
 extern int cmnd_lcd(int);
 extern int cmnd_environ(int);
 extern int cmnd_boot(int);
+extern int cmnd_race(int);
 extern int cmnd_nfs(int);
+extern int cmnd_diskimage(int);
 extern int cmnd_serial(int);
 extern int cmnd_restrict(int);
 extern int cmnd_menu(int);
@@ -46,6 +54,7 @@ extern int cmnd_onerror(int);
 extern int cmnd_exit(int);
 extern int cmnd_abort(int);
 extern int cmnd_netcon(int);
+extern int cmnd_tasks(int);
 extern int cmnd_reloc(int);
 
 static int cmnd_arguments(int);
@@ -75,13 +84,16 @@ static struct
 	{ "history",		cmnd_history,		0,					NULL,															},
 	{ "evaluate",		cmnd_eval,			0,					"expression ...",											},
 	{ "md5sum",			cmnd_md5sum,		0,					"[address size]",											},
+	{ "sha256sum",		cmnd_sha256sum,	0,					"[address size]",											},
 	{ "keymap",			cmnd_keymap,		0,					"[keymap]",													},
 	{ "?",				cmnd_help,			FLAG_NO_HELP,	NULL,															},
 	{ "help",			cmnd_help,			0,					NULL,															},
 	{ "download",		cmnd_srec,			0,					"[base-address]",											},
+	{ "xmodem",			cmnd_xmodem,		0,					"[speed]",													},
 	{ "flash",			cmnd_flash,			0,					"[address size] target",								},
 	{ "reboot",			cmnd_reboot,		0,					NULL,															},
-	{ "image",			cmnd_heap,			0,					NULL,															},
+	{ "image",			cmnd_image,			0,					NULL,															},
+	{ "heap",			cmnd_heap,			0,					"[{keep | free} name]",									},
 	{ "showkey",		cmnd_keyshow,		0,					NULL,															},
 	{ "unzip",			cmnd_unzip,			0,					NULL,															},
 	{ "nvflags",		cmnd_nvflags,		0,					"[number ...]",											},
@@ -90,6 +102,9 @@ static struct
 	{ "ls",				cmnd_ls,				0,					"[path ...]",												},
 	{ "cd",				cmnd_cd,				0,					"[path]",													},
 	{ "load",			cmnd_load,			0,					"path [path]",												},
+	{ "plan",			cmnd_plan,			0,					"[clear]",													},
+	{ "rawboot",		cmnd_rawboot,		0,					"[partition]",												},
+	{ "raid",			cmnd_raid,			0,					NULL,															},
 	{ "script",			cmnd_script,		0,					"[show]",													},
 	{ "net",				cmnd_net,			0,					"[{address netmask [gateway]} | down]",			},
 	{ "tftp",			cmnd_tftp,			0,					"host path [path]",										},
@@ -98,8 +113,10 @@ static struct
 	{ "lcd",				cmnd_lcd,			0,					"[text [text]]",											},
 	{ "variable",		cmnd_environ,		0,					"[name [value]]",											},
 	{ "boot",			cmnd_boot,			0,					"[list | default] [option]",							},
+	{ "race",			cmnd_race,			0,					NULL,															},
 	{ "nfs",				cmnd_nfs,			0,					"host root [path [path]]",								},
-	{ "serial",			cmnd_serial,		0,					"[rate | default | on | off ]",						},
+	{ "diskimage",		cmnd_diskimage,	0,					"{tftp host | nfs host root} path [device]",		},
+	{ "serial",			cmnd_serial,		0,					"[rate | default | on | off | stats]",				},
 	{ "restrict",		cmnd_restrict,		0,					"[megabytes]",												},
 	{ "goto",			cmnd_goto,			0,					"offset",													},
 	{ "onfail",			cmnd_onerror,		0,					"offset",													},
@@ -108,7 +125,8 @@ static struct
 	{ "select",			cmnd_menu,			0,					"title timeout option ...",							},
 	{ "noop",			cmnd_noop,			0,					"[arguments ...]",										},
 	{ "sleep",			cmnd_sleep,			0,					"sleep period",											},
-	{ "netcon",			cmnd_netcon,		0,					"[host [port [port]]]",									},
+	{ "netcon",			cmnd_netcon,		0,					"[stats | host [port [port]]]",						},
+	{ "tasks",			cmnd_tasks,			0,					NULL,															},
 	{ "relocate",		cmnd_reloc,			0,					NULL,															},
 
 #ifdef _DEBUG
@@ -187,7 +205,7 @@ static int cmnd_nvflags(int opsz)
 		"IDE slave enabled",			/* 3 */
 		"Console disabled",			/* 4 */
 		"Horizontal menus",			/* 5 */
-		NULL,								/* 6 */
+		"IDE secondary enabled",	/* 6 */
 		"Probe for PCI serial",		/* 7 */
 	};
 	unsigned indx, mask;
@@ -153,7 +153,8 @@ long load_srec(void *block, size_t max, long base)
  */
 int cmnd_srec(int opsz)
 {
-	unsigned long addr, mark;
+	unsigned long addr;
+	struct timer limit;
 	size_t size;
 	void *base;
 	char *ptr;
@@ -187,7 +188,7 @@ int cmnd_srec(int opsz)
 
 	for(;;) {
 
-		for(mark = MFC0(CP0_COUNT); !kbhit() && MFC0(CP0_COUNT) - mark < CP0_COUNT_RATE;)
+		for(timer_set(&limit, 1000); !kbhit() && !timer_expired(&limit);)
 			;
 
 		if(!kbhit())
@@ -0,0 +1,192 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ *
+ * A stream is a ring buffer filled by a network source in the background
+ * and emptied by a command, so the next data is arriving whilst the last is
+ * being written out. The source's pump is a background task, it mustn't
+ * wait for anything, it takes what has arrived, puts what there's room for
+ * and returns.
+ */
+
+#include "lib.h"
+
+#define STREAM_IDLE					0
+#define STREAM_RUNNING				1
+#define STREAM_DONE					2
+#define STREAM_FAILED				3
+
+static struct
+{
+	uint8_t		*base;
+	unsigned		mask;
+	unsigned		head;				/* bytes put, free running */
+	unsigned		tail;				/* bytes taken, free running */
+	unsigned		state;
+	void			(*pump)(void);
+	void			(*close)(void);
+
+} stream;
+
+/*
+ * set up the ring, 'size' must be a power of two
+ */
+void stream_open(void *base, unsigned size)
+{
+	assert(size && !(size & (size - 1)));
+
+	stream.base = base;
+	stream.mask = size - 1;
+	stream.head = 0;
+	stream.tail = 0;
+	stream.state = STREAM_IDLE;
+	stream.pump = NULL;
+	stream.close = NULL;
+}
+
+/*
+ * attach the source, its pump starts running straight away
+ */
+void stream_source(void (*pump)(void), void (*close)(void))
+{
+	stream.pump = pump;
+	stream.close = close;
+	stream.state = STREAM_RUNNING;
+}
+
+/*
+ * space for the source to put data
+ */
+unsigned stream_room(void)
+{
+	return stream.mask + 1 - (stream.head - stream.tail);
+}
+
+/*
+ * add data from the source, no more than stream_room()
+ */
+void stream_put(const void *data, unsigned size)
+{
+	unsigned indx, copy;
+
+	assert(size <= stream_room());
+
+	digest_update(data, size);
+
+	indx = stream.head & stream.mask;
+	stream.head += size;
+
+	copy = stream.mask + 1 - indx;
+	if(copy > size)
+		copy = size;
+
+	memcpy(stream.base + indx, data, copy);
+	memcpy(stream.base, data + copy, size - copy);
+}
+
+/*
+ * source has finished, or failed
+ */
+void stream_end(int done)
+{
+	stream.state = done ? STREAM_DONE : STREAM_FAILED;
+}
+
+/*
+ * wait for 'size' bytes or the end of the stream, 0 if stopped by BREAK
+ */
+static int stream_wait(unsigned size)
+{
+	while(stream.head - stream.tail < size && stream.state == STREAM_RUNNING) {
+
+		if(BREAK()) {
+			puts("aborted");
+			stream.state = STREAM_FAILED;
+			return 0;
+		}
+
+		yield();
+	}
+
+	return 1;
+}
+
+static unsigned stream_copy(void *data, unsigned size)
+{
+	unsigned indx, copy;
+
+	if(size > stream.head - stream.tail)
+		size = stream.head - stream.tail;
+
+	indx = stream.tail & stream.mask;
+
+	copy = stream.mask + 1 - indx;
+	if(copy > size)
+		copy = size;
+
+	memcpy(data, stream.base + indx, copy);
+	memcpy(data + copy, stream.base, size - copy);
+
+	return size;
+}
+
+/*
+ * take up to 'size' bytes, waiting for some to arrive. 0 at the end of the
+ * stream, -1 if the source failed
+ */
+int stream_read(void *data, unsigned size)
+{
+	if(!stream_wait(1))
+		return -1;
+
+	if(stream.head == stream.tail)
+		return stream.state == STREAM_DONE ? 0 : -1;
+
+	size = stream_copy(data, size);
+	stream.tail += size;
+
+	return size;
+}
+
+/*
+ * look at the first 'size' bytes without taking them, returns how many
+ * there are, fewer if the stream is shorter, -1 if the source failed
+ */
+int stream_peek(void *data, unsigned size)
+{
+	if(!stream_wait(size) || stream.state == STREAM_FAILED)
+		return -1;
+
+	return stream_copy(data, size);
+}
+
+/*
+ * run the source, background task
+ */
+void stream_poll(void)
+{
+	if(stream.state == STREAM_RUNNING)
+		stream.pump();
+}
+
+/*
+ * stop the source and let it tidy up
+ */
+void stream_close(void)
+{
+	void (*close)(void);
+
+	close = stream.close;
+
+	stream.state = STREAM_IDLE;
+	stream.pump = NULL;
+	stream.close = NULL;
+
+	if(close)
+		close();
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
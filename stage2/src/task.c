@@ -0,0 +1,126 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ *
+ * Background tasks are poll functions that do a little work and return.
+ * They're run in turn from yield(), which the long running loops (disk,
+ * inflate, big copies, Flash) call so that the network and console keep
+ * going whilst something is loading.
+ */
+
+#include "lib.h"
+#include "cpu.h"
+
+struct task
+{
+	const char	*name;
+	void			(*poll)(void);
+	unsigned		period;			/* ms between runs, 0 for every yield */
+	unsigned		mark;
+	unsigned		runs;
+	unsigned		ticks;			/* CPU time used, CP0 count under a second */
+	unsigned		secs;
+};
+
+static void task_net(void);
+static void task_netcon(void);
+static void task_dhcp(void);
+
+static struct task tasks[] =
+{
+	{ "timers",		timer_run,		0, },
+	{ "network",	task_net,		0, },
+	{ "netcon",		task_netcon,	0, },
+	{ "dhcp",		task_dhcp,		0, },
+	{ "serial",		serial_poll,	0, },
+	{ "lcd",			lcd_poll,		20, },
+	{ "preload",	preload_poll,	0, },
+	{ "stream",		stream_poll,	0, },
+};
+
+static unsigned yields;
+
+static void task_net(void)
+{
+	extern void tulip_poll(void);
+
+	if(net_is_up())
+		tulip_poll();
+}
+
+static void task_netcon(void)
+{
+	netcon_poll();
+}
+
+static void task_dhcp(void)
+{
+	extern void dhcp_task(void);
+
+	dhcp_task();
+}
+
+/*
+ * run any tasks that are due, tasks themselves can't yield
+ */
+void schedule(void)
+{
+	static int running;
+	struct task *task;
+	unsigned now, used;
+
+	if(running)
+		return;
+
+	running = 1;
+
+	++yields;
+
+	for(task = tasks; task < tasks + elements(tasks); ++task) {
+
+		now = MFC0(CP0_COUNT);
+
+		if(task->period && now - task->mark < task->period * (CP0_COUNT_RATE / 1000))
+			continue;
+
+		task->mark = now;
+
+		task->poll();
+
+		used = MFC0(CP0_COUNT) - now;
+
+		++task->runs;
+
+		task->ticks += used;
+		if(task->ticks >= CP0_COUNT_RATE) {
+			task->ticks -= CP0_COUNT_RATE;
+			++task->secs;
+		}
+	}
+
+	running = 0;
+}
+
+/*
+ * 'tasks' shell command
+ */
+int cmnd_tasks(int opsz)
+{
+	struct task *task;
+
+	if(argc > 1)
+		return E_ARGS_OVER;
+
+	printf("%u yields\n", yields);
+
+	for(task = tasks; task < tasks + elements(tasks); ++task)
+		printf("%-10s %10u runs %5u.%03us\n",
+			task->name, task->runs, task->secs, task->ticks / (CP0_COUNT_RATE / 1000));
+
+	return E_NONE;
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
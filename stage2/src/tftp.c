@@ -22,6 +22,14 @@
 #define OPCODE_ERROR					5
 #define OPCODE_OACK					6
 
+static char tftp_rrq[TFTP_RRQ_SIZE_MAX + 64];
+static unsigned tftp_rrqsz;
+static int tftp_sock;
+static uint32_t tftp_server;
+static unsigned tftp_block;
+static unsigned tftp_retries;
+static struct timer tftp_limit;
+
 /*
  * display error message from TFTP ERROR frame
  */
@@ -46,7 +54,8 @@ static void tftp_error(const void *data, unsigned size)
  */
 static size_t tftp_transfer(int sock, void *mem, size_t max, struct frame *frame)
 {
-	unsigned size, block, mark, diff, update, tick;
+	unsigned size, block, diff;
+	struct timer limit;
 	size_t loaded;
 	void *data;
 
@@ -55,11 +64,6 @@ static size_t tftp_transfer(int sock, void *mem, size_t max, struct frame *frame
 
 	loaded = 0;
 	block = 1;
-	tick = 0;
-
-	putstring(" 0KB\r");
-
-	update = MFC0(CP0_COUNT);
 
 	for(;;) {
 
@@ -76,8 +80,11 @@ static size_t tftp_transfer(int sock, void *mem, size_t max, struct frame *frame
 			}
 
 			memcpy(mem, data, size);
+			digest_update(mem, size);
 			mem += size;
 
+			progress_update(loaded);
+
 			/* have we done ? */
 
 			size = (size < TFTP_BLOCK_SIZE);
@@ -92,23 +99,10 @@ static size_t tftp_transfer(int sock, void *mem, size_t max, struct frame *frame
 
 		udp_send(sock, frame);
 
-		if(size) {
-
-			if(tick)
-				printf("%uKB loaded (%uKB/sec)\n", (loaded + 512) / 1024, (loaded + 128) / (256 * tick));
-			else
-				printf("%uKB loaded\n", (loaded + 512) / 1024);
-
+		if(size)
 			return loaded;
-		}
-
-		mark = MFC0(CP0_COUNT);
 
-		if(mark - update >= CP0_COUNT_RATE / 4) {
-			update = mark;
-			++tick;
-			printf(" %uKB\r", loaded / 1024);
-		}
+		timer_set(&limit, 10 * 1000);
 
 		do {
 
@@ -117,7 +111,7 @@ static size_t tftp_transfer(int sock, void *mem, size_t max, struct frame *frame
 				return -1;
 			}
 
-			if(MFC0(CP0_COUNT) - mark >= CP0_COUNT_RATE * 10) {
+			if(timer_expired(&limit)) {
 				puts("no response");
 				return -1;
 			}
@@ -164,6 +158,41 @@ static size_t tftp_transfer(int sock, void *mem, size_t max, struct frame *frame
 	}
 }
 
+/*
+ * build a read request for 'path', 0 if it's too long
+ */
+static unsigned tftp_request(const char *path)
+{
+	unsigned rrqsz;
+	void *data;
+
+	rrqsz = strlen(path);
+	if(rrqsz <= TFTP_RRQ_SIZE_MAX) {
+		NET_WRITE_SHORT(tftp_rrq, OPCODE_RRQ);
+		data = stpcpy(tftp_rrq + 2, path) + 1;
+		data = stpcpy(data, "octet") + 1;
+		rrqsz = (char *) data - tftp_rrq;
+	}
+	if(rrqsz > TFTP_RRQ_SIZE_MAX) {
+		puts("path too long");
+		return 0;
+	}
+
+	return rrqsz;
+}
+
+static void tftp_send_request(int sock, uint32_t server, unsigned rrqsz)
+{
+	struct frame *frame;
+
+	frame = frame_alloc();
+	if(frame) {
+		FRAME_INIT(frame, HARDWARE_HDRSZ + IP_HDRSZ + UDP_HDRSZ, rrqsz);
+		memcpy(FRAME_PAYLOAD(frame), tftp_rrq, rrqsz);
+		udp_sendto(sock, frame, server, TFTP_PORT_SERVER);
+	}
+}
+
 /*
  * retrieve file via TFTP
  *
@@ -171,25 +200,16 @@ static size_t tftp_transfer(int sock, void *mem, size_t max, struct frame *frame
  */
 size_t tftp_get(uint32_t server, const char *path, void *mem, size_t max)
 {
-	static char rrq[TFTP_RRQ_SIZE_MAX + 64];
-
-	unsigned rrqsz, mark, size, retry;
+	unsigned rrqsz, size, retry;
+	struct timer limit;
 	struct frame *frame;
 	size_t stat;
 	void *data;
 	int sock;
 
-	rrqsz = strlen(path);
-	if(rrqsz <= TFTP_RRQ_SIZE_MAX) {
-		NET_WRITE_SHORT(rrq, OPCODE_RRQ);
-		data = stpcpy(rrq + 2, path) + 1;
-		data = stpcpy(data, "octet") + 1;
-		rrqsz = (char *) data - rrq;
-	}
-	if(rrqsz > TFTP_RRQ_SIZE_MAX) {
-		puts("path too long");
+	rrqsz = tftp_request(path);
+	if(!rrqsz)
 		return -1;
-	}
 
 	sock = udp_socket();
 	if(sock < 0) {
@@ -201,14 +221,9 @@ size_t tftp_get(uint32_t server, const char *path, void *mem, size_t max)
 
 	for(retry = 0; retry < TFTP_SEND_PACKETS_MAX; ++retry) {
 
-		frame = frame_alloc();
-		if(frame) {
-			FRAME_INIT(frame, HARDWARE_HDRSZ + IP_HDRSZ + UDP_HDRSZ, rrqsz);
-			memcpy(FRAME_PAYLOAD(frame), rrq, rrqsz);
-			udp_sendto(sock, frame, server, TFTP_PORT_SERVER);
-		}
+		tftp_send_request(sock, server, rrqsz);
 
-		for(mark = MFC0(CP0_COUNT); MFC0(CP0_COUNT) - mark < CP0_COUNT_RATE * 2;) {
+		for(timer_set(&limit, 2 * 1000); !timer_expired(&limit);) {
 
 			if(BREAK()) {
 				udp_close(sock);
@@ -236,7 +251,9 @@ size_t tftp_get(uint32_t server, const char *path, void *mem, size_t max)
 							case OPCODE_DATA:
 								if(size >= 4 && NET_READ_SHORT(data + 2) == 1) {
 									udp_connect(sock, server, frame->udp_src);
+									progress_start();
 									stat = tftp_transfer(sock, mem, max, frame);
+									progress_stop((long) stat >= 0);
 									udp_close(sock);
 									return stat;
 								}
@@ -254,12 +271,164 @@ size_t tftp_get(uint32_t server, const char *path, void *mem, size_t max)
 	return -1;
 }
 
+/*
+ * stream a file via TFTP, a block at a time as the stream has room for it.
+ * the server waits for each ACK so holding one back is all the flow
+ * control needed
+ */
+static void tftp_pump(void)
+{
+	struct frame *frame;
+	unsigned size, diff;
+	void *data;
+
+	if(!tftp_block) {
+
+		/* keep asking until the first block arrives */
+
+		if(timer_expired(&tftp_limit)) {
+
+			if(++tftp_retries == TFTP_SEND_PACKETS_MAX) {
+				puts("no response");
+				stream_end(0);
+				return;
+			}
+
+			tftp_send_request(tftp_sock, tftp_server, tftp_rrqsz);
+			timer_set(&tftp_limit, 2 * 1000);
+		}
+
+	} else if(stream_room() < TFTP_BLOCK_SIZE) {
+
+		/* the wait is ours, not the server's */
+
+		timer_set(&tftp_limit, 10 * 1000);
+		return;
+
+	} else if(timer_expired(&tftp_limit)) {
+
+		puts("no response");
+		stream_end(0);
+		return;
+	}
+
+	frame = udp_recv(tftp_sock);
+	if(!frame)
+		return;
+
+	data = FRAME_PAYLOAD(frame);
+	size = FRAME_SIZE(frame);
+
+	if(frame->ip_src != tftp_server || size < 2 || size > 4 + TFTP_BLOCK_SIZE) {
+		frame_free(frame);
+		return;
+	}
+
+	switch(NET_READ_SHORT(data + 0)) {
+
+		case OPCODE_ERROR:
+			tftp_error(data, size);
+			frame_free(frame);
+			stream_end(0);
+			return;
+
+		case OPCODE_DATA:
+			if(size < 4)
+				break;
+
+			diff = (NET_READ_SHORT(data + 2) - tftp_block) & 0xffff;
+
+			if(diff == 1) {
+
+				if(!tftp_block)
+					udp_connect(tftp_sock, tftp_server, frame->udp_src);
+
+				++tftp_block;
+
+				stream_put(data + 4, size - 4);
+				if(size - 4 < TFTP_BLOCK_SIZE)
+					stream_end(1);
+
+				timer_set(&tftp_limit, 10 * 1000);
+
+			} else if(diff || !tftp_block)
+				break;
+
+			/* acknowledge new block or repeat ACK for a duplicate */
+
+			FRAME_INIT(frame, HARDWARE_HDRSZ + IP_HDRSZ + UDP_HDRSZ, 4);
+			data = FRAME_PAYLOAD(frame);
+			NET_WRITE_SHORT(data + 0, OPCODE_ACK);
+			NET_WRITE_SHORT(data + 2, tftp_block);
+
+			udp_send(tftp_sock, frame);
+			return;
+	}
+
+	frame_free(frame);
+}
+
+static void tftp_stream_close(void)
+{
+	udp_close(tftp_sock);
+}
+
+/*
+ * start streaming a file via TFTP into the stream
+ */
+int tftp_stream(uint32_t server, const char *path)
+{
+	tftp_rrqsz = tftp_request(path);
+	if(!tftp_rrqsz)
+		return 0;
+
+	tftp_sock = udp_socket();
+	if(tftp_sock < 0) {
+		puts("no socket");
+		return 0;
+	}
+
+	udp_bind(tftp_sock, 0);
+
+	tftp_server = server;
+	tftp_block = 0;
+	tftp_retries = 0;
+
+	tftp_send_request(tftp_sock, tftp_server, tftp_rrqsz);
+	timer_set(&tftp_limit, 2 * 1000);
+
+	stream_source(tftp_pump, tftp_stream_close);
+
+	return 1;
+}
+
+/*
+ * fetch file named by argument, checking any digest given for it
+ */
+static size_t tftp_load(uint32_t server, unsigned arg, void *base, size_t max)
+{
+	size_t size;
+
+	digest_begin(arg);
+
+	size = tftp_get(server, argv[arg], base, max);
+	if((long) size < 0)
+		digest_abort();
+	else if(!digest_end(arg))
+		return -1;
+
+	return size;
+}
+
 int cmnd_tftp(int opsz)
 {
 	uint32_t server;
-	size_t size;
+	size_t size, space;
 	void *base;
 
+	if(!digest_args())
+		return E_BAD_VALUE;
+
 	if(argc < 3)
 		return E_ARGS_UNDER;
 
@@ -276,11 +445,11 @@ int cmnd_tftp(int opsz)
 
 	heap_reset();
 
-	if(argc > 3) {
+	if(argc > 3 && !reloc_direct()) {
 
 		base = heap_reserve_lo(0);
 
-		size = tftp_get(server, argv[3], base, heap_space());
+		size = tftp_load(server, 3, base, heap_space());
 		if((long) size < 0)
 			return E_UNSPEC;
 
@@ -290,9 +459,11 @@ int cmnd_tftp(int opsz)
 		heap_mark();
 	}
 
+	/* size isn't known until it's here, it's moved to the top after */
+
 	base = heap_reserve_lo(0);
 
-	size = tftp_get(server, argv[2], base, heap_space());
+	size = tftp_load(server, 2, base, heap_space());
 	if((long) size < 0) {
 		heap_reset();
 		return E_UNSPEC;
@@ -302,6 +473,28 @@ int cmnd_tftp(int opsz)
 
 	heap_alloc();
 
+	if(argc > 3 && reloc_direct()) {
+
+		space = 0;
+
+		base = reloc_direct_addr(&space);
+		if(!base) {
+			heap_reset();
+			return E_UNSPEC;
+		}
+
+		size = tftp_load(server, 3, base, space);
+		if((long) size < 0) {
+			heap_reset();
+			return E_UNSPEC;
+		}
+
+		if(!reloc_direct_done(base, size)) {
+			heap_reset();
+			return E_UNSPEC;
+		}
+	}
+
 	heap_initrd_vars();
 
 	heap_info();
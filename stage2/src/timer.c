@@ -0,0 +1,157 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ *
+ * Timers count CP0 COUNT ticks from when they were started, so wraparound
+ * needs no special handling as long as a timer is shorter than one trip
+ * round the counter (about 34 seconds at 125MHz).
+ *
+ * A timer can be used on its own as a deadline (timer_set() then
+ * timer_expired()), or started with a callback, one-shot or periodic,
+ * which timer_run() fires from the background tasks. There are only ever
+ * a handful running so they're kept on a list in expiry order.
+ */
+
+#include "lib.h"
+#include "cpu.h"
+
+static struct timer *timers;
+
+static unsigned ms_to_ticks(unsigned ms)
+{
+	return ms * (CP0_COUNT_RATE / 1000);
+}
+
+static unsigned remaining(const struct timer *timer, unsigned now)
+{
+	unsigned used;
+
+	used = now - timer->start;
+
+	return used < timer->length ? timer->length - used : 0;
+}
+
+static void timer_insert(struct timer *timer)
+{
+	struct timer **link;
+	unsigned now, left;
+
+	now = MFC0(CP0_COUNT);
+	left = remaining(timer, now);
+
+	for(link = &timers; *link && remaining(*link, now) <= left; link = &(*link)->next)
+		;
+
+	timer->next = *link;
+	*link = timer;
+}
+
+/*
+ * start a deadline 'ms' from now
+ */
+void timer_set(struct timer *timer, unsigned ms)
+{
+	timer->start = MFC0(CP0_COUNT);
+	timer->length = ms_to_ticks(ms);
+	timer->period = 0;
+	timer->fired = 0;
+	timer->func = NULL;
+}
+
+int timer_expired(const struct timer *timer)
+{
+	return MFC0(CP0_COUNT) - timer->start >= timer->length;
+}
+
+/*
+ * start a timer calling 'func' after 'ms', then every 'period' ms if that's
+ * not 0
+ */
+void timer_start(struct timer *timer, unsigned ms, unsigned period, void (*func)(struct timer *), void *data)
+{
+	timer_stop(timer);
+
+	timer_set(timer, ms);
+
+	timer->period = ms_to_ticks(period);
+	timer->func = func;
+	timer->data = data;
+
+	timer_insert(timer);
+}
+
+void timer_stop(struct timer *timer)
+{
+	struct timer **link;
+
+	for(link = &timers; *link; link = &(*link)->next)
+		if(*link == timer) {
+			*link = timer->next;
+			break;
+		}
+}
+
+/*
+ * fire expired timers, background task
+ */
+void timer_run(void)
+{
+	struct timer *timer;
+	unsigned now;
+
+	while(timers && timer_expired(timers)) {
+
+		timer = timers;
+		timers = timer->next;
+
+		++timer->fired;
+
+		if(timer->period) {
+
+			now = MFC0(CP0_COUNT);
+
+			/* keep to the beat unless we've fallen a whole period behind */
+
+			timer->start += timer->length;
+			timer->length = timer->period;
+			if(now - timer->start >= timer->length)
+				timer->start = now;
+
+			timer_insert(timer);
+		}
+
+		timer->func(timer);
+	}
+}
+
+/*
+ * wait until 'ready' says so (if given) or 'limit' expires (if given),
+ * running the background tasks meanwhile. returns 1 if ready
+ */
+int wait_event(int (*ready)(void *), void *arg, const struct timer *limit)
+{
+	for(;;) {
+
+		if(ready && ready(arg))
+			return 1;
+
+		if(limit && timer_expired(limit))
+			return 0;
+
+		yield();
+	}
+}
+
+void timer_sleep(unsigned ms)
+{
+	struct timer limit;
+
+	timer_set(&limit, ms);
+
+	wait_event(NULL, NULL, &limit);
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
@@ -142,6 +142,8 @@ static unsigned rx_fill;
 static unsigned reg_csr6;
 static int nic_avail;
 static int phy_state;
+static int phy_started;
+static struct timer phy_timer;
 static int chip_id;
 
 /*
@@ -369,9 +371,9 @@ static int transmit_poll(void)
  */
 static void transmit_drain(void)
 {
-	unsigned mark;
+	struct timer limit;
 
-	for(mark = MFC0(CP0_COUNT); transmit_poll() && MFC0(CP0_COUNT) - mark < CP0_COUNT_RATE / 4;)
+	for(timer_set(&limit, 250); transmit_poll() && !timer_expired(&limit);)
 		netcon_poll();
 }
 
@@ -598,8 +600,6 @@ void tulip_init(void)
  */
 static void setup_phy_sia(void)
 {
-	unsigned mark, info;
-
 	assert(chip_id == CHIP_ID_21041);
 
 	if(phy_state == PHY_UNINIT) {
@@ -613,36 +613,29 @@ static void setup_phy_sia(void)
 
 		udelay(10 * 1000);
 	}
+}
 
-	/* wait for link */
-
-	phy_state = PHY_LINK_DOWN;
-
-	for(mark = MFC0(CP0_COUNT);;) {
-
-		info = CSR(12);
-		if((info & (CSR12_ANS_MASK | CSR12_21041_LKF)) == CSR12_ANS_COMPLETE) {
-			phy_state = PHY_LINK_UP;
-			break;
-		}
-
-		if(MFC0(CP0_COUNT) - mark >= LINK_WAIT * CP0_COUNT_RATE)
-			break;
+/*
+ * check SIA PHY link
+ */
+static int link_phy_sia(void)
+{
+	unsigned info;
 
-		udelay(10 * 1000);
-	}
+	info = CSR(12);
+	if((info & (CSR12_ANS_MASK | CSR12_21041_LKF)) != CSR12_ANS_COMPLETE)
+		return 0;
 
 #ifdef _DEBUG
 
-	if(phy_state == PHY_LINK_UP) {
-
-		if((info & (CSR12_LPC_10FDX | CSR12_LPN)) == (CSR12_LPC_10FDX | CSR12_LPN))
-			DPUTS("tulip: link up (10Mbps full-duplex)");
-		else
-			DPUTS("tulip: link up (10Mbps)");
-	}
+	if((info & (CSR12_LPC_10FDX | CSR12_LPN)) == (CSR12_LPC_10FDX | CSR12_LPN))
+		DPUTS("tulip: link up (10Mbps full-duplex)");
+	else
+		DPUTS("tulip: link up (10Mbps)");
 
 #endif
+
+	return 1;
 }
 
 /*
@@ -650,8 +643,6 @@ static void setup_phy_sia(void)
  */
 static void setup_phy_mii(void)
 {
-	unsigned mark, info;
-
 	assert(chip_id == CHIP_ID_21143);
 
 	if(phy_state == PHY_UNINIT) {
@@ -666,37 +657,73 @@ static void setup_phy_mii(void)
 
 		udelay(10 * 1000);
 	}
+}
+
+/*
+ * check MII PHY link
+ */
+static int link_phy_mii(void)
+{
+	unsigned info;
+
+	info = phy_read_mii(PHY_ID, PHY_REG_CSTAT);
+	if(!(info & PHY_REG_CSTAT_LINK))
+		return 0;
+
+#ifdef _DEBUG
+
+	{
+		static const char *link[] = {
+			"10Mbps", "100Mbps", "10Mbps full-duplex", "100Mbps full-duplex",
+		};
+
+		DPRINTF("tulip: link up (%s)\n", link[(info >> 11) & 3]);
+	}
+
+#endif
 
-	/* wait for link */
+	return 1;
+}
+
+/*
+ * start PHY link negotiation but don't wait
+ */
+void tulip_start(void)
+{
+	if(!nic_avail || phy_started)
+		return;
+
+	if(chip_id == CHIP_ID_21041)
+		setup_phy_sia();
+	else
+		setup_phy_mii();
 
 	phy_state = PHY_LINK_DOWN;
+	timer_set(&phy_timer, LINK_WAIT * 1000);
+	phy_started = 1;
+}
 
-	for(mark = MFC0(CP0_COUNT);;) {
+/*
+ * wait for link, allowing LINK_WAIT seconds from when negotiation started
+ */
+static void wait_phy(void)
+{
+	tulip_start();
+
+	for(;;) {
 
-		info = phy_read_mii(PHY_ID, PHY_REG_CSTAT);
-		if(info & PHY_REG_CSTAT_LINK) {
+		if(chip_id == CHIP_ID_21041 ? link_phy_sia() : link_phy_mii()) {
 			phy_state = PHY_LINK_UP;
 			break;
 		}
 
-		if(MFC0(CP0_COUNT) - mark >= LINK_WAIT * CP0_COUNT_RATE)
+		if(timer_expired(&phy_timer))
 			break;
 
 		udelay(10 * 1000);
 	}
 
-#ifdef _DEBUG
-
-	if(phy_state == PHY_LINK_UP) {
-
-		static const char *link[] = {
-			"10Mbps", "100Mbps", "10Mbps full-duplex", "100Mbps full-duplex",
-		};
-
-		DPRINTF("tulip: link up (%s)\n", link[(info >> 11) & 3]);
-	}
-
-#endif
+	phy_started = 0;
 }
 
 /*
@@ -709,10 +736,7 @@ int tulip_up(void)
 	if(!nic_avail)
 		return 0;
 
-	if(chip_id == CHIP_ID_21041)
-		setup_phy_sia();
-	else
-		setup_phy_mii();
+	wait_phy();
 
 	if(phy_state != PHY_LINK_UP) {
 		DPUTS("tulip: link down");
@@ -0,0 +1,364 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ *
+ * XMODEM-CRC / XMODEM-1K / YMODEM (single file) receive
+ */
+
+#include "lib.h"
+#include "cpu.h"
+
+#define SOH							0x01
+#define STX							0x02
+#define EOT							0x04
+#define ACK							0x06
+#define NAK							0x15
+#define CAN							0x18
+#define CRC_REQ					'C'
+
+#define BYTE_TIMEOUT				(CP0_COUNT_RATE)			// 1s
+#define START_TIMEOUT			(CP0_COUNT_RATE * 3)		// 3s
+#define START_RETRIES			20
+#define BLOCK_RETRIES			10
+
+#define BLOCK_MAX					1024
+
+static uint16_t crc_table[256];
+static uint8_t scratch[BLOCK_MAX];
+
+static void crc_init(void)
+{
+	unsigned indx, bit, crc;
+
+	if(crc_table[1])
+		return;
+
+	for(indx = 0; indx < 256; ++indx) {
+
+		crc = indx << 8;
+		for(bit = 0; bit < 8; ++bit)
+			crc = (crc << 1) ^ (crc & 0x8000 ? 0x1021 : 0);
+
+		crc_table[indx] = crc;
+	}
+}
+
+/*
+ * discard input until the line goes quiet
+ */
+static void purge(void)
+{
+	while(serial_getc(CP0_COUNT_RATE / 10) >= 0)
+		;
+}
+
+static void cancel(void)
+{
+	unsigned indx;
+
+	for(indx = 0; indx < 3; ++indx)
+		serial_putc(CAN);
+
+	purge();
+}
+
+/*
+ * read the rest of a block into 'data', 0 if it failed to arrive intact
+ */
+static int get_block(unsigned *blk, void *data, unsigned size)
+{
+	unsigned indx, crc;
+	uint8_t *ptr;
+	int num, inv, chr;
+
+	ptr = data;
+
+	num = serial_getc(BYTE_TIMEOUT);
+	inv = serial_getc(BYTE_TIMEOUT);
+	if(num < 0 || inv < 0 || (num ^ inv) != 0xff)
+		return 0;
+
+	for(crc = 0, indx = 0; indx < size; ++indx) {
+
+		chr = serial_getc(BYTE_TIMEOUT);
+		if(chr < 0)
+			return 0;
+
+		ptr[indx] = chr;
+		crc = (crc << 8) ^ crc_table[((crc >> 8) ^ chr) & 0xff];
+	}
+
+	chr = serial_getc(BYTE_TIMEOUT);
+	if(chr < 0 || chr != ((crc >> 8) & 0xff))
+		return 0;
+	chr = serial_getc(BYTE_TIMEOUT);
+	if(chr < 0 || chr != (crc & 0xff))
+		return 0;
+
+	*blk = num;
+
+	return 1;
+}
+
+/*
+ * receive a file straight into memory, returns size or -1 with 'why' set
+ */
+static long xmodem_receive(void *block, size_t max, const char **why)
+{
+	unsigned expect, blk, size, retry, batch, eots;
+	unsigned long length;
+	int reply, chr;
+	size_t fill;
+	void *data;
+	char *ptr;
+
+	crc_init();
+
+	fill = 0;
+	length = ~0;
+	expect = 1;
+	batch = 0;
+	eots = 0;
+	retry = 0;
+	reply = CRC_REQ;
+
+	for(;;) {
+
+		if(reply)
+			serial_putc(reply);
+
+		chr = serial_getc(reply == CRC_REQ ? START_TIMEOUT : BYTE_TIMEOUT * 10);
+
+		switch(chr) {
+
+			case SOH:
+				size = 128;
+				break;
+
+			case STX:
+				size = BLOCK_MAX;
+				break;
+
+			case EOT:
+
+				/* YMODEM senders expect the first EOT to be refused */
+
+				if(batch && !eots++) {
+					reply = NAK;
+					continue;
+				}
+
+				serial_putc(ACK);
+
+				if(!batch)
+					return fill;
+
+				/* wait for the end of batch header */
+
+				expect = 0;
+				reply = CRC_REQ;
+				continue;
+
+			case CAN:
+				if(serial_getc(BYTE_TIMEOUT) == CAN) {
+					*why = "cancelled by sender";
+					return -1;
+				}
+				reply = 0;
+				continue;
+
+			case '\003':
+				if(reply == CRC_REQ && !fill) {
+					*why = "aborted";
+					cancel();
+					return -1;
+				}
+
+				/* fall through */
+
+			default:
+
+				if(++retry > (reply == CRC_REQ ? START_RETRIES : BLOCK_RETRIES)) {
+					*why = "timed out";
+					cancel();
+					return -1;
+				}
+
+				if(chr >= 0)
+					purge();
+
+				if(reply != CRC_REQ)
+					reply = NAK;
+				continue;
+		}
+
+		/* data blocks go straight to their final place */
+
+		data = scratch;
+		if(expect && fill + size <= max)
+			data = block + fill;
+
+		if(!get_block(&blk, data, size)) {
+
+			if(++retry > BLOCK_RETRIES) {
+				*why = "too many errors";
+				cancel();
+				return -1;
+			}
+
+			purge();
+			reply = NAK;
+			continue;
+		}
+
+		retry = 0;
+
+		/* YMODEM header, "name\0size ..." (repeated if our ACK was lost) */
+
+		if(!blk && expect == 1 && !fill) {
+
+			if(!batch) {
+
+				ptr = data;
+				if(!*ptr) {
+					serial_putc(ACK);
+					*why = "no file sent";
+					return -1;
+				}
+
+				ptr += strlen(ptr) + 1;
+				if(isdigit(*ptr))
+					length = strtoul(ptr, NULL, 10);
+
+				if(~length && length > max) {
+					*why = "file too big";
+					cancel();
+					return -1;
+				}
+
+				batch = 1;
+			}
+
+			serial_putc(ACK);
+			reply = CRC_REQ;
+			continue;
+		}
+
+		/* YMODEM end of batch, an empty header */
+
+		if(!expect) {
+
+			serial_putc(ACK);
+
+			if(scratch[0]) {
+				*why = "only one file can be received";
+				cancel();
+				return -1;
+			}
+
+			return length < fill ? length : fill;
+		}
+
+		/* resent because our ACK was lost */
+
+		if(blk == ((expect - 1) & 0xff)) {
+			reply = ACK;
+			continue;
+		}
+
+		if(blk != (expect & 0xff)) {
+			*why = "block out of sequence";
+			cancel();
+			return -1;
+		}
+
+		/* the last block is padded, only what's left of a known length need fit */
+
+		if(data == scratch) {
+
+			if(!~length || fill >= length || length > max) {
+				*why = "file too big";
+				cancel();
+				return -1;
+			}
+
+			memcpy(block + fill, scratch, length - fill);
+		}
+
+		fill += size;
+		++expect;
+
+		reply = ACK;
+	}
+}
+
+/*
+ * receive an image over the serial port (XMODEM / YMODEM)
+ */
+int cmnd_xmodem(int opsz)
+{
+	unsigned long rate, prev;
+	const char *why;
+	size_t size;
+	void *base;
+	char *ptr;
+
+	if(argc > 2)
+		return E_ARGS_OVER;
+
+	rate = 0;
+	if(argc > 1) {
+		rate = strtoul(argv[1], &ptr, 10);
+		if(*ptr || ptr == argv[1] || !rate)
+			return E_BAD_VALUE;
+	}
+
+	if(!serial_speed(0)) {
+		puts("serial console not enabled");
+		return E_UNSPEC;
+	}
+
+	/* check the speed before the loaded image is thrown away */
+
+	prev = 0;
+	if(rate) {
+		printf("switching to %lu baud\n", rate);
+		prev = serial_speed(rate);
+		if(!prev) {
+			puts("speed not available on this port");
+			return E_UNSPEC;
+		}
+	}
+
+	heap_reset();
+
+	base = heap_reserve_lo(0);
+
+	puts("ready to receive (XMODEM/YMODEM)");
+	drain();
+
+	why = NULL;
+	size = xmodem_receive(base, heap_space(), &why);
+
+	if(prev) {
+		purge();
+		serial_speed(prev);
+	}
+
+	if((long) size < 0) {
+		printf("transfer failed, %s\n", why);
+		return E_UNSPEC;
+	}
+
+	memmove(heap_reserve_hi(size), base, size);
+
+	heap_alloc();
+	heap_info();
+
+	return E_NONE;
+}
+
+/* vi:set ts=3 sw=3 cin path=include,../include: */
@@ -18,7 +18,7 @@
 #include "../../include/rfx.h"
 
 #define VER_MAJOR					0
-#define VER_MINOR					1
+#define VER_MINOR					2
 
 #define MAX_RELOCS				50000
 
@@ -38,6 +38,9 @@ static Elf32_Shdr *sh;
 static int verbose;
 static unsigned *relocs;
 static unsigned nrelocs;
+static unsigned char *stream;
+static unsigned nstream;
+static int version = 2;
 
 /*
  * print error message and exit
@@ -81,6 +84,13 @@ static void output_bin(int fd, unsigned va)
 		if(sh[indx].sh_type == SHT_PROGBITS && (sh[indx].sh_flags & SHF_ALLOC))
 			memcpy(bin + sh[indx].sh_addr - va_base, (void *) eh + sh[indx].sh_offset, sh[indx].sh_size);
 
+	if(version > 1) {
+		if(!rfx_relocate(bin, va, stream))
+			fatal(NO_ERRNO, "RFX relocation failed");
+		munmap(bin, va_size);
+		return;
+	}
+
 	for(indx = 0; indx < nrelocs; ++indx) {
 
 		type = relocs[indx] & 3;
@@ -122,7 +132,10 @@ static void output_rfx(int fd)
 	off_t size;
 	void *base;
 
-	size = sizeof(struct rfx_header) + va_size + sizeof(unsigned) * nrelocs;
+	if(version > 1)
+		size = sizeof(struct rfx_header) + va_size + nstream;
+	else
+		size = sizeof(struct rfx_header) + va_size + sizeof(unsigned) * nrelocs;
 
 	if(ftruncate(fd, size))
 		fatal(errno, "failed to set file size");
@@ -131,11 +144,11 @@ static void output_rfx(int fd)
 	if(rfx == MAP_FAILED)
 		fatal(errno, "failed to map output file");
 
-	memcpy(rfx->magic, RFX_HDR_MAGIC, RFX_HDR_MAGIC_SZ);
+	memcpy(rfx->magic, version > 1 ? RFX_HDR_MAGIC_V2 : RFX_HDR_MAGIC, RFX_HDR_MAGIC_SZ);
 	rfx->imgsize = va_size;
 	rfx->memsize = va_memsz;
 	rfx->entry = eh->e_entry - va_base;
-	rfx->nrelocs = nrelocs;
+	rfx->nrelocs = version > 1 ? nstream : nrelocs;
 
 	base = rfx + 1;
 
@@ -143,11 +156,88 @@ static void output_rfx(int fd)
 		if(sh[indx].sh_type == SHT_PROGBITS && (sh[indx].sh_flags & SHF_ALLOC))
 			memcpy(base + sh[indx].sh_addr - va_base, (void *) eh + sh[indx].sh_offset, sh[indx].sh_size);
 
-	memcpy(base + va_size, relocs, sizeof(unsigned) * nrelocs);
+	if(version > 1)
+		memcpy(base + va_size, stream, nstream);
+	else
+		memcpy(base + va_size, relocs, sizeof(unsigned) * nrelocs);
 
 	munmap(rfx, size);
 }
 
+/*
+ * order relocations by type then offset
+ */
+static int reloc_order(const void *a, const void *b)
+{
+	unsigned x, y;
+
+	x = *(const unsigned *) a;
+	y = *(const unsigned *) b;
+
+	if((x & 3) != (y & 3))
+		return (x & 3) < (y & 3) ? -1 : 1;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * build version 2 relocation stream, runs of one type with delta encoded
+ * word offsets
+ */
+static void encode_relocs(void)
+{
+	unsigned indx, next, type, prev, delta, count;
+
+	/* worst case 4 bytes per relocation plus a run header per 65535 */
+
+	stream = malloc(nrelocs * 4 + (nrelocs / 0xffff + 4) * 3 + 1);
+	if(!stream)
+		fatal(errno, "failed to allocate relocation stream");
+
+	qsort(relocs, nrelocs, sizeof(unsigned), reloc_order);
+
+	nstream = 0;
+
+	for(indx = 0; indx < nrelocs; indx = next) {
+
+		type = relocs[indx] & 3;
+
+		for(next = indx; next < nrelocs && (relocs[next] & 3) == type && next - indx < 0xffff; ++next)
+			;
+
+		count = next - indx;
+
+		stream[nstream++] = type;
+		stream[nstream++] = count;
+		stream[nstream++] = count >> 8;
+
+		for(prev = -1; indx < next; ++indx) {
+
+			delta = (relocs[indx] >> 2) - prev;
+			prev = relocs[indx] >> 2;
+
+			if(!delta)
+				fatal(NO_ERRNO, "duplicate relocation at 0x%08x", relocs[indx] & ~3);
+
+			if(delta > 0xffffff)
+				fatal(NO_ERRNO, "relocation delta too large");
+
+			if(delta > 0xff) {
+				stream[nstream++] = 0;
+				stream[nstream++] = delta;
+				stream[nstream++] = delta >> 8;
+				stream[nstream++] = delta >> 16;
+			} else
+				stream[nstream++] = delta;
+		}
+	}
+
+	stream[nstream++] = RFX_REL_END;
+
+	if(verbose)
+		printf("stream       %u bytes (%u as words)\n", nstream, nrelocs * 4);
+}
+
 /*
  * map ELF file into memory and validate it
  */
@@ -340,7 +430,7 @@ static void reloc_elf(void)
  */
 static void usage(void)
 {
-	puts("\nusage: " APP_NAME " [ -v ] [ -f ] [ -b address ] in-file out-file\n");
+	puts("\nusage: " APP_NAME " [ -v ] [ -f ] [ -1 ] [ -b address ] in-file out-file\n");
 	puts("  v" _STR(VER_MAJOR) "." _STR(VER_MINOR) " (" __DATE__ ")\n");
 	exit(1);
 }
@@ -356,9 +446,13 @@ int main(int argc, char *argv[])
 
 	opterr = 0;
 
-	while((opt = getopt(argc, argv, "fvb:")) != -1)
+	while((opt = getopt(argc, argv, "fv1b:")) != -1)
 		switch(opt) {
 
+			case '1':
+				version = 1;
+				break;
+
 			case 'f':
 				over = 1;
 				break;
@@ -383,6 +477,9 @@ int main(int argc, char *argv[])
 	load_elf(argv[optind]);
 	reloc_elf();
 
+	if(version > 1)
+		encode_relocs();
+
 	fd = open(argv[optind + 1], O_CREAT | O_TRUNC | O_RDWR | (over ? 0 : O_EXCL), 0664);
 	if(fd == -1)
 		fatal(errno, "failed to create \"%s\"", argv[optind + 1]);
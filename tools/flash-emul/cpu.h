@@ -0,0 +1,27 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#ifndef _CPU_H_
+#define _CPU_H_
+
+#define CP0_COUNT							9
+#define CP0_COUNT_RATE					1000000
+
+/* frozen count, the key prompt always asks for 'A' */
+
+#define MFC0(n)							0
+
+#define KPHYS(a)							((void *)(unsigned long)(a))
+#define KSEG0(a)							((void *)(unsigned long)(a))
+#define KSEG1(a)							((void *)(unsigned long)(a))
+
+extern void udelay(unsigned);
+
+#endif
+
+/* vi:set ts=3 sw=3 cin: */
@@ -0,0 +1,368 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "flash-emul.h"
+
+#define APP_NAME					"flash-emul"
+
+#define DEFAULT_IMAGE			"flash-emul.img"
+
+#define FLASH_SIZE				(512 << 10)
+#define SECTOR_SIZE				(64 << 10)
+#define SECTOR_COUNT				(FLASH_SIZE / SECTOR_SIZE)
+
+#define VENDOR_ID					0x01
+#define DEVICE_ID					0xa4
+
+#define ADDR_MASK					0x7fff
+#define UNLOCK1_ADDR				0x5555
+#define UNLOCK2_ADDR				0x2aaa
+#define UNLOCK1_VALUE			0xaa
+#define UNLOCK2_VALUE			0x55
+
+#define CMND_CHIP_ERASE			0x10
+#define CMND_ERASE_SECTOR		0x30
+#define CMND_ERASE_SETUP		0x80
+#define CMND_AUTOSELECT			0x90
+#define CMND_PROGRAM				0xa0
+#define CMND_RESET				0xf0
+
+#define DQ7							(1 << 7)
+#define DQ6							(1 << 6)
+#define DQ5							(1 << 5)
+#define DQ3							(1 << 3)
+
+#define PROGRAM_US				7			/* datasheet typical */
+#define ERASE_MS					1000
+#define PROTECT_PROGRAM_US		2			/* protected sector, command aborted */
+#define PROTECT_ERASE_US		100
+
+enum {
+	STATE_READ,
+	STATE_UNLOCK1,
+	STATE_UNLOCK2,
+	STATE_AUTOSELECT,
+	STATE_PROGRAM,
+	STATE_ERASE1,
+	STATE_ERASE2,
+	STATE_ERASE3,
+	STATE_BUSY,
+};
+
+volatile uint8_t *flash_emul_base;
+
+static uint8_t *store;
+
+static unsigned state;
+static unsigned protect;
+static unsigned long program_ns;
+static unsigned long erase_ns;
+
+static uint64_t busy_until;
+static unsigned busy_data;
+static unsigned toggle;
+static int erasing;
+static int failed;
+
+static uint64_t open_mark;
+static uint64_t busy_total;
+static unsigned long n_reads, n_writes, n_programs, n_erases, n_failed;
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void busy(unsigned long ns)
+{
+	busy_until = now() + ns;
+	busy_total += ns;
+	state = STATE_BUSY;
+}
+
+/*
+ * embedded program algorithm, bits can only be cleared
+ */
+static void program(unsigned long addr, unsigned data)
+{
+	++n_programs;
+
+	busy_data = data;
+	erasing = 0;
+	failed = 0;
+
+	if(protect & (1 << (addr / SECTOR_SIZE))) {
+		busy(PROTECT_PROGRAM_US * 1000);
+		return;
+	}
+
+	if(data & ~store[addr]) {
+		failed = 1;
+		++n_failed;
+	}
+
+	store[addr] &= data;
+
+	busy(program_ns);
+}
+
+/*
+ * embedded erase algorithm, protected sectors are skipped
+ */
+static void erase(unsigned mask)
+{
+	unsigned indx, count;
+
+	erasing = 1;
+	failed = 0;
+
+	for(count = indx = 0; indx < SECTOR_COUNT; ++indx)
+		if((mask & ~protect) & (1 << indx)) {
+			memset(store + indx * SECTOR_SIZE, 0xff, SECTOR_SIZE);
+			++count;
+		}
+
+	n_erases += count;
+
+	busy(count ? count * erase_ns : PROTECT_ERASE_US * 1000);
+}
+
+unsigned flash_emul_read(unsigned long addr)
+{
+	unsigned stat;
+
+	++n_reads;
+
+	addr &= FLASH_SIZE - 1;
+
+	switch(state) {
+
+		case STATE_AUTOSELECT:
+
+			switch(addr & 3) {
+				case 0:
+					return VENDOR_ID;
+				case 1:
+					return DEVICE_ID;
+				case 2:
+					return !!(protect & (1 << (addr / SECTOR_SIZE)));
+			}
+			return 0;
+
+		case STATE_BUSY:
+
+			if(!failed && now() >= busy_until) {
+				state = STATE_READ;
+				break;
+			}
+
+			/* DQ6 toggles on every read until the operation ends */
+
+			toggle ^= DQ6;
+			stat = toggle;
+
+			if(erasing)
+				stat |= DQ3;
+			else
+				stat |= ~busy_data & DQ7;
+
+			if(failed && now() >= busy_until)
+				stat |= DQ5;
+
+			return stat;
+	}
+
+	return store[addr];
+}
+
+void flash_emul_write(unsigned long addr, unsigned data)
+{
+	unsigned cmnd;
+
+	++n_writes;
+
+	addr &= FLASH_SIZE - 1;
+	data &= 0xff;
+	cmnd = addr & ADDR_MASK;
+
+	/* only a failed operation can be reset whilst busy */
+
+	if(state == STATE_BUSY) {
+		if(failed && data == CMND_RESET && now() >= busy_until)
+			state = STATE_READ;
+		return;
+	}
+
+	if(data == CMND_RESET && state != STATE_PROGRAM) {
+		state = STATE_READ;
+		return;
+	}
+
+	switch(state) {
+
+		case STATE_READ:
+			if(cmnd == UNLOCK1_ADDR && data == UNLOCK1_VALUE)
+				state = STATE_UNLOCK1;
+			break;
+
+		case STATE_UNLOCK1:
+			state = cmnd == UNLOCK2_ADDR && data == UNLOCK2_VALUE ? STATE_UNLOCK2 : STATE_READ;
+			break;
+
+		case STATE_UNLOCK2:
+			state = STATE_READ;
+			if(cmnd == UNLOCK1_ADDR)
+				switch(data) {
+					case CMND_AUTOSELECT:
+						state = STATE_AUTOSELECT;
+						break;
+					case CMND_PROGRAM:
+						state = STATE_PROGRAM;
+						break;
+					case CMND_ERASE_SETUP:
+						state = STATE_ERASE1;
+						break;
+				}
+			break;
+
+		case STATE_PROGRAM:
+			program(addr, data);
+			break;
+
+		case STATE_ERASE1:
+			state = cmnd == UNLOCK1_ADDR && data == UNLOCK1_VALUE ? STATE_ERASE2 : STATE_READ;
+			break;
+
+		case STATE_ERASE2:
+			state = cmnd == UNLOCK2_ADDR && data == UNLOCK2_VALUE ? STATE_ERASE3 : STATE_READ;
+			break;
+
+		case STATE_ERASE3:
+			state = STATE_READ;
+			if(data == CMND_ERASE_SECTOR)
+				erase(1 << (addr / SECTOR_SIZE));
+			else if(cmnd == UNLOCK1_ADDR && data == CMND_CHIP_ERASE)
+				erase((1 << SECTOR_COUNT) - 1);
+			break;
+	}
+}
+
+static void report(void)
+{
+	fprintf(stderr, APP_NAME ": %lu sectors erased, %lu bytes programmed (%lu failed), %lu reads, %lu writes\n",
+		n_erases, n_programs, n_failed, n_reads, n_writes);
+	fprintf(stderr, APP_NAME ": %.3fs device busy, %.3fs elapsed\n",
+		busy_total / 1e9, (now() - open_mark) / 1e9);
+}
+
+/*
+ * map the backing file, creating it erased if needed
+ *
+ * FLASH_EMUL_IMAGE		backing file (default flash-emul.img)
+ * FLASH_EMUL_PROTECT	mask of protected sectors
+ * FLASH_EMUL_TIMING		"program_us,erase_ms" (default 7,1000)
+ */
+volatile uint8_t *flash_emul_open(void)
+{
+	const char *path, *env;
+	struct stat info;
+	void *view;
+	char *ptr;
+	int fd;
+
+	path = getenv("FLASH_EMUL_IMAGE");
+	if(!path)
+		path = DEFAULT_IMAGE;
+
+	program_ns = PROGRAM_US * 1000UL;
+	erase_ns = ERASE_MS * 1000000UL;
+
+	env = getenv("FLASH_EMUL_TIMING");
+	if(env) {
+		program_ns = strtoul(env, &ptr, 0) * 1000;
+		if(*ptr != ',') {
+			fputs(APP_NAME ": bad FLASH_EMUL_TIMING value\n", stderr);
+			return NULL;
+		}
+		erase_ns = strtoul(ptr + 1, &ptr, 0) * 1000000;
+		if(*ptr) {
+			fputs(APP_NAME ": bad FLASH_EMUL_TIMING value\n", stderr);
+			return NULL;
+		}
+	}
+
+	env = getenv("FLASH_EMUL_PROTECT");
+	if(env)
+		protect = strtoul(env, NULL, 0) & ((1 << SECTOR_COUNT) - 1);
+
+	fd = open(path, O_RDWR | O_CREAT, 0664);
+	if(fd == -1) {
+		fprintf(stderr, APP_NAME ": failed to open %s (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if(fstat(fd, &info)) {
+		fprintf(stderr, APP_NAME ": failed to stat %s (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if(info.st_size && info.st_size != FLASH_SIZE) {
+		fprintf(stderr, APP_NAME ": %s is not %u bytes\n", path, FLASH_SIZE);
+		return NULL;
+	}
+
+	if(!info.st_size && ftruncate(fd, FLASH_SIZE)) {
+		fprintf(stderr, APP_NAME ": failed to size %s (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+
+	store = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(store == MAP_FAILED) {
+		fprintf(stderr, APP_NAME ": failed to map %s (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if(!info.st_size)
+		memset(store, 0xff, FLASH_SIZE);
+
+	/* callers get a read only view, stray writes will fault */
+
+	view = mmap(NULL, FLASH_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+	if(view == MAP_FAILED) {
+		fprintf(stderr, APP_NAME ": failed to map %s (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+
+	close(fd);
+
+	state = STATE_READ;
+	open_mark = now();
+
+	atexit(report);
+
+	flash_emul_base = view;
+
+	return flash_emul_base;
+}
+
+/* vi:set ts=3 sw=3 cin: */
@@ -0,0 +1,25 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#ifndef _FLASH_EMUL_H_
+#define _FLASH_EMUL_H_
+
+#include <stdint.h>
+
+#define FLASH_RD(a)				flash_emul_read(a)
+#define FLASH_WR(a,v)			flash_emul_write((a),(v))
+
+extern volatile uint8_t *flash_emul_base;
+
+extern volatile uint8_t *flash_emul_open(void);
+extern unsigned flash_emul_read(unsigned long);
+extern void flash_emul_write(unsigned long, unsigned);
+
+#endif
+
+/* vi:set ts=3 sw=3 cin: */
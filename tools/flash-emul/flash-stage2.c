@@ -0,0 +1,138 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "lib.h"
+#include "cpu.h"
+#include "flash-emul.h"
+
+#define APP_NAME					"flash-stage2"
+
+/*
+ * just enough of stage2 to run the 'flash' command on the host
+ */
+
+unsigned argc;
+char *argv[3];
+size_t ram_size;
+
+static void *image;
+static size_t image_size;
+
+unsigned long evaluate(const char *str, char **end)
+{
+	return strtoul(str, end, 0);
+}
+
+void *heap_image(size_t *size)
+{
+	*size = image_size;
+
+	return image;
+}
+
+/*
+ * nothing is waiting at first, then 'A' is pressed
+ */
+int kbhit(void)
+{
+	static int polls;
+
+	return polls++ != 0;
+}
+
+int getch(void)
+{
+	return 'A';
+}
+
+void udelay(unsigned delay)
+{
+	struct timespec ts, mark;
+
+	clock_gettime(CLOCK_MONOTONIC, &mark);
+
+	do
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+	while((ts.tv_sec - mark.tv_sec) * 1000000 + (ts.tv_nsec - mark.tv_nsec) / 1000 < delay);
+}
+
+static int usage(void)
+{
+	puts("usage: " APP_NAME " file [ offset ]");
+
+	return 1;
+}
+
+int main(int count, char *args[])
+{
+	unsigned long offset;
+	ssize_t done;
+	char *ptr;
+	int fd;
+
+	if(count < 2 || count > 3)
+		return usage();
+
+	offset = 0;
+	if(count > 2) {
+		offset = strtoul(args[2], &ptr, 0);
+		if(ptr == args[2] || *ptr)
+			return usage();
+	}
+
+	fd = open(args[1], O_RDONLY);
+	if(fd == -1) {
+		fprintf(stderr, APP_NAME ": failed to open %s (%s)\n", args[1], strerror(errno));
+		return 1;
+	}
+
+	image_size = lseek(fd, 0, SEEK_END);
+	image = malloc(image_size);
+	if(!image) {
+		fputs(APP_NAME ": out of memory\n", stderr);
+		return 1;
+	}
+
+	done = pread(fd, image, image_size, 0);
+	if(done != image_size) {
+		fprintf(stderr, APP_NAME ": failed reading %s\n", args[1]);
+		return 1;
+	}
+
+	close(fd);
+
+	if(!flash_emul_open())
+		return 1;
+
+	argv[0] = "flash";
+	argv[1] = args[2] ? args[2] : "0";
+	argc = 2;
+
+	if(cmnd_flash(0) != E_NONE)
+		return 1;
+
+	if(memcmp((void *) flash_emul_base + offset, image, image_size)) {
+		fputs(APP_NAME ": VERIFY FAILED\n", stderr);
+		return 1;
+	}
+
+	puts("verified");
+
+	return 0;
+}
+
+/* vi:set ts=3 sw=3 cin: */
@@ -0,0 +1,51 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#ifndef _LIB_H_
+#define _LIB_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+	E_NONE,
+	E_UNSPEC,
+	E_ARGS_OVER,
+	E_ARGS_UNDER,
+	E_ARGS_COUNT,
+	E_BAD_EXPR,
+	E_BAD_VALUE,
+};
+
+extern unsigned argc;
+extern char *argv[];
+extern size_t ram_size;
+
+extern unsigned long evaluate(const char *, char **);
+extern void *heap_image(size_t *);
+extern int kbhit(void);
+extern int getch(void);
+
+#define yield()						do{}while(0)
+
+/* time stands still, timers never expire */
+
+struct timer
+{
+	unsigned			length;
+};
+
+#define timer_set(t,ms)				((void)((t)->length=(ms)))
+#define timer_expired(t)			0
+
+extern int cmnd_flash(int);
+
+#endif
+
+/* vi:set ts=3 sw=3 cin: */
@@ -19,15 +19,23 @@
 #include <sys/mman.h>
 
 #define VER_MAJOR					1
-#define VER_MINOR					4
+#define VER_MINOR					5
 
 #define APP_NAME					"flash-tool"
 
 #define FLASH_TOTAL_SIZE		(512 << 10)
+#define FLASH_SECTOR_SIZE		(64 << 10)
 #define FLASH_BASE_OFFSET		0x1fc00000
 
-#define UNLOCK1(v)				do{FLASH_P[0x5555]=(v);}while(0)
-#define UNLOCK2(v)				do{FLASH_P[0x2aaa]=(v);}while(0)
+#ifdef FLASH_EMUL
+# include "flash-emul.h"
+#else
+# define FLASH_RD(a)				(FLASH_P[a])
+# define FLASH_WR(a,v)			do{FLASH_P[a]=(v);}while(0)
+#endif
+
+#define UNLOCK1(v)				FLASH_WR(0x5555,v)
+#define UNLOCK2(v)				FLASH_WR(0x2aaa,v)
 #define UNLOCK1_VALUE			0xaa
 #define UNLOCK2_VALUE			0x55
 
@@ -46,21 +54,25 @@
 
 static volatile uint8_t *FLASH_P;
 
+static unsigned sectors_erased;
+static unsigned bytes_programmed;
+static unsigned bytes_restored;
+
 static unsigned flash_id(void)
 {
 	unsigned id;
 
 	/* should give invalid ID if FLASH_P is cached region */
 
-	FLASH_P[0] = CMND_RESET;
-	FLASH_P[1] = CMND_RESET;
+	FLASH_WR(0, CMND_RESET);
+	FLASH_WR(1, CMND_RESET);
 
 	UNLOCK1(UNLOCK1_VALUE);
 	UNLOCK2(UNLOCK2_VALUE);
 	UNLOCK1(CMND_AUTOSELECT);
 
-	id = FLASH_P[0];
-	id = FLASH_P[1] | (id << 8);
+	id = FLASH_RD(0);
+	id = FLASH_RD(1) | (id << 8);
 
 	UNLOCK1(CMND_RESET);
 
@@ -75,7 +87,7 @@ static int flash_locked(unsigned long addr)
 	UNLOCK2(UNLOCK2_VALUE);
 	UNLOCK1(CMND_AUTOSELECT);
 
-	lock = FLASH_P[addr];
+	lock = FLASH_RD(addr);
 
 	UNLOCK1(CMND_RESET);
 
@@ -93,15 +105,15 @@ static int flash_erase(unsigned long addr)
 	UNLOCK1(UNLOCK1_VALUE);
 	UNLOCK2(UNLOCK2_VALUE);
 
-	FLASH_P[addr] = CMND_ERASE_SECTOR;
+	FLASH_WR(addr, CMND_ERASE_SECTOR);
 
 	nbad = 0;
-	prev = FLASH_P[addr];
+	prev = FLASH_RD(addr);
 	mark = time(NULL);
 
 	for(;;) {
 
-		curr = FLASH_P[addr];
+		curr = FLASH_RD(addr);
 
 		test = (curr ^ prev) & (1 << 6);
 		if(!test)
@@ -133,15 +145,15 @@ static int flash_program_byte(unsigned long addr, unsigned data)
 	UNLOCK2(UNLOCK2_VALUE);
 	UNLOCK1(CMND_PROGRAM);
 
-	FLASH_P[addr] = data;
+	FLASH_WR(addr, data);
 
 	nbad = 0;
-	prev = FLASH_P[addr];
+	prev = FLASH_RD(addr);
 	mark = time(NULL);
 
 	for(;;) {
 
-		curr = FLASH_P[addr];
+		curr = FLASH_RD(addr);
 
 		test = (curr ^ prev) & (1 << 6);
 		if(!test)
@@ -161,36 +173,69 @@ static int flash_program_byte(unsigned long addr, unsigned data)
 
 	UNLOCK1(CMND_RESET);
 
-	return !test && FLASH_P[addr] == data;
+	return !test && FLASH_RD(addr) == data;
 }
 
 static int flash_program_block(unsigned long addr, const void *data, size_t size)
 {
-	unsigned indx;
+	static uint8_t save[FLASH_SECTOR_SIZE];
+	unsigned long sect, base, end, indx;
+	const uint8_t *src;
+	int partial;
+
+	sectors_erased = 0;
+	bytes_programmed = 0;
+	bytes_restored = 0;
+
+	src = data;
+
+	for(sect = addr & ~(FLASH_SECTOR_SIZE - 1); sect < addr + size; sect += FLASH_SECTOR_SIZE) {
+
+		base = sect < addr ? addr : sect;
+		end = sect + FLASH_SECTOR_SIZE > addr + size ? addr + size : sect + FLASH_SECTOR_SIZE;
+
+		/* erase only if some bit has to go from 0 to 1 */
+
+		for(indx = base; indx < end; ++indx)
+			if(src[indx - addr] & ~FLASH_RD(indx))
+				break;
+
+		if(indx < end) {
 
-	for(indx = 0; indx < size; ++indx) {
+			/* preserve the rest of the sector */
 
-		if(((uint8_t *) data)[indx] & ~FLASH_P[addr + indx]) {
+			partial = base != sect || end != sect + FLASH_SECTOR_SIZE;
+			if(partial)
+				memcpy(save, (void *) FLASH_P + sect, FLASH_SECTOR_SIZE);
 
 			putchar('*');
 			fflush(stdout);
 
-			if(!flash_erase(addr + indx))
-				return addr + indx;
+			if(!flash_erase(sect))
+				return sect;
 
-			indx = ((addr + indx) | 0xfff) + 1 - addr;
+			++sectors_erased;
+
+			if(partial)
+				for(indx = sect; indx < sect + FLASH_SECTOR_SIZE; ++indx)
+					if((indx < base || indx >= end) && save[indx - sect] != 0xff) {
+						if(!flash_program_byte(indx, save[indx - sect]))
+							return indx;
+						++bytes_restored;
+					}
 		}
-	}
 
-	for(indx = 0; indx < size; ++indx) {
+		putchar('+');
+		fflush(stdout);
 
-		if(!(indx & 0x1fff)) {
-			putchar('+');
-			fflush(stdout);
-		}
+		/* skip bytes that are already correct */
 
-		if(!flash_program_byte(addr + indx, ((uint8_t *) data)[indx]))
-			return addr + indx;
+		for(indx = base; indx < end; ++indx)
+			if(FLASH_RD(indx) != src[indx - addr]) {
+				if(!flash_program_byte(indx, src[indx - addr]))
+					return indx;
+				++bytes_programmed;
+			}
 	}
 
 	return -1;
@@ -312,6 +357,11 @@ int main(int argc, char *argv[])
 	if(argc - optind != 1)
 		usage();
 
+#ifdef FLASH_EMUL
+	FLASH_P = flash_emul_open();
+	if(!FLASH_P)
+		return 1;
+#else
 	fd = open("/dev/mem", O_RDWR | O_SYNC);
 	if(fd == -1) {
 		fprintf(stderr, APP_NAME ": failed to open /dev/mem (%s)\n", strerror(errno));
@@ -323,6 +373,7 @@ int main(int argc, char *argv[])
 		fprintf(stderr, APP_NAME ": failed to map /dev/mem (%s)\n", strerror(errno));
 		return 1;
 	}
+#endif
 
 	id = flash_id();
 	if(id != DEVICE_AM29F040) {
@@ -379,7 +430,12 @@ int main(int argc, char *argv[])
 			return 1;
 		}
 
-		puts("programmed and verified successfully");
+		printf("programmed and verified successfully (%u of %u sectors erased, %u of %u bytes programmed",
+			sectors_erased, (unsigned) ((offset + size - 1) / FLASH_SECTOR_SIZE - offset / FLASH_SECTOR_SIZE + 1),
+			bytes_programmed, (unsigned) size);
+		if(bytes_restored)
+			printf(", %u restored", bytes_restored);
+		puts(")");
 
 	} else {
 
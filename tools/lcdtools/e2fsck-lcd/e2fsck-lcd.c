@@ -14,6 +14,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
@@ -30,10 +31,16 @@
 
 #define LCD_WIDTH						16
 
+#define REFRESH_MIN					100					/* ms between redraws */
+
 static const char spaces[] = { [0 ... (LCD_WIDTH - 1)] = ' ' };
 static unsigned thumb;
 static int lcd;
 
+static int shown;
+static int pending;
+static struct timespec drawn;
+
 const char *getapp(void)
 {
 	return APP_NAME;
@@ -65,6 +72,8 @@ static void disp_init(const char *devn)
 	lcd_text("]", -1);
 
 	thumb = 0;
+	shown = 0;
+	pending = 0;
 }
 
 /*
@@ -82,18 +91,35 @@ static void disp_cleanup(void)
 }
 
 /*
- * update output with new progress information
+ * milliseconds until the next redraw is allowed
  */
-static void disp_update(int pass, unsigned where, unsigned limit)
+static int disp_delay(void)
+{
+	struct timespec now;
+	long used;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	used = (now.tv_sec - drawn.tv_sec) * 1000 + (now.tv_nsec - drawn.tv_nsec) / 1000000;
+
+	return used < REFRESH_MIN ? REFRESH_MIN - used : 0;
+}
+
+/*
+ * draw pending progress, no more often than REFRESH_MIN unless forced
+ */
+static void disp_flush(int force)
 {
 	static char bar[] = { [0 ... (LCD_WIDTH - 1)] = '=' };
 	static char text[16];
 	unsigned prog;
 
-	if(pass < 1 || pass > 5)
+	if(pending == shown || (!force && disp_delay()))
 		return;
 
-	prog = (pass - 1) * 200 + (where * 200 + limit / 2) / limit;
+	clock_gettime(CLOCK_MONOTONIC, &drawn);
+
+	prog = shown = pending;
 
 	snprintf(text, sizeof(text), "%3u.%u%%", prog / 10, prog % 10);
 	text[sizeof(text) - 1] = '\0';
@@ -117,6 +143,47 @@ static void disp_update(int pass, unsigned where, unsigned limit)
 	fflush(stdout);
 }
 
+/*
+ * update output with new progress information, only redrawn if the
+ * displayed percentage changes
+ */
+static void disp_update(int pass, unsigned where, unsigned limit)
+{
+	if(pass < 1 || pass > 5 || !limit)
+		return;
+
+	pending = (pass - 1) * 200 + ((uint64_t) where * 200 + limit / 2) / limit;
+
+	disp_flush(0);
+}
+
+/*
+ * parse "pass where limit", cheaper than sscanf() at fsck's line rate
+ */
+static int parse_line(const char *ptr, unsigned *vals, unsigned count)
+{
+	unsigned indx, val;
+
+	for(indx = 0; indx < count; ++indx) {
+
+		while(*ptr == ' ' || *ptr == '\t')
+			++ptr;
+
+		if(*ptr < '0' || *ptr > '9')
+			return 0;
+
+		for(val = 0; *ptr >= '0' && *ptr <= '9'; ++ptr)
+			val = val * 10 + *ptr - '0';
+
+		vals[indx] = val;
+	}
+
+	while(*ptr == ' ' || *ptr == '\t' || *ptr == '\r')
+		++ptr;
+
+	return !*ptr;
+}
+
 /*
  * read progress information from pipe
  */
@@ -124,9 +191,10 @@ static void monitor(int fd, const char *devn)
 {
 	static char ibuf[8192];
 
-	unsigned fill, pass, where, limit;
-	int cntl, nread, skip, init;
-	char pad, *ptr;
+	unsigned fill, scan, done, vals[3];
+	int cntl, nread, skip, init, delay;
+	char *ptr, *line;
+	struct timeval tv;
 	fd_set set;
 
 	cntl = fcntl(fd, F_GETFL);
@@ -143,15 +211,27 @@ static void monitor(int fd, const char *devn)
 
 	FD_ZERO(&set);
 
-	for(init = 0, fill = 0, skip = 0;;) {
+	for(init = 0, fill = 0, scan = 0, skip = 0;;) {
 
 		FD_SET(fd, &set);
 
-		if(select(fd + 1, &set, NULL, NULL, NULL) == -1 && errno != EINTR) {
+		/* wake to draw progress held back by the refresh limit */
+
+		delay = init && pending != shown ? disp_delay() : -1;
+		tv.tv_sec = 0;
+		tv.tv_usec = delay * 1000;
+
+		if(select(fd + 1, &set, NULL, NULL, delay < 0 ? NULL : &tv) == -1 && errno != EINTR) {
 			fprintf(stderr, APP_NAME ": failed waiting on pipe (%s)\n", strerror(errno));
 			return;
 		}
 
+		if(init)
+			disp_flush(0);
+
+		if(!FD_ISSET(fd, &set))
+			continue;
+
 		nread = read(fd, ibuf + fill, sizeof(ibuf) - fill);
 		if(!nread)
 			break;
@@ -166,35 +246,32 @@ static void monitor(int fd, const char *devn)
 
 		fill += nread;
 
-		for(;;) {
-
-			ptr = strchr(ibuf, '\n');
-			if(!ptr) {
-
-				if(fill == sizeof(ibuf)) {
+		/* only scan new data, move the partial line down once per read */
 
-					if(!skip)
-						fputs(APP_NAME ": line too long\n", stderr);
+		for(done = 0;;) {
 
-					skip = 1;
-					fill = 0;
-				}
+			ptr = memchr(ibuf + scan, '\n', fill - scan);
+			if(!ptr) {
 
+				scan = fill;
 				break;
 			}
 
 			*ptr++ = '\0';
 
+			line = ibuf + done;
+			done = scan = ptr - ibuf;
+
 			if(!skip) {
 
-				if(sscanf(ibuf, " %u %u %u %c", &pass, &where, &limit, &pad) == 3) {
+				if(parse_line(line, vals, 3)) {
 
 					if(!init) {
 						disp_init(devn);
 						init = 1;
 					}
 
-					disp_update(pass, where, limit);
+					disp_update(vals[0], vals[1], vals[2]);
 
 				} else
 
@@ -202,14 +279,29 @@ static void monitor(int fd, const char *devn)
 			}
 
 			skip = 0;
+		}
+
+		if(done) {
+			fill -= done;
+			scan -= done;
+			memmove(ibuf, ibuf + done, fill);
+		}
 
-			fill -= ptr - ibuf;
-			memmove(ibuf, ptr, fill);
+		if(fill == sizeof(ibuf)) {
+
+			if(!skip)
+				fputs(APP_NAME ": line too long\n", stderr);
+
+			skip = 1;
+			fill = 0;
+			scan = 0;
 		}
 	}
 
-	if(init > 0)
+	if(init > 0) {
+		disp_flush(1);
 		disp_cleanup();
+	}
 }
 
 int main(int argc, char *argv[])
@@ -44,6 +44,7 @@ struct lcd_display
 
 static struct lcd_display info;
 static unsigned xpos, ypos;
+static int known[2];
 static int dev;
 
 static void exp_clear(void)
@@ -52,6 +53,9 @@ static void exp_clear(void)
 
 	memset(info.line1, ' ', LCD_WIDTH);
 	memset(info.line2, ' ', LCD_WIDTH);
+
+	known[0] = 1;
+	known[1] = 1;
 	
 	xpos = 0;
 	ypos = 0;
@@ -63,9 +67,15 @@ static void exp_curs_move(unsigned row, unsigned col)
 	ypos = row;
 }
 
-static void exp_text(const char *str, unsigned wid)
+/*
+ * the driver always writes a row from the left, so stop at the last
+ * character that changed (or send nothing at all)
+ */
+static void exp_write(const char *str, unsigned wid, int pad)
 {
 	unsigned char *ptr;
+	unsigned size;
+	char chr;
 
 	ypos += xpos / LCD_WIDTH;
 	xpos %= LCD_WIDTH;
@@ -76,60 +86,50 @@ static void exp_text(const char *str, unsigned wid)
 	if(wid > LCD_WIDTH)
 		wid = LCD_WIDTH;
 
-	info.size1 = 0;
-	info.size2 = 0;
-
 	if(ypos)
 		ptr = info.line2;
 	else
 		ptr = info.line1;
 
-	while(xpos < wid && *str)
-		ptr[xpos++] = *str++;
+	for(size = 0; xpos < wid && (*str || pad); ++xpos) {
 
-	if(ypos)
-		info.size2 = xpos;
-	else
-		info.size1 = xpos;
+		chr = *str ? *str++ : ' ';
 
-	ioctl(dev, LCD_Write, &info);
-}
-
-static void exp_puts(unsigned row, unsigned col, unsigned wid, const char *str)
-{
-	unsigned char *ptr;
+		if(ptr[xpos] != (unsigned char) chr) {
+			ptr[xpos] = chr;
+			size = xpos + 1;
+		}
+	}
 
-	exp_curs_move(row, col);
+	if(!known[ypos])
+		size = xpos;
 
-	ypos += xpos / LCD_WIDTH;
-	xpos %= LCD_WIDTH;
-	ypos %= 2;
+	if(!size)
+		return;
 
-	if(wid < LCD_WIDTH)
-		wid += xpos;
-	if(wid > LCD_WIDTH)
-		wid = LCD_WIDTH;
+	known[ypos] = 1;
 
 	info.size1 = 0;
 	info.size2 = 0;
 
 	if(ypos)
-		ptr = info.line2;
+		info.size2 = size;
 	else
-		ptr = info.line1;
+		info.size1 = size;
 
-	while(xpos < wid && *str)
-		ptr[xpos++] = *str++;
+	ioctl(dev, LCD_Write, &info);
+}
 
-	while(xpos < wid)
-		ptr[xpos++] = ' ';
+static void exp_text(const char *str, unsigned wid)
+{
+	exp_write(str, wid, 0);
+}
 
-	if(ypos)
-		info.size2 = xpos;
-	else
-		info.size1 = xpos;
+static void exp_puts(unsigned row, unsigned col, unsigned wid, const char *str)
+{
+	exp_curs_move(row, col);
 
-	ioctl(dev, LCD_Write, &info);
+	exp_write(str, wid, 1);
 }
 
 static int exp_buttons(void)
@@ -168,6 +168,9 @@ const struct lcd_dispatch_table *lcddev_open(const char *name)
 	memset(info.line1, ' ', LCD_WIDTH);
 	memset(info.line2, ' ', LCD_WIDTH);
 
+	known[0] = 0;
+	known[1] = 0;
+
 	return &funcs;
 }
 
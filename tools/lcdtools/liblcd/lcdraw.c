@@ -33,12 +33,19 @@
 #define LCD_CGRAM_ADDR			0x40
 #define LCD_DDRAM_ADDR			0x80
 #define LCD_ROW_OFFSET			0x40
+#define LCD_ROW_SIZE				0x28
+
+#define DDRAM_SIZE				0x80
 
 #define BUSY_TIME_MAX			100
 
 static volatile uint32_t *btn;
 static volatile uint32_t *lcd;
 
+static short ddram[DDRAM_SIZE];		/* display contents, -1 if unknown */
+static unsigned curs;					/* where the next character goes */
+static unsigned addr;					/* controller address counter */
+
 static void udelay(unsigned delay)
 {
 	struct timeval mark, now;
@@ -64,9 +71,50 @@ static void lcd_write(int reg, unsigned val)
 	LCD_WRITE(reg, val);
 }
 
+/*
+ * address counter increment in two line mode
+ */
+static unsigned ddram_next(unsigned pos)
+{
+	if(pos == LCD_ROW_SIZE - 1)
+		return LCD_ROW_OFFSET;
+
+	if(pos == LCD_ROW_OFFSET + LCD_ROW_SIZE - 1)
+		return 0;
+
+	return (pos + 1) & (DDRAM_SIZE - 1);
+}
+
+/*
+ * write character at cursor, skipped if the display already has it
+ */
+static void raw_putc(uint8_t chr)
+{
+	if(ddram[curs] != chr) {
+
+		if(addr != curs)
+			lcd_write(0, LCD_DDRAM_ADDR | curs);
+
+		lcd_write(1, chr);
+
+		ddram[curs] = chr;
+		addr = ddram_next(curs);
+	}
+
+	curs = ddram_next(curs);
+}
+
 static void raw_clear(void)
 {
+	unsigned indx;
+
 	lcd_write(0, LCD_CLEAR);
+
+	for(indx = 0; indx < DDRAM_SIZE; ++indx)
+		ddram[indx] = ' ';
+
+	addr = 0;
+	curs = 0;
 }
 
 static void raw_prog(unsigned which, const void *data)
@@ -79,11 +127,17 @@ static void raw_prog(unsigned which, const void *data)
 		lcd_write(1, ((uint8_t *) data)[indx]);
 
 	lcd_write(0, LCD_DDRAM_ADDR);
+
+	addr = 0;
+	curs = 0;
 }
 
+/*
+ * the controller is only told when something is written
+ */
 static void raw_curs_move(unsigned row, unsigned col)
 {
-	lcd_write(0, LCD_DDRAM_ADDR | (LCD_ROW_OFFSET * row + col));
+	curs = (LCD_ROW_OFFSET * row + col) & (DDRAM_SIZE - 1);
 }
 
 static void raw_text(const char *str, unsigned max)
@@ -91,7 +145,7 @@ static void raw_text(const char *str, unsigned max)
 	unsigned indx;
 
 	for(indx = 0; str[indx] && indx < max; ++indx)
-		lcd_write(1, str[indx]);
+		raw_putc(str[indx]);
 }
 
 static void raw_puts(unsigned row, unsigned col, unsigned wid, const char *str)
@@ -101,10 +155,10 @@ static void raw_puts(unsigned row, unsigned col, unsigned wid, const char *str)
 	raw_curs_move(row, col);
 
 	for(indx = 0; str[indx] && indx < wid; ++indx)
-		lcd_write(1, str[indx]);
+		raw_putc(str[indx]);
 
 	for(; indx < wid; ++indx)
-		lcd_write(1, ' ');
+		raw_putc(' ');
 }
 
 static int raw_buttons(void)
@@ -131,6 +185,7 @@ static const struct lcd_dispatch_table funcs =
 
 const struct lcd_dispatch_table *lcdraw_open(void)
 {
+	unsigned indx;
 	int fd;
 
 	fd = open("/dev/mem", O_RDWR | O_SYNC);
@@ -156,6 +211,14 @@ const struct lcd_dispatch_table *lcdraw_open(void)
 
 	close(fd);
 
+	/* nothing is known about the display until it's written */
+
+	for(indx = 0; indx < DDRAM_SIZE; ++indx)
+		ddram[indx] = -1;
+
+	addr = DDRAM_SIZE;
+	curs = 0;
+
 	return &funcs;
 }
 
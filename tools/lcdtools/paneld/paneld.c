@@ -14,8 +14,9 @@
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <poll.h>
 #include <sys/mman.h>
-#include <sys/time.h>
+#include <sys/timerfd.h>
 
 #include "liblcd.h"
 
@@ -25,12 +26,23 @@
 #define LCD_MENU_TIMEOUT		(-2)
 #define LCD_MENU_CANCEL			(-3)
 
-#define BTN_DEBOUNCE				(50 * 1000)
-#define UPDATE_TICK				(500 * 1000)
-#define UPDATE_PERIOD_COUNT	(5 * 1000 * 1000 / UPDATE_TICK)
-#define MENU_SELECT_COUNT		(1000 * 1000 * 3 / 2 / UPDATE_TICK)
-#define MENU_TIMEOUT				(10 * 1000 * 1000)
-#define MENU_MESSAGE				(5 * 1000 * 1000)
+#define BTN_FAST					50			/* ms, sampling after a press or in a menu */
+#define BTN_SLOW					1000		/* ms, sampling when idle, a hold is all that matters */
+#define BTN_LINGER				3000		/* ms, stay fast after activity */
+#define UPDATE_PERIOD			5000
+#define MENU_SELECT				1000
+#define MENU_TIMEOUT				10000
+#define MENU_MESSAGE				5000
+#define SCROLL_STEP				30
+
+#define TIMER_SAMPLE				0
+#define TIMER_UPDATE				1
+#define TIMER_MENU				2
+#define TIMER_STEP				3
+#define TIMER_COUNT				4
+
+#define EVENT_TIMER(n)			(1 << (n))
+#define EVENT_BUTTON				(1 << TIMER_COUNT)
 
 #define ELEMENTS(x)				(sizeof(x)/sizeof((x)[0]))
 
@@ -64,11 +76,109 @@ static const char **menu_actions[] =
 	action_reboot,
 };
 
+static uint64_t timers[TIMER_COUNT];
+static int timer_fd;
+
+static unsigned btn_curr;
+static unsigned btn_down;
+static uint64_t btn_active;
+static int btn_menu;
+
 const char *getapp(void)
 {
 	return APP_NAME;
 }
 
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * arm (or with zero cancel) one of the software timers
+ */
+static void timer_set(unsigned which, unsigned ms)
+{
+	timers[which] = ms ? now_ms() + ms : 0;
+}
+
+/*
+ * sleep until one of the requested events, timers share one timerfd armed
+ * for the earliest deadline. Buttons are sampled on their own timer, fast
+ * whilst a menu is up or for a while after any activity and slow otherwise,
+ * as when idle only a button held to bring up the menu matters. Newly
+ * pressed buttons collect in btn_down until the caller takes them.
+ */
+static unsigned panel_wait(unsigned mask)
+{
+	struct itimerspec its;
+	struct pollfd pfd;
+	unsigned indx, events, btn;
+	uint64_t next, mark, junk;
+
+	mask |= EVENT_TIMER(TIMER_SAMPLE);
+
+	for(;;) {
+
+		next = 0;
+		for(indx = 0; indx < TIMER_COUNT; ++indx)
+			if((mask & EVENT_TIMER(indx)) && timers[indx] && (!next || timers[indx] < next))
+				next = timers[indx];
+
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = next / 1000;
+		its.it_value.tv_nsec = next % 1000 * 1000000;
+
+		timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+		pfd.fd = timer_fd;
+		pfd.events = POLLIN;
+
+		if(poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+			fprintf(stderr, APP_NAME ": poll failed (%s)\n", strerror(errno));
+			exit(1);
+		}
+
+		if(read(timer_fd, &junk, sizeof(junk)) == -1 && errno != EAGAIN)
+			continue;
+
+		mark = now_ms();
+		events = 0;
+
+		for(indx = 0; indx < TIMER_COUNT; ++indx)
+			if((mask & EVENT_TIMER(indx)) && timers[indx] && timers[indx] <= mark) {
+				timers[indx] = 0;
+				events |= EVENT_TIMER(indx);
+			}
+
+		if(events & EVENT_TIMER(TIMER_SAMPLE)) {
+
+			events &= ~EVENT_TIMER(TIMER_SAMPLE);
+
+			btn = btn_read();
+
+			if(btn != btn_curr) {
+				btn_down |= btn & ~btn_curr;
+				btn_curr = btn;
+				events |= EVENT_BUTTON;
+			}
+
+			if(btn)
+				btn_active = mark;
+
+			timer_set(TIMER_SAMPLE, btn_menu || mark - btn_active < BTN_LINGER ? BTN_FAST : BTN_SLOW);
+		}
+
+		events &= mask;
+		if(events)
+			return events;
+	}
+}
+
 static const char *lcd_symbols(const char *def)
 {
 	static const uint8_t arrow[][8] =
@@ -149,14 +259,14 @@ static void lcd_scroll(const char *str, int dir)
 		if(!--num)
 			break;
 
-		usleep(30 * 1000);
+		timer_set(TIMER_STEP, SCROLL_STEP);
+		panel_wait(EVENT_TIMER(TIMER_STEP));
 	}
 }
 
 static int lcd_menu_horz(const char **options, unsigned count, unsigned timeout)
 {
-	unsigned exp, sel, btn, prv;
-	struct timeval mark, now;
+	unsigned sel, btn;
 	char buf[LCD_WIDTH];
 	int dir;
 
@@ -168,51 +278,34 @@ static int lcd_menu_horz(const char **options, unsigned count, unsigned timeout)
 
 	lcd_scroll(options[1], 0);
 
-	prv = btn_read();
+	timer_set(TIMER_MENU, timeout);
+	btn_down = 0;
 
 	for(sel = 1;;) {
 
-		gettimeofday(&mark, NULL);
-		
-		for(;;) {
-
-			if(timeout) {
-
-				gettimeofday(&now, NULL);
-
-				exp = (now.tv_sec - mark.tv_sec) * 1000000 + now.tv_usec - mark.tv_usec;
-
-				if(exp >= timeout)
-					return LCD_MENU_TIMEOUT;
-			}
-
-			btn = btn_read();
-
-			btn ^= prv;
-			prv ^= btn;
-			btn &= prv;
-
-			if(btn & (BTN_ENTER | BTN_SELECT))
-				return sel - 1;
+		if(panel_wait(EVENT_BUTTON | EVENT_TIMER(TIMER_MENU)) & EVENT_TIMER(TIMER_MENU))
+			return LCD_MENU_TIMEOUT;
 
-			if(btn & (BTN_UP | BTN_DOWN))
-				return LCD_MENU_CANCEL;
+		btn = btn_down;
+		btn_down = 0;
 
-			if(btn & (BTN_LEFT | BTN_RIGHT)) {
+		if(btn & (BTN_ENTER | BTN_SELECT))
+			return sel - 1;
 
-				dir = 1;
-				if(btn & BTN_RIGHT)
-					dir = -1;
+		if(btn & (BTN_UP | BTN_DOWN))
+			return LCD_MENU_CANCEL;
 
-				sel -= dir;
-				if(sel < 1 || sel >= count)
-					sel = count - sel - dir;
+		if(btn & (BTN_LEFT | BTN_RIGHT)) {
 
-				lcd_scroll(options[sel], dir);
+			dir = 1;
+			if(btn & BTN_RIGHT)
+				dir = -1;
 
-			} else
+			sel -= dir;
+			if(sel < 1 || sel >= count)
+				sel = count - sel - dir;
 
-				usleep(BTN_DEBOUNCE);
+			lcd_scroll(options[sel], dir);
 		}
 	}
 
@@ -221,19 +314,16 @@ static int lcd_menu_horz(const char **options, unsigned count, unsigned timeout)
 
 static int lcd_menu_vert(const char **options, unsigned count, unsigned timeout)
 {
-	unsigned exp, row, top, btn, prv;
-	struct timeval mark, now;
+	unsigned row, top, btn;
 	const char *sym;
-	char buf[2];
 
 	if(count < 2)
 		return LCD_MENU_ERROR;
 
 	sym = lcd_symbols("][");
 
-	prv = btn_read();
+	btn_down = 0;
 
-	buf[1] = '\0';
 	row = 1;
 	top = 0;
 
@@ -247,25 +337,15 @@ static int lcd_menu_vert(const char **options, unsigned count, unsigned timeout)
 		lcd_puts(1, 1, LCD_WIDTH - 2, options[top + 1]);
 		lcd_puts(1, LCD_WIDTH - 1, 1, row ? &sym[0] : " ");
 
-		gettimeofday(&mark, NULL);
+		timer_set(TIMER_MENU, timeout);
 		
 		for(;;) {
 
-			if(timeout) {
-
-				gettimeofday(&now, NULL);
+			if(panel_wait(EVENT_BUTTON | EVENT_TIMER(TIMER_MENU)) & EVENT_TIMER(TIMER_MENU))
+				return LCD_MENU_TIMEOUT;
 
-				exp = (now.tv_sec - mark.tv_sec) * 1000000 + now.tv_usec - mark.tv_usec;
-
-				if(exp >= timeout)
-					return LCD_MENU_TIMEOUT;
-			}
-
-			btn = btn_read();
-
-			btn ^= prv;
-			prv ^= btn;
-			btn &= prv;
+			btn = btn_down;
+			btn_down = 0;
 
 			if(btn & (BTN_RIGHT | BTN_ENTER | BTN_SELECT))
 				return top + row - 1;
@@ -296,8 +376,6 @@ static int lcd_menu_vert(const char **options, unsigned count, unsigned timeout)
 					break;
 				}
 			}
-
-			usleep(BTN_DEBOUNCE);
 		}
 	}
 }
@@ -317,7 +395,7 @@ int main(int argc, char *argv[])
 	};
 	static char text[32];
 
-	unsigned count, update, active, roller;
+	unsigned events, roller;
 	int opt, daemon, which, mtype;
 	time_t wall;
 
@@ -357,16 +435,26 @@ int main(int argc, char *argv[])
 				return 0;
 		}
 
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(timer_fd == -1) {
+		fprintf(stderr, APP_NAME ": failed to create timer (%s)\n", strerror(errno));
+		return -1;
+	}
+
+	btn_curr = btn_read();
+	timer_set(TIMER_SAMPLE, BTN_SLOW);
+
 	for(roller = optind;;) {
 
-		active = MENU_SELECT_COUNT;
-		update = 0;
+		/* ignore a button still held from the menu */
 
-		for(count = UPDATE_PERIOD_COUNT;; ++count) {
+		timer_set(TIMER_MENU, 0);
 
-			if(count - update >= UPDATE_PERIOD_COUNT) {
+		for(events = EVENT_TIMER(TIMER_UPDATE);;) {
 
-				update += UPDATE_PERIOD_COUNT;
+			if(events & EVENT_TIMER(TIMER_UPDATE)) {
+
+				timer_set(TIMER_UPDATE, UPDATE_PERIOD);
 
 				time(&wall);
 				strftime(text, sizeof(text), "%a %b %d %H:%M", localtime(&wall));
@@ -384,16 +472,24 @@ int main(int argc, char *argv[])
 					lcd_puts(1, 0, LCD_WIDTH, "");
 			}
 
-			if(btn_read() & (BTN_SELECT | BTN_ENTER)) {
-				if(active < MENU_SELECT_COUNT && ++active == MENU_SELECT_COUNT)
-					break;
-			} else
-				active = 0;
+			/* menu after the button has been held for a while */
+
+			if(events & EVENT_BUTTON) {
+				if(!(btn_curr & (BTN_SELECT | BTN_ENTER)))
+					timer_set(TIMER_MENU, 0);
+				else if(!timers[TIMER_MENU])
+					timer_set(TIMER_MENU, MENU_SELECT);
+			}
+
+			if(events & EVENT_TIMER(TIMER_MENU))
+				break;
 
-			usleep(UPDATE_TICK);
+			events = panel_wait(EVENT_BUTTON | EVENT_TIMER(TIMER_UPDATE) | EVENT_TIMER(TIMER_MENU));
 		}
 
+		btn_menu = 1;
 		which = menu[mtype](menu_options, ELEMENTS(menu_options), MENU_TIMEOUT);
+		btn_menu = 0;
 
 		if(which >= 0 && which < ELEMENTS(menu_actions)) {
 
@@ -415,7 +511,8 @@ int main(int argc, char *argv[])
 					return -1;
 			}
 
-			usleep(MENU_MESSAGE);
+			timer_set(TIMER_MENU, MENU_MESSAGE);
+			panel_wait(EVENT_TIMER(TIMER_MENU));
 		}
 	}
 
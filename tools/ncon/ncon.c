@@ -4,6 +4,8 @@
  * $Id$
  */
 
+#define _GNU_SOURCE
+
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -12,6 +14,11 @@
 #include <termios.h>
 #include <netdb.h>
 #include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
@@ -20,19 +27,369 @@
 #define DEFAULT_SRC_PORT			6666
 #define DEFAULT_DST_PORT			6665
 
+#define MAX_PORTS						16
+#define MAX_UNITS						1024						/* power of two */
+#define BATCH							64							/* datagrams per recvmmsg() */
+#define DGRAM_SIZE					2048
+#define LOG_BUFFER					(256 << 10)
+#define FLUSH_PERIOD					1000						/* ms */
+#define RCVBUF_SIZE					(8 << 20)
+
+struct unit
+{
+	struct in_addr addr;
+	unsigned long lines;
+	unsigned long bytes;
+	unsigned fill;
+	int fd;
+	int mid;
+	char *buf;
+};
+
+static struct unit *units[MAX_UNITS];
+static const char *log_dir;
+static unsigned nunits;
+
+static volatile sig_atomic_t stop;
+
 static void usage(void)
 {
-	puts("\nusage: " APP_NAME " [ -p source ] host [ port ]\n");
+	puts("\nusage: " APP_NAME " [ -p source ] host [ port ]\n"
+		  "       " APP_NAME " -l directory [ -p source ] ...\n");
 
 	exit(1);
 }
 
+static void on_signal(int sig)
+{
+	stop = 1;
+}
+
+static void unit_flush(struct unit *unit)
+{
+	unsigned indx;
+	int done;
+
+	for(indx = 0; indx < unit->fill;) {
+
+		done = write(unit->fd, unit->buf + indx, unit->fill - indx);
+
+		if(done == -1) {
+			if(errno == EINTR)
+				continue;
+			fprintf(stderr, APP_NAME ": failed writing log for %s (%s)\n", inet_ntoa(unit->addr), strerror(errno));
+			break;
+		}
+
+		indx += done;
+	}
+
+	unit->fill = 0;
+}
+
+/*
+ * find the unit for a source address, opening its log on first sight
+ */
+static struct unit *unit_find(struct in_addr addr)
+{
+	static int full;
+
+	struct unit *unit;
+	char path[1024];
+	unsigned hash;
+
+	hash = (ntohl(addr.s_addr) * 2654435761U) >> 22;
+
+	for(;; ++hash) {
+
+		hash &= MAX_UNITS - 1;
+
+		unit = units[hash];
+		if(!unit)
+			break;
+		if(unit->addr.s_addr == addr.s_addr)
+			return unit;
+	}
+
+	if(nunits == MAX_UNITS - 1) {
+		if(!full)
+			fputs(APP_NAME ": too many units, ignoring new ones\n", stderr);
+		full = 1;
+		return NULL;
+	}
+
+	unit = calloc(1, sizeof(*unit));
+	if(unit)
+		unit->buf = malloc(LOG_BUFFER);
+	if(!unit || !unit->buf) {
+		fputs(APP_NAME ": out of memory\n", stderr);
+		exit(1);
+	}
+
+	snprintf(path, sizeof(path), "%s/%s.log", log_dir, inet_ntoa(addr));
+
+	unit->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if(unit->fd == -1) {
+		fprintf(stderr, APP_NAME ": failed to open %s (%s)\n", path, strerror(errno));
+		exit(1);
+	}
+
+	unit->addr = addr;
+
+	units[hash] = unit;
+	++nunits;
+
+	fprintf(stderr, APP_NAME ": logging %s to %s\n", inet_ntoa(addr), path);
+
+	return unit;
+}
+
+/*
+ * append datagram to the unit's log, each line prefixed with the time the
+ * datagram carrying its first character arrived
+ */
+static void unit_log(struct unit *unit, const char *data, unsigned size, const struct timeval *tv)
+{
+	static char stamp[40];
+	static time_t cached;
+
+	unsigned len, room;
+	const char *end;
+
+	/* seconds part is only formatted when it changes */
+
+	if(tv->tv_sec != cached || !stamp[0]) {
+		cached = tv->tv_sec;
+		strftime(stamp, sizeof(stamp), "[%Y-%m-%d %H:%M:%S", localtime(&cached));
+	}
+
+	unit->bytes += size;
+
+	while(size) {
+
+		if(unit->fill + sizeof(stamp) + 16 > LOG_BUFFER)
+			unit_flush(unit);
+
+		if(!unit->mid) {
+			unit->fill += sprintf(unit->buf + unit->fill, "%s.%06ld] ", stamp, (long) tv->tv_usec);
+			unit->mid = 1;
+		}
+
+		end = memchr(data, '\n', size);
+		len = end ? end - data + 1 : size;
+
+		room = LOG_BUFFER - unit->fill;
+		if(len > room) {
+			len = room;
+			end = NULL;
+		}
+
+		memcpy(unit->buf + unit->fill, data, len);
+		unit->fill += len;
+
+		data += len;
+		size -= len;
+
+		if(end) {
+
+			/* CoLo sends CR/LF */
+
+			if(unit->fill > 1 && unit->buf[unit->fill - 2] == '\r') {
+				unit->buf[unit->fill - 2] = '\n';
+				--unit->fill;
+			}
+
+			unit->mid = 0;
+			++unit->lines;
+		}
+	}
+}
+
+/*
+ * log netconsole traffic from any number of units, one file per source
+ * address
+ */
+static int aggregate(const unsigned *ports, unsigned nports)
+{
+	static char bufs[BATCH][DGRAM_SIZE];
+	static char ctls[BATCH][CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(uint32_t))];
+	static struct sockaddr_in from[BATCH];
+	static struct mmsghdr msgs[BATCH];
+	static struct iovec iovs[BATCH];
+	static uint32_t dropped[MAX_PORTS];
+
+	struct epoll_event evts[MAX_PORTS], evt;
+	struct timespec now, last;
+	struct sigaction act;
+	struct cmsghdr *cmsg;
+	struct sockaddr_in sin;
+	const struct timeval *tv;
+	struct timeval arrived;
+	int ep, sck[MAX_PORTS], one, size, done, indx, count;
+	unsigned hash, port, msg;
+	struct unit *unit;
+	uint32_t drop;
+
+	ep = epoll_create1(0);
+	if(ep == -1) {
+		perror(APP_NAME ": epoll_create1");
+		return -1;
+	}
+
+	for(port = 0; port < nports; ++port) {
+
+		sck[port] = socket(PF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+		if(sck[port] == -1) {
+			perror(APP_NAME ": socket");
+			return -1;
+		}
+
+		/* kernel stamps arrival and counts any overflow drops */
+
+		one = 1;
+		size = RCVBUF_SIZE;
+
+		if(setsockopt(sck[port], SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) ||
+			setsockopt(sck[port], SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one))) {
+			perror(APP_NAME ": setsockopt");
+			return -1;
+		}
+
+		if(setsockopt(sck[port], SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)))
+			setsockopt(sck[port], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+		sin.sin_port = htons(ports[port]);
+		sin.sin_addr.s_addr = INADDR_ANY;
+		sin.sin_family = AF_INET;
+
+		if(bind(sck[port], (struct sockaddr *) &sin, sizeof(sin))) {
+			perror(APP_NAME ": bind");
+			return -1;
+		}
+
+		evt.events = EPOLLIN;
+		evt.data.u32 = port;
+
+		if(epoll_ctl(ep, EPOLL_CTL_ADD, sck[port], &evt)) {
+			perror(APP_NAME ": epoll_ctl");
+			return -1;
+		}
+	}
+
+	for(indx = 0; indx < BATCH; ++indx) {
+		iovs[indx].iov_base = bufs[indx];
+		iovs[indx].iov_len = sizeof(bufs[indx]);
+	}
+
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = on_signal;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+
+	printf("\nLogging: port");
+	for(port = 0; port < nports; ++port)
+		printf(" %u", ports[port]);
+	printf(" --> %s/\n\n[[[  press CTRL-C to exit   ]]]\n\n", log_dir);
+	fflush(stdout);
+
+	clock_gettime(CLOCK_MONOTONIC, &last);
+
+	while(!stop) {
+
+		done = epoll_wait(ep, evts, MAX_PORTS, FLUSH_PERIOD);
+		if(done == -1 && errno != EINTR) {
+			perror(APP_NAME ": epoll_wait");
+			break;
+		}
+
+		for(indx = 0; indx < done; ++indx) {
+
+			port = evts[indx].data.u32;
+
+			/* drain the socket, a batch per call */
+
+			do {
+
+				for(msg = 0; msg < BATCH; ++msg) {
+					msgs[msg].msg_hdr.msg_name = &from[msg];
+					msgs[msg].msg_hdr.msg_namelen = sizeof(from[msg]);
+					msgs[msg].msg_hdr.msg_iov = &iovs[msg];
+					msgs[msg].msg_hdr.msg_iovlen = 1;
+					msgs[msg].msg_hdr.msg_control = ctls[msg];
+					msgs[msg].msg_hdr.msg_controllen = sizeof(ctls[msg]);
+				}
+
+				count = recvmmsg(sck[port], msgs, BATCH, 0, NULL);
+				if(count == -1) {
+					if(errno != EAGAIN && errno != EINTR)
+						perror(APP_NAME ": recvmmsg");
+					break;
+				}
+
+				for(msg = 0; msg < count; ++msg) {
+
+					tv = NULL;
+					drop = dropped[port];
+
+					for(cmsg = CMSG_FIRSTHDR(&msgs[msg].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[msg].msg_hdr, cmsg))
+						if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMP)
+							tv = (struct timeval *) CMSG_DATA(cmsg);
+						else if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+							memcpy(&drop, CMSG_DATA(cmsg), sizeof(drop));
+
+					if(drop != dropped[port]) {
+						fprintf(stderr, APP_NAME ": port %u dropped %u datagrams\n", ports[port], drop - dropped[port]);
+						dropped[port] = drop;
+					}
+
+					if(!tv) {
+						gettimeofday(&arrived, NULL);
+						tv = &arrived;
+					}
+
+					unit = unit_find(from[msg].sin_addr);
+					if(unit)
+						unit_log(unit, bufs[msg], msgs[msg].msg_len, tv);
+				}
+
+			} while(count == BATCH);
+		}
+
+		/* logs are written in large blocks, but at least once a period */
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		if((now.tv_sec - last.tv_sec) * 1000 + (now.tv_nsec - last.tv_nsec) / 1000000 >= FLUSH_PERIOD) {
+
+			for(hash = 0; hash < MAX_UNITS; ++hash)
+				if(units[hash] && units[hash]->fill)
+					unit_flush(units[hash]);
+
+			last = now;
+		}
+	}
+
+	for(hash = 0; hash < MAX_UNITS; ++hash) {
+
+		unit = units[hash];
+		if(!unit)
+			continue;
+
+		unit_flush(unit);
+		close(unit->fd);
+
+		fprintf(stderr, APP_NAME ": %s %lu lines, %lu bytes\n", inet_ntoa(unit->addr), unit->lines, unit->bytes);
+	}
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	static char buf[4096];
 
+	unsigned src_port, dst_port, ports[MAX_PORTS], nports;
 	int opt, sck, flg, done, code;
-	unsigned src_port, dst_port;
 	struct termios org, raw;
 	struct sockaddr_in sin;
 	struct hostent *hst;
@@ -41,9 +398,10 @@ int main(int argc, char *argv[])
 
 	src_port = DEFAULT_SRC_PORT;
 	dst_port = DEFAULT_DST_PORT;
+	nports = 0;
 	opterr = 0;
 
-	while((opt = getopt(argc, argv, "p:")) != -1)
+	while((opt = getopt(argc, argv, "p:l:")) != -1)
 
 		switch(opt) {
 
@@ -53,12 +411,32 @@ int main(int argc, char *argv[])
 					fputs(APP_NAME ": invalid source port\n", stderr);
 					return -1;
 				}
+				if(nports == MAX_PORTS) {
+					fputs(APP_NAME ": too many source ports\n", stderr);
+					return -1;
+				}
+				ports[nports++] = src_port;
+				break;
+
+			case 'l':
+				log_dir = optarg;
 				break;
 
 			default:
 				usage();
 		}
 
+	if(log_dir) {
+
+		if(argc != optind)
+			usage();
+
+		if(!nports)
+			ports[nports++] = src_port;
+
+		return aggregate(ports, nports);
+	}
+
 	if(argc == optind || argc - optind > 2)
 		usage();
 
@@ -0,0 +1,18 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#ifndef _LIB_H_
+#define _LIB_H_
+
+#include <string.h>
+
+typedef unsigned	UWORD32;
+
+#endif
+
+/* vi:set ts=3 sw=3 cin: */
@@ -0,0 +1,215 @@
+/*
+ * (C) P.Horton 2004,2005,2006
+ *
+ * $Id$
+ *
+ * This code is covered by the GNU General Public License. For details see the file "COPYING".
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "lib.h"
+#include "md5.h"
+#include "rawboot.h"
+
+#define APP_NAME					"rawboot-tool"
+
+static int usage(void)
+{
+	puts("usage: " APP_NAME " target kernel [initrd]");
+
+	return 1;
+}
+
+static void put_le32(void *ptr, unsigned value)
+{
+	uint8_t *p = ptr;
+
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+/*
+ * read whole file into memory, padded with zeroes to a whole sector
+ */
+static void *load_file(const char *path, unsigned *size)
+{
+	struct stat info;
+	size_t indx, span;
+	ssize_t copy;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd == -1 || fstat(fd, &info)) {
+		fprintf(stderr, APP_NAME ": failed to open \"%s\" (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if(!info.st_size || info.st_size != (unsigned) info.st_size) {
+		fprintf(stderr, APP_NAME ": \"%s\" is empty or too big\n", path);
+		return NULL;
+	}
+
+	*size = info.st_size;
+	span = (*size + RAWBOOT_SECTOR - 1) & ~(RAWBOOT_SECTOR - 1);
+
+	data = calloc(1, span);
+	if(!data) {
+		fprintf(stderr, APP_NAME ": out of memory\n");
+		return NULL;
+	}
+
+	for(indx = 0; indx < *size;) {
+
+		copy = read(fd, data + indx, *size - indx);
+		if(copy == -1 && errno == EINTR)
+			continue;
+
+		if(copy <= 0) {
+			fprintf(stderr, APP_NAME ": failed reading \"%s\" (%s)\n", path, copy ? strerror(errno) : "short file");
+			return NULL;
+		}
+
+		indx += copy;
+	}
+
+	close(fd);
+
+	return data;
+}
+
+static int write_at(int fd, const void *data, size_t size, unsigned sector)
+{
+	size_t indx;
+	ssize_t copy;
+
+	if(lseek(fd, (off_t) sector * RAWBOOT_SECTOR, SEEK_SET) == (off_t) -1) {
+		fprintf(stderr, APP_NAME ": failed to seek (%s)\n", strerror(errno));
+		return 0;
+	}
+
+	for(indx = 0; indx < size;) {
+
+		copy = write(fd, data + indx, size - indx);
+		if(copy == -1) {
+			if(errno != EINTR) {
+				fprintf(stderr, APP_NAME ": failed writing target (%s)\n", strerror(errno));
+				return 0;
+			}
+		} else
+			indx += copy;
+	}
+
+	return 1;
+}
+
+static int sync_target(int fd)
+{
+	if(fsync(fd)) {
+		fprintf(stderr, APP_NAME ": failed to sync target (%s)\n", strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+static unsigned sectors(unsigned size)
+{
+	return (size + RAWBOOT_SECTOR - 1) / RAWBOOT_SECTOR;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct rawboot_header hdr;
+
+	struct MD5Context ctx;
+	unsigned size[2], offset[2];
+	void *data[2];
+	int fd;
+
+	if(argc < 3 || argc > 4)
+		return usage();
+
+	size[1] = 0;
+	data[1] = NULL;
+
+	data[0] = load_file(argv[2], &size[0]);
+	if(!data[0])
+		return 1;
+
+	if(argc > 3) {
+		data[1] = load_file(argv[3], &size[1]);
+		if(!data[1])
+			return 1;
+	}
+
+	/* kernel straight after the header, initrd straight after the kernel */
+
+	offset[0] = 1;
+	offset[1] = size[1] ? offset[0] + sectors(size[0]) : 0;
+
+	memcpy(hdr.magic, RAWBOOT_MAGIC, RAWBOOT_MAGIC_SZ);
+	put_le32(&hdr.version, RAWBOOT_VERSION);
+	put_le32(&hdr.kernel_offset, offset[0]);
+	put_le32(&hdr.kernel_size, size[0]);
+	put_le32(&hdr.initrd_offset, offset[1]);
+	put_le32(&hdr.initrd_size, size[1]);
+
+	MD5Init(&ctx);
+	MD5Update(&ctx, data[0], size[0]);
+	MD5Final(hdr.kernel_md5, &ctx);
+
+	if(size[1]) {
+		MD5Init(&ctx);
+		MD5Update(&ctx, data[1], size[1]);
+		MD5Final(hdr.initrd_md5, &ctx);
+	}
+
+	MD5Init(&ctx);
+	MD5Update(&ctx, (void *) &hdr, (void *) hdr.hdr_md5 - (void *) &hdr);
+	MD5Final(hdr.hdr_md5, &ctx);
+
+	fd = open(argv[1], O_WRONLY | O_CREAT, 0664);
+	if(fd == -1) {
+		fprintf(stderr, APP_NAME ": failed to open \"%s\" (%s)\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	/*
+	 * spoil any old header first and write the new one last, so a write
+	 * that fails part way doesn't leave something that looks bootable
+	 */
+
+	if(!write_at(fd, "", 1, 0) || !sync_target(fd))
+		return 1;
+
+	if(!write_at(fd, data[0], sectors(size[0]) * RAWBOOT_SECTOR, offset[0]))
+		return 1;
+
+	if(size[1] && !write_at(fd, data[1], sectors(size[1]) * RAWBOOT_SECTOR, offset[1]))
+		return 1;
+
+	if(!sync_target(fd) || !write_at(fd, &hdr, sizeof(hdr), 0) || !sync_target(fd))
+		return 1;
+
+	close(fd);
+
+	printf("kernel %u bytes at sector %u\n", size[0], offset[0]);
+	if(size[1])
+		printf("initrd %u bytes at sector %u\n", size[1], offset[1]);
+	printf("%u sectors used\n", (size[1] ? offset[1] + sectors(size[1]) : offset[0] + sectors(size[0])));
+
+	return 0;
+}
+
+/* vi:set ts=3 sw=3 cin: */